@@ -64,8 +64,14 @@ namespace klib
         bool TimedRdLock(int ms) const 
         {
             timespec ts;
+#if defined(LINUX) && defined(__USE_GNU) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+            // 按单调时钟计算超时，不受系统时间调整影响 //
+            KTime::GetMonotonicTime(ts, ms);
+            int rc = pthread_rwlock_clockrdlock(&m_lock, CLOCK_MONOTONIC, &ts);
+#else
             KTime::GetTime(ts, ms);
             int rc = pthread_rwlock_timedrdlock(&m_lock, &ts);
+#endif
 #if defined(WIN32)
             if (rc != 0 && rc != WSAETIMEDOUT)
             {
@@ -102,8 +108,14 @@ namespace klib
         bool TimedWRLock(int ms) const 
         {
             timespec ts;
+#if defined(LINUX) && defined(__USE_GNU) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+            // 按单调时钟计算超时，不受系统时间调整影响 //
+            KTime::GetMonotonicTime(ts, ms);
+            int rc = pthread_rwlock_clockwrlock(&m_lock, CLOCK_MONOTONIC, &ts);
+#else
             KTime::GetTime(ts, ms);
             int rc = pthread_rwlock_timedwrlock(&m_lock, &ts);
+#endif
 #if defined(WIN32)
             if (rc != 0 && rc != WSAETIMEDOUT)
             {
@@ -0,0 +1,357 @@
+#if defined(LINUX) && defined(__IO_URING__)
+#include "tcp/KIoUring.h"
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include "thread/KLockGuard.h"
+
+// 接收缓存组ID //
+#define UringBufGroup 0
+
+namespace klib
+{
+    static inline uint32_t LoadAcquire(const uint32_t* p)
+    {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    static inline void StoreRelease(uint32_t* p, uint32_t v)
+    {
+        __atomic_store_n(p, v, __ATOMIC_RELEASE);
+    }
+
+    static inline uint64_t SocketData(int fd, KIoUring::OpType op)
+    {
+        return (uint64_t(uint32_t(fd)) << 3) | uint64_t(op);
+    }
+
+    bool KIoUring::Completion::HasMore() const
+    {
+        return (flags & IORING_CQE_F_MORE) != 0;
+    }
+
+    bool KIoUring::Completion::HasBuffer() const
+    {
+        return (flags & IORING_CQE_F_BUFFER) != 0;
+    }
+
+    uint16_t KIoUring::Completion::GetBufferId() const
+    {
+        return uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+
+    KIoUring::KIoUring()
+        :m_fd(-1), m_sqRing(MAP_FAILED), m_sqRingSize(0), m_sqes(MAP_FAILED), m_sqesSize(0),
+        m_sqHead(NULL), m_sqTail(NULL), m_sqArray(NULL), m_sqMask(0), m_sqEntries(0), m_sqLocal(0),
+        m_cqRing(MAP_FAILED), m_cqRingSize(0), m_cqHead(NULL), m_cqTail(NULL), m_cqes(NULL), m_cqMask(0),
+        m_bufRing(MAP_FAILED), m_bufRingSize(0), m_bufTail(0), m_bufs(NULL), m_bufCount(0), m_bufSize(0)
+    {
+
+    }
+
+    KIoUring::~KIoUring()
+    {
+        Destroy();
+    }
+
+    bool KIoUring::Initialize(uint32_t entries, uint32_t bufCount, uint32_t bufSize)
+    {
+        if (IsValid() || bufCount == 0 || bufCount > 32768 || (bufCount & (bufCount - 1)) != 0)
+            return false;
+
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        m_fd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+        {
+            printf("io_uring_setup failed, error:[%d]\n", errno);
+            return false;
+        }
+
+        // 需要等待超时参数和完成事件不丢失 //
+        if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+        {
+            printf("io_uring features not supported:[%x]\n", params.features);
+            Destroy();
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            if (m_cqRingSize > m_sqRingSize)
+                m_sqRingSize = m_cqRingSize;
+            m_cqRingSize = 0;
+        }
+
+        m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            Destroy();
+            return false;
+        }
+
+        void* cq = m_sqRing;
+        if (m_cqRingSize > 0)
+        {
+            m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED)
+            {
+                Destroy();
+                return false;
+            }
+            cq = m_cqRing;
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sqes == MAP_FAILED)
+        {
+            Destroy();
+            return false;
+        }
+
+        char* sq = (char*)m_sqRing;
+        m_sqHead = (uint32_t*)(sq + params.sq_off.head);
+        m_sqTail = (uint32_t*)(sq + params.sq_off.tail);
+        m_sqArray = (uint32_t*)(sq + params.sq_off.array);
+        m_sqMask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+        m_sqEntries = params.sq_entries;
+        m_sqLocal = *m_sqTail;
+
+        char* cqp = (char*)cq;
+        m_cqHead = (uint32_t*)(cqp + params.cq_off.head);
+        m_cqTail = (uint32_t*)(cqp + params.cq_off.tail);
+        m_cqes = cqp + params.cq_off.cqes;
+        m_cqMask = *(uint32_t*)(cqp + params.cq_off.ring_mask);
+
+        // 接收缓存环，内核从环中取缓存写入数据 //
+        m_bufCount = bufCount;
+        m_bufSize = bufSize;
+        m_bufRingSize = bufCount * sizeof(io_uring_buf);
+        m_bufRing = mmap(NULL, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        m_bufs = new(std::nothrow) char[size_t(bufCount) * bufSize];
+        if (m_bufRing == MAP_FAILED || m_bufs == NULL)
+        {
+            Destroy();
+            return false;
+        }
+
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)m_bufRing;
+        reg.ring_entries = bufCount;
+        reg.bgid = UringBufGroup;
+        if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        {
+            printf("io_uring register buffer ring failed, error:[%d]\n", errno);
+            Destroy();
+            return false;
+        }
+
+        for (uint32_t i = 0; i < bufCount; ++i)
+            RecycleBuffer(uint16_t(i));
+        return true;
+    }
+
+    void KIoUring::Destroy()
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+
+        if (m_sqes != MAP_FAILED)
+            munmap(m_sqes, m_sqesSize);
+        if (m_cqRing != MAP_FAILED)
+            munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing != MAP_FAILED)
+            munmap(m_sqRing, m_sqRingSize);
+        if (m_bufRing != MAP_FAILED)
+            munmap(m_bufRing, m_bufRingSize);
+        delete[] m_bufs;
+
+        m_sqes = m_cqRing = m_sqRing = m_bufRing = MAP_FAILED;
+        m_bufs = NULL;
+        m_bufTail = 0;
+    }
+
+    bool KIoUring::Accept(int fd)
+    {
+        KLockGuard<KMutex> lock(m_sqMtx);
+        io_uring_sqe* sqe = (io_uring_sqe*)GetSqe();
+        if (sqe == NULL)
+            return false;
+
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = SocketData(fd, UoAccept);
+        return Submit(1) == 1;
+    }
+
+    bool KIoUring::Recv(int fd)
+    {
+        KLockGuard<KMutex> lock(m_sqMtx);
+        io_uring_sqe* sqe = (io_uring_sqe*)GetSqe();
+        if (sqe == NULL)
+            return false;
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = UringBufGroup;
+        sqe->user_data = SocketData(fd, UoRecv);
+        return Submit(1) == 1;
+    }
+
+    bool KIoUring::Poll(int fd, uint32_t events)
+    {
+        KLockGuard<KMutex> lock(m_sqMtx);
+        io_uring_sqe* sqe = (io_uring_sqe*)GetSqe();
+        if (sqe == NULL)
+            return false;
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = events;
+        sqe->user_data = SocketData(fd, UoPoll);
+        return Submit(1) == 1;
+    }
+
+    bool KIoUring::Cancel(int fd, bool close)
+    {
+        KLockGuard<KMutex> lock(m_sqMtx);
+        io_uring_sqe* sqe = (io_uring_sqe*)GetSqe();
+        if (sqe == NULL)
+            return false;
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = SocketData(fd, close ? UoClose : UoCancel);
+        return Submit(1) == 1;
+    }
+
+    size_t KIoUring::Send(int fd, const KBuffer* bufs, size_t n, void* ctx)
+    {
+        KLockGuard<KMutex> lock(m_sqMtx);
+        uint32_t used = m_sqLocal - LoadAcquire(m_sqHead);
+        size_t count = m_sqEntries - used;
+        if (count > n)
+            count = n;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            io_uring_sqe* sqe = (io_uring_sqe*)GetSqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(uintptr_t)bufs[i].GetData();
+            sqe->len = uint32_t(bufs[i].GetSize());
+            // 短写时由内核继续发送 //
+            sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+            if (i + 1 < count)
+                sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = (uint64_t)(uintptr_t)ctx | UoSend;
+        }
+
+        if (count == 0)
+            return 0;
+
+        // 只有部分提交时断开最后一个已提交项的链接 //
+        uint32_t submitted = Submit(uint32_t(count));
+        if (submitted > 0 && submitted < count)
+        {
+            io_uring_sqe* last = (io_uring_sqe*)m_sqes + ((m_sqLocal - 1) & m_sqMask);
+            last->flags &= ~IOSQE_IO_LINK;
+        }
+        return submitted;
+    }
+
+    int KIoUring::Wait(uint32_t ms)
+    {
+        uint32_t ready = LoadAcquire(m_cqTail) - *m_cqHead;
+        if (ready > 0)
+            return int(ready);
+
+        __kernel_timespec ts;
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000000;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        return int(LoadAcquire(m_cqTail) - *m_cqHead);
+    }
+
+    bool KIoUring::Peek(Completion& c)
+    {
+        uint32_t head = *m_cqHead;
+        if (head == LoadAcquire(m_cqTail))
+            return false;
+
+        const io_uring_cqe* cqe = (const io_uring_cqe*)m_cqes + (head & m_cqMask);
+        c.data = cqe->user_data;
+        c.res = cqe->res;
+        c.flags = cqe->flags;
+        StoreRelease(m_cqHead, head + 1);
+        return true;
+    }
+
+    void KIoUring::RecycleBuffer(uint16_t bid)
+    {
+        io_uring_buf* buf = (io_uring_buf*)m_bufRing + (m_bufTail & (m_bufCount - 1));
+        buf->addr = (uint64_t)(uintptr_t)(m_bufs + size_t(bid) * m_bufSize);
+        buf->len = m_bufSize;
+        buf->bid = bid;
+        ++m_bufTail;
+        // 环尾与第一个缓存的resv 字段重叠 //
+        __atomic_store_n((uint16_t*)((char*)m_bufRing + offsetof(io_uring_buf, resv)), m_bufTail, __ATOMIC_RELEASE);
+    }
+
+    void* KIoUring::GetSqe()
+    {
+        uint32_t tail = m_sqLocal;
+        if (tail - LoadAcquire(m_sqHead) >= m_sqEntries)
+            return NULL;
+
+        io_uring_sqe* sqe = (io_uring_sqe*)m_sqes + (tail & m_sqMask);
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        m_sqArray[tail & m_sqMask] = (tail & m_sqMask);
+        ++m_sqLocal;
+        return sqe;
+    }
+
+    uint32_t KIoUring::Submit(uint32_t n)
+    {
+        // 填写完成后再发布队尾 //
+        StoreRelease(m_sqTail, m_sqLocal);
+        while (true)
+        {
+            long rc = syscall(__NR_io_uring_enter, m_fd, n, 0, 0, NULL, 0);
+            if (rc >= 0)
+                return n;
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                break;
+        }
+
+        // 没有SQPOLL，只有io_uring_enter 会取走提交项，撤回本次未被取走的部分 //
+        uint32_t pending = m_sqLocal - LoadAcquire(m_sqHead);
+        uint32_t rollback = (pending < n ? pending : n);
+        m_sqLocal -= rollback;
+        StoreRelease(m_sqTail, m_sqLocal);
+        return n - rollback;
+    }
+};
+#endif
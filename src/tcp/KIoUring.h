@@ -0,0 +1,174 @@
+#ifndef __KIOURING__
+#define __KIOURING__
+#if defined(LINUX) && defined(__IO_URING__)
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include "thread/KMutex.h"
+#include "thread/KBuffer.h"
+/**
+io_uring 封装，直接使用系统调用，不依赖liburing
+需要内核6.0及以上(多次触发的accept/recv，注册的接收缓存环)
+提交加锁，可以多线程提交；完成队列只能由一个线程处理
+**/
+namespace klib
+{
+    class KIoUring
+    {
+    public:
+        // 操作类型，保存在user_data 的低3位 //
+        enum OpType
+        {
+            UoSend = 1, UoAccept = 2, UoRecv = 3, UoPoll = 4, UoCancel = 5, UoClose = 6
+        };
+
+        // 完成事件 //
+        struct Completion
+        {
+            uint64_t data;
+            int32_t res;
+            uint32_t flags;
+
+            inline OpType GetOpType() const { return OpType(data & 7); }
+            inline int GetSocket() const { return int(data >> 3); }
+            inline void* GetContext() const { return (void*)(uintptr_t)(data & ~uint64_t(7)); }
+            // 多次触发的请求是否仍然有效 //
+            bool HasMore() const;
+            // 是否使用了注册的接收缓存 //
+            bool HasBuffer() const;
+            uint16_t GetBufferId() const;
+        };
+
+    public:
+        KIoUring();
+
+        ~KIoUring();
+
+        /************************************
+        * Method:    创建io_uring 并注册接收缓存环
+        * Returns:   成功返回true失败返回false
+        * Parameter: entries 提交队列长度
+        * Parameter: bufCount 接收缓存个数，2的幂
+        * Parameter: bufSize 每个接收缓存的字节数
+        *************************************/
+        bool Initialize(uint32_t entries, uint32_t bufCount, uint32_t bufSize);
+
+        /************************************
+        * Method:    释放io_uring
+        * Returns:   
+        *************************************/
+        void Destroy();
+
+        inline bool IsValid() const { return m_fd >= 0; }
+
+        /************************************
+        * Method:    多次触发的接受连接，新socket 为非阻塞
+        * Returns:   提交成功返回true失败返回false
+        * Parameter: fd 监听socket
+        *************************************/
+        bool Accept(int fd);
+
+        /************************************
+        * Method:    多次触发的接收数据，数据写入注册的接收缓存
+        * Returns:   提交成功返回true失败返回false
+        * Parameter: fd socket
+        *************************************/
+        bool Recv(int fd);
+
+        /************************************
+        * Method:    一次性轮询事件
+        * Returns:   提交成功返回true失败返回false
+        * Parameter: fd socket
+        * Parameter: events 轮询事件
+        *************************************/
+        bool Poll(int fd, uint32_t events);
+
+        /************************************
+        * Method:    取消socket 上所有未完成的请求
+        * Returns:   提交成功返回true失败返回false
+        * Parameter: fd socket
+        * Parameter: close 取消完成后是否由调用者关闭socket(UoClose)
+        *************************************/
+        bool Cancel(int fd, bool close);
+
+        /************************************
+        * Method:    提交链接的发送请求，按顺序发送，前一个失败后面的取消
+        * Returns:   返回提交的请求个数，提交队列满时少于n
+        * Parameter: fd socket
+        * Parameter: bufs 待发送数据，完成之前不能释放
+        * Parameter: n 数据个数
+        * Parameter: ctx 上下文，8字节对齐，完成事件中返回
+        *************************************/
+        size_t Send(int fd, const KBuffer* bufs, size_t n, void* ctx);
+
+        /************************************
+        * Method:    等待完成事件
+        * Returns:   返回可处理的完成事件个数
+        * Parameter: ms 超时毫秒数
+        *************************************/
+        int Wait(uint32_t ms);
+
+        /************************************
+        * Method:    取出一个完成事件
+        * Returns:   有返回true否则返回false
+        * Parameter: c 完成事件
+        *************************************/
+        bool Peek(Completion& c);
+
+        /************************************
+        * Method:    获取接收缓存
+        * Returns:   
+        * Parameter: bid 缓存ID
+        *************************************/
+        inline const char* GetBuffer(uint16_t bid) const { return m_bufs + size_t(bid) * m_bufSize; }
+
+        /************************************
+        * Method:    归还接收缓存，只能在处理完成事件的线程调用
+        * Returns:   
+        * Parameter: bid 缓存ID
+        *************************************/
+        void RecycleBuffer(uint16_t bid);
+
+    private:
+        KIoUring(const KIoUring&);
+        KIoUring& operator=(const KIoUring&);
+
+        // 获取空闲的提交项，调用者持有m_sqMtx //
+        void* GetSqe();
+        // 发布已填写的提交项并通知内核提交n个，调用者持有m_sqMtx //
+        // 返回已提交的个数，失败时撤回内核未取走的提交项，避免之后提交引用已释放的数据 //
+        uint32_t Submit(uint32_t n);
+
+    private:
+        int m_fd;
+        // 提交队列 //
+        KMutex m_sqMtx;
+        void* m_sqRing;
+        size_t m_sqRingSize;
+        void* m_sqes;
+        size_t m_sqesSize;
+        uint32_t* m_sqHead;
+        uint32_t* m_sqTail;
+        uint32_t* m_sqArray;
+        uint32_t m_sqMask;
+        uint32_t m_sqEntries;
+        // 已填写未发布的队尾 //
+        uint32_t m_sqLocal;
+        // 完成队列 //
+        void* m_cqRing;
+        size_t m_cqRingSize;
+        uint32_t* m_cqHead;
+        uint32_t* m_cqTail;
+        void* m_cqes;
+        uint32_t m_cqMask;
+        // 接收缓存环 //
+        void* m_bufRing;
+        size_t m_bufRingSize;
+        uint16_t m_bufTail;
+        char* m_bufs;
+        uint32_t m_bufCount;
+        uint32_t m_bufSize;
+    };
+};
+#endif
+#endif
@@ -34,13 +34,13 @@ namespace klib
         }
 
         /************************************
-        * Method:    获取序列号
+        * Method:    获取序列号，跳过心跳保留的序列号
         * Returns:   返回序列号
         *************************************/
         uint16_t GetSeq()
         {
             uint16_t seq = m_seq++;
-            if (seq == 0xffff)
+            if (m_seq == ModbusHeartbeatSeq)
                 m_seq = 0;
             return seq;
         }
@@ -20,7 +20,7 @@ namespace klib {
         * Parameter: hosts 格式：1.1.1.1:12345,2.2.2.2:23456
         * Parameter: needAuth 是否需要授权
         *************************************/
-        bool Start(const std::string& hosts, bool needAuth = false)
+        bool Start(const std::string& hosts, bool needAuth = false, PollBackend backend = PbDefault)
         {
             std::vector<std::string> brokers;
             klib::KStringUtility::SplitString(hosts, ",", brokers);
@@ -52,7 +52,7 @@ namespace klib {
             }
 
             m_it = m_hostip.begin();
-            return KTcpNetwork<MessageType>::Start(m_it->first, m_it->second, false, needAuth);
+            return KTcpNetwork<MessageType>::Start(m_it->first, m_it->second, false, needAuth, backend);
         }
 
         /************************************
@@ -87,6 +87,35 @@ namespace klib {
             }
         }
 
+        /************************************
+        * Method:    获取所有候选配置，从上次连接成功的主机开始
+        * Returns:   
+        * Parameter: confs 候选IP和端口
+        *************************************/
+        virtual void GetConfigs(std::vector<std::pair<std::string, uint16_t> >& confs) const
+        {
+            std::map<std::string, uint16_t>::const_iterator it = m_it;
+            do
+            {
+                confs.push_back(*it);
+                if (++it == m_hostip.end())
+                    it = m_hostip.begin();
+            } while (it != m_it);
+        }
+
+        /************************************
+        * Method:    记录连接成功的主机，下次优先连接
+        * Returns:   
+        * Parameter: ip 连接IP
+        * Parameter: port 连接端口
+        *************************************/
+        virtual void OnConfigConnected(const std::string& ip, uint16_t /*port*/)
+        {
+            std::map<std::string, uint16_t>::const_iterator it = m_hostip.find(ip);
+            if (it != m_hostip.end())
+                m_it = it;
+        }
+
     private:
         std::map<std::string, uint16_t> m_hostip;
         mutable std::map<std::string, uint16_t>::const_iterator m_it;
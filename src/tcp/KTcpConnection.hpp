@@ -1,6 +1,7 @@
 #pragma once
 #if defined(WIN32)
 #include <WS2tcpip.h>
+#include <mstcpip.h>
 #elif defined(AIX)
 #include <fcntl.h>
 #include <arpa/inet.h>
@@ -23,6 +24,7 @@
 #include <sys/epoll.h>
 #include <sys/poll.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 #else
 #error "WINDOWS AIX HPUX LINUX supported only"
 #endif // defined(WIN32)
@@ -72,6 +74,10 @@ namespace klib {
 #define PollTimeOut 100
 #define BlockSize 40960
 #define MaxEvent 40
+// io_uring 提交队列长度、接收缓存个数和大小 //
+#define UringEntries 1024
+#define UringBufCount 256
+#define UringBufSize 16384
 
     /**
     tcp 消息类
@@ -260,6 +266,20 @@ namespace klib {
         std::string dat2;
     };
 
+    /**
+    连接句柄，socket 关闭后会被新连接复用，用代数识别句柄是否过期
+    **/
+    struct ConnectionHandle
+    {
+        SocketType fd;
+        uint32_t generation;
+
+        ConnectionHandle(SocketType fd = 0, uint32_t generation = 0)
+            :fd(fd), generation(generation)
+        {
+        }
+    };
+
     enum NetworkState
     {
         // 连接上，断开，就绪 //
@@ -272,6 +292,12 @@ namespace klib {
         NmUndefined, NmClient, NmServer
     };
 
+    enum PollBackend
+    {
+        // 系统默认(epoll、pollset、poll)，io_uring(linux 且定义了__IO_URING__) //
+        PbDefault, PbIoUring
+    };
+
     /************************************
     * Method:    写socket
     * Returns:   
@@ -333,6 +359,10 @@ namespace klib {
                 dat.push_back(b);
                 bytes += rc;
             }
+            else if (rc == 0) // 对端关闭连接
+            {
+                return -1;
+            }
             else
             {
 #if defined(WIN32)
@@ -362,7 +392,8 @@ namespace klib {
     public:
         KTcpConnection(KTcpNetwork<MessageType> *poller)
             :KEventObject<SocketEvent>("Socket event thread", 1000),
-            m_state(NsUndefined), m_mode(NmUndefined), m_poller(poller)
+            m_state(NsUndefined), m_mode(NmUndefined), m_poller(poller),
+            m_lastRecv(0), m_lastHeartbeat(0), m_generation(0)
         {
 
         }
@@ -404,6 +435,9 @@ namespace klib {
                 m_auth.authSent = true;
             m_ipport = ipport;
             m_fd = fd;
+            m_generation.Store(m_poller->NextGeneration(), MoRelease);
+            m_lastHeartbeat = 0;
+            Touch();
             OnConnected(GetMode(), ipport);
         }
 
@@ -437,7 +471,7 @@ namespace klib {
         * Method:    是否断开
         * Returns:   是返回true否则返回false
         *************************************/
-        inline bool IsDisconnected() const { return m_state == NsDisconnected; }
+        inline bool IsDisconnected() const { return GetState() == NsDisconnected; }
 
         /************************************
         * Method:    获取socket
@@ -450,24 +484,59 @@ namespace klib {
         * Returns:   返回IP和端口
         *************************************/
         inline  const std::string& GetAddress() const { return m_ipport; }
+
+        /************************************
+        * Method:    获取连接代数，每次连接从网络对象取新值，同一网络对象内不重复，用于识别socket 复用
+        * Returns:   返回代数
+        *************************************/
+        inline uint32_t GetGeneration() const { return m_generation.Load(MoAcquire); }
+
+        /************************************
+        * Method:    获取连接句柄，连接断开后句柄失效
+        * Returns:   返回句柄
+        *************************************/
+        inline ConnectionHandle GetHandle() const { return ConnectionHandle(m_fd, GetGeneration()); }
+
+        /************************************
+        * Method:    获取最后一次收到数据的毫秒数
+        * Returns:   返回毫秒数
+        *************************************/
+        inline uint64_t GetLastRecv() const { return m_lastRecv.Load(MoRelaxed); }
+
+        /************************************
+        * Method:    获取最后一次发送心跳的毫秒数
+        * Returns:   返回毫秒数
+        *************************************/
+        inline uint64_t GetLastHeartbeat() const { return m_lastHeartbeat; }
+
+        /************************************
+        * Method:    发送心跳
+        * Returns:   协议支持心跳并发送成功返回true否则返回false
+        * Parameter: now 当前毫秒数
+        *************************************/
+        bool Heartbeat(uint64_t now)
+        {
+            m_lastHeartbeat = now;
+            return OnHeartbeat();
+        }
         
     protected:
         /************************************
         * Method:    获取模式
         * Returns:   返回模式
         *************************************/
-        inline NetworkMode GetMode() const { return static_cast<NetworkMode>(int32_t(m_mode)); }
+        inline NetworkMode GetMode() const { return static_cast<NetworkMode>(m_mode.Load(MoRelaxed)); }
         /************************************
         * Method:    获取状态
         * Returns:   返回状态
         *************************************/
-        inline NetworkState GetState() const { return static_cast<NetworkState>(int32_t(m_state)); }
+        inline NetworkState GetState() const { return static_cast<NetworkState>(m_state.Load(MoAcquire)); }
         /************************************
         * Method:    设置状态
         * Returns:   
         * Parameter: s 状态
         *************************************/
-        inline void SetState(NetworkState s) const { m_state = s; }
+        inline void SetState(NetworkState s) const { m_state.Store(s, MoRelease); }
         /************************************
         * Method:    连接触发操作
         * Returns:   
@@ -538,6 +607,49 @@ namespace klib {
         {
             return !m_auth.need;
         }
+        /************************************
+        * Method:    触发心跳，由轮询线程在连接空闲时调用
+        * Returns:   发送了心跳返回true，协议不支持心跳返回false
+        *************************************/
+        virtual bool OnHeartbeat()
+        {
+            return false;
+        }
+        /************************************
+        * Method:    判断是否为心跳的响应，心跳响应在分发前丢弃
+        * Returns:   是心跳响应返回true
+        * Parameter: msg 消息
+        *************************************/
+        virtual bool IsHeartbeat(const MessageType& /*msg*/) const
+        {
+            return false;
+        }
+        /************************************
+        * Method:    释放不再分发的消息持有的缓存
+        * Returns:   
+        * Parameter: msg 消息
+        *************************************/
+        virtual void ReleaseMessage(MessageType& /*msg*/)
+        {
+        }
+        /************************************
+        * Method:    发送数据，由连接线程写socket
+        * Returns:   入队成功返回true否则返回false
+        * Parameter: bufs 数据，入队失败时释放
+        *************************************/
+        bool SendData(const std::vector<KBuffer>& bufs)
+        {
+            SocketEvent e;
+            e.fd = m_fd;
+            e.ev = SocketEvent::SeSent;
+            e.dat1 = bufs;
+            if (!IsConnected() || !Post(e))
+            {
+                m_poller->Release(e.dat1);
+                return false;
+            }
+            return true;
+        }
 
     private:
         /************************************
@@ -559,6 +671,12 @@ namespace klib {
                     {
                         m_auth.authSent = OnAuthRequest();
                     }
+                    else if (m_poller->IsUringEnabled())
+                    {
+                        // 链接发送，数据由轮询线程在发送完成后释放 //
+                        if (!m_poller->SendUring(fd, ev.dat2, bufs))
+                            Disconnect(fd);
+                    }
                     else
                     {
                         const std::string& smsg = ev.dat2;
@@ -593,6 +711,7 @@ namespace klib {
                 }
                 case SocketEvent::SeRecv:
                 {
+                    Touch();
                     if (bufs.empty())
                     {
                         std::vector<KBuffer> buffers;
@@ -619,6 +738,37 @@ namespace klib {
             }
         }
         /************************************
+        * Method:    记录收到数据的时间
+        * Returns:   
+        *************************************/
+        inline void Touch()
+        {
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            m_lastRecv.Store(now, MoRelaxed);
+        }
+        /************************************
+        * Method:    丢弃并释放心跳响应，保持其余消息的顺序
+        * Returns:   
+        * Parameter: msgs 消息
+        *************************************/
+        void DropHeartbeats(std::vector<MessageType>& msgs)
+        {
+            size_t n = 0;
+            for (size_t i = 0; i < msgs.size(); ++i)
+            {
+                if (IsHeartbeat(msgs[i]))
+                {
+                    ReleaseMessage(msgs[i]);
+                    continue;
+                }
+                if (n != i)
+                    msgs[n] = msgs[i];
+                ++n;
+            }
+            msgs.resize(n);
+        }
+        /************************************
         * Method:    解析数据
         * Returns:   
         * Parameter: fd socket
@@ -638,6 +788,7 @@ namespace klib {
                 {
                     std::vector<MessageType> msgs;
                     Parse(bufs, msgs, m_remain);
+                    DropHeartbeats(msgs);
                     if (!msgs.empty())
                         OnMessage(msgs);
                 }
@@ -663,5 +814,11 @@ namespace klib {
         Authorization m_auth;
         // 连接 //
         KTcpNetwork<MessageType>* m_poller;
+        // 最后一次收到数据的毫秒数 //
+        AtomicInteger<uint64_t> m_lastRecv;
+        // 最后一次发送心跳的毫秒数，只在轮询线程读写 //
+        uint64_t m_lastHeartbeat;
+        // 连接代数 //
+        AtomicInteger<uint32_t> m_generation;
     };
 };
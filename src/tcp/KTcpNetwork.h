@@ -5,6 +5,10 @@ tcp 连接操作类，包括连接绑定轮询读数据
 #define _KTCPBASE_HPP_
 
 #include "KTcpConnection.hpp"
+#include "thread/KTimerQueue.h"
+#include "thread/KSlotTable.h"
+#include "thread/KEpoch.h"
+#include "tcp/KIoUring.h"
 namespace klib {
     template<typename MessageType>
     class KTcpNetwork: public KEventObject<SocketType>
@@ -15,8 +19,12 @@ namespace klib {
         * Returns:   
         *************************************/
         KTcpNetwork()
-            :KEventObject<SocketType>("Poll thread", 50),m_connected(false), 
-            m_isServer(false),m_needAuth(false),m_maxClient(50)
+            :KEventObject<SocketType>("Poll thread", 50),m_isServer(false),
+            m_connected(false),m_needAuth(false),m_maxClient(50),m_allocated(0),m_recycleLimit(0),
+            m_backlog(200),m_reuseShards(0),m_reuseCpu(false),
+            m_connectTimeout(3000),m_connectStagger(100),m_connectParallel(3),
+            m_candidateIndex(0),m_lastConnectStart(0),
+            m_idleTimeout(0),m_heartbeat(0),m_keepIdle(0),m_keepInterval(0),m_keepCount(0),m_userTimeout(0)
         {
 #if defined(WIN32)
             WSADATA wsd;
@@ -71,6 +79,98 @@ namespace klib {
         * Parameter: mc 连接个数
         *************************************/
         inline void SetMaxClient(uint16_t mc) { m_maxClient = mc; }
+
+        /************************************
+        * Method:    设置连接超时时间
+        * Returns:   
+        * Parameter: ms 超时毫秒数
+        *************************************/
+        inline void SetConnectTimeout(uint32_t ms) { m_connectTimeout = ms; }
+
+        /************************************
+        * Method:    设置并行连接参数
+        * Returns:   
+        * Parameter: parallel 同时尝试连接的主机个数
+        * Parameter: stagger 相邻两次发起连接的间隔毫秒数
+        *************************************/
+        inline void SetConnectParallel(uint16_t parallel, uint32_t stagger = 100)
+        {
+            m_connectParallel = (parallel > 0 ? parallel : 1);
+            m_connectStagger = stagger;
+        }
+
+        /************************************
+        * Method:    设置空闲超时时间，超过该时间没有收到数据则断开连接
+        * Returns:   
+        * Parameter: ms 超时毫秒数，0表示不检测
+        *************************************/
+        inline void SetIdleTimeout(uint32_t ms) { m_idleTimeout = ms; }
+
+        /************************************
+        * Method:    设置心跳间隔，连接空闲超过该时间则发送心跳(websocket ping、modbus读请求)
+        * Returns:   
+        * Parameter: ms 心跳毫秒数，0表示不发送
+        *************************************/
+        inline void SetHeartbeat(uint32_t ms) { m_heartbeat = ms; }
+
+        /************************************
+        * Method:    设置TCP keepalive参数，对之后建立的连接生效
+        * Returns:   
+        * Parameter: idle 空闲多少秒后开始探测，0表示不启用
+        * Parameter: interval 探测间隔秒数
+        * Parameter: count 探测失败多少次后断开
+        * Parameter: userTimeout 已发送数据多少毫秒未确认则断开(TCP_USER_TIMEOUT)，0表示系统默认
+        *************************************/
+        inline void SetKeepAlive(uint32_t idle, uint32_t interval = 5, uint32_t count = 3, uint32_t userTimeout = 0)
+        {
+            m_keepIdle = idle;
+            m_keepInterval = interval;
+            m_keepCount = count;
+            m_userTimeout = userTimeout;
+        }
+
+        /************************************
+        * Method:    设置监听队列长度，对之后的监听生效
+        * Returns:   
+        * Parameter: backlog 队列长度，受系统somaxconn 限制
+        *************************************/
+        inline void SetBacklog(int backlog) { m_backlog = (backlog > 0 ? backlog : 200); }
+
+        /************************************
+        * Method:    设置端口复用(SO_REUSEPORT)，多个服务对象监听同一端口，由内核分发新连接
+        *            每个服务对象有自己的轮询线程，需在Start之前设置，仅linux/aix 有效
+        * Returns:   
+        * Parameter: shards 监听同一端口的服务对象个数，0表示不复用
+        * Parameter: cpuAffinity 是否按收包CPU 分发(linux)，第i个启动的服务对象处理CPU i%shards 上的连接
+        *************************************/
+        inline void SetReusePort(uint16_t shards, bool cpuAffinity = false)
+        {
+            m_reuseShards = shards;
+            m_reuseCpu = (shards > 0 && cpuAffinity);
+        }
+
+        /************************************
+        * Method:    设置回收队列长度，超过时断开的连接在没有线程访问后停止线程并释放
+        * Returns:   
+        * Parameter: limit 回收队列长度，0表示不限制(连接只回收不释放)
+        *************************************/
+        inline void SetRecycleLimit(size_t limit)
+        {
+            KLockGuard<KMutex> lock(m_recycleMtx);
+            m_recycleLimit = limit;
+        }
+
+        /************************************
+        * Method:    设置连接线程选项(CPU 绑定、NUMA 节点、调度策略)，对之后新建的连接生效
+        *            轮询线程使用SetThreadOptions设置
+        * Returns:   
+        * Parameter: opts 线程选项
+        *************************************/
+        inline void SetConnectionThreadOptions(const KThreadOptions& opts)
+        {
+            KLockGuard<KMutex> lock(m_connMtx);
+            m_connOptions = opts;
+        }
         
         /************************************
         * Method:    启动
@@ -79,13 +179,20 @@ namespace klib {
         * Parameter: port 连接端口
         * Parameter: isServer 是否是服务器
         * Parameter: needAuth 是否需要授权
+        * Parameter: backend 轮询方式，io_uring 不可用时使用系统默认方式
         *************************************/
-        virtual bool Start(const std::string& ip, int32_t port, bool isServer = true, bool needAuth = false)
+        virtual bool Start(const std::string& ip, int32_t port, bool isServer = true, bool needAuth = false, PollBackend backend = PbDefault)
         {
+            if (backend == PbIoUring && !InitUring())
+                printf("io_uring not available, use default poller\n");
+
             m_ip = ip;
             m_port = port;
             m_isServer = isServer;
             m_needAuth = needAuth;
+            // 复用端口时同步监听，保证复用组内的顺序与启动顺序一致 //
+            if (m_isServer && m_reuseShards > 0)
+                ListenSelf();
             if (KEventObject<SocketType>::Start())
             {
                 PostForce(0);
@@ -94,6 +201,19 @@ namespace klib {
             return false;
         }
 
+        /************************************
+        * Method:    是否使用io_uring 轮询
+        * Returns:   是返回true否则返回false
+        *************************************/
+        inline bool IsUringEnabled() const
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            return m_uring.IsValid();
+#else
+            return false;
+#endif
+        }
+
         /************************************
         * Method:    发送数据给自己
         * Returns:   发送成功返回true失败返回false
@@ -115,24 +235,38 @@ namespace klib {
         *************************************/
         bool SendDataToConnection(SocketType fd, SocketEvent::EventType et,const std::vector<KBuffer>& bufs)
         {
-            KLockGuard<KMutex> lock(m_connMtx);
-            typename std::map<SocketType, KTcpConnection<MessageType>*>::iterator it = m_connections.find(fd);
-            if (it != m_connections.end())
-            {
-                KTcpConnection<MessageType>* c = it->second;
-                SocketEvent e;
-                e.fd = fd;
-                e.ev = et;
-                e.dat1 = bufs;
-                if (c->IsConnected())
-                {
-                    if (!c->Post(e))
-                        printf("Send data to connection failed, fd:[%d]\n", fd);
-                    else
-                        return true;
-                }
-            }
-            return false;
+            // 不加锁读取，连接对象在纪元保护下不会被释放 //
+            KEpoch::Guard guard(m_epoch);
+            return SendData(m_connections.Get(SocketIndex(fd)), fd, et, bufs);
+        }
+
+        /************************************
+        * Method:    发送数据给句柄对应的连接，socket 已被新连接复用时不发送
+        * Returns:   发送成功返回true，句柄过期或失败返回false
+        * Parameter: h 连接句柄
+        * Parameter: et 事件类型
+        * Parameter: bufs 发送的数据
+        *************************************/
+        bool SendDataToConnection(const ConnectionHandle& h, SocketEvent::EventType et, const std::vector<KBuffer>& bufs)
+        {
+            KEpoch::Guard guard(m_epoch);
+            return SendData(GetConnection(h), h.fd, et, bufs);
+        }
+
+        /************************************
+        * Method:    获取socket 当前连接的句柄
+        * Returns:   socket 上没有连接返回false
+        * Parameter: fd socket ID
+        * Parameter: h 连接句柄
+        *************************************/
+        bool GetConnectionHandle(SocketType fd, ConnectionHandle& h)
+        {
+            KEpoch::Guard guard(m_epoch);
+            KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(fd));
+            if (c == NULL || !c->IsConnected())
+                return false;
+            h = ConnectionHandle(fd, c->GetGeneration());
+            return true;
         }
 
         /************************************
@@ -146,15 +280,70 @@ namespace klib {
         * Returns:   返回IP
         * Parameter: fd 客户端ID
         *************************************/
-        const std::string& GetConnectionInfo(SocketType fd)
+        std::string GetConnectionInfo(SocketType fd)
         {
-            KLockGuard<KMutex> lock(m_connMtx);
-            typename std::map<SocketType, KTcpConnection<MessageType>*>::iterator it = m_connections.find(fd);
-            if (it != m_connections.end())
-                return it->second->GetAddress();
+            // 连接可能被释放，返回拷贝 //
+            KEpoch::Guard guard(m_epoch);
+            KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(fd));
+            if (c != NULL)
+                return c->GetAddress();
+            return std::string();
+        }
+
+        /************************************
+        * Method:    获取句柄对应的连接IP
+        * Returns:   返回IP，句柄过期返回空字符串
+        * Parameter: h 连接句柄
+        *************************************/
+        std::string GetConnectionInfo(const ConnectionHandle& h)
+        {
+            KEpoch::Guard guard(m_epoch);
+            KTcpConnection<MessageType>* c = GetConnection(h);
+            if (c != NULL)
+                return c->GetAddress();
             return std::string();
         }
-    protected:        
+    protected:
+        /************************************
+        * Method:    句柄对应的连接，须在纪元保护下调用
+        * Returns:   socket 上没有连接或已被新连接复用返回NULL
+        * Parameter: h 连接句柄
+        *************************************/
+        KTcpConnection<MessageType>* GetConnection(const ConnectionHandle& h) const
+        {
+            KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(h.fd));
+            if (c == NULL || c->GetGeneration() != h.generation)
+                return NULL;
+            return c;
+        }
+
+        /************************************
+        * Method:    投递发送事件到连接
+        * Returns:   发送成功返回true失败返回false
+        * Parameter: c 连接
+        * Parameter: fd socket ID
+        * Parameter: et 事件类型
+        * Parameter: bufs 发送的数据
+        *************************************/
+        bool SendData(KTcpConnection<MessageType>* c, SocketType fd, SocketEvent::EventType et, const std::vector<KBuffer>& bufs)
+        {
+            if (c != NULL)
+            {
+                SocketEvent e;
+                e.fd = fd;
+                e.ev = et;
+                e.dat1 = bufs;
+                if (c->IsConnected())
+                {
+                    if (!c->Post(e))
+                        printf("Send data to connection failed, fd:[%d]\n", fd);
+                    else
+                        return true;
+                }
+            }
+            return false;
+        }
+
         /************************************
         * Method:    创建连接
         * Returns:   返回连接对象
@@ -174,6 +363,27 @@ namespace klib {
             return std::pair<std::string, uint16_t>(m_ip, m_port);
         }
 
+        /************************************
+        * Method:    获取所有候选配置，按优先级排序
+        * Returns:   
+        * Parameter: confs 候选IP和端口
+        *************************************/
+        virtual void GetConfigs(std::vector<std::pair<std::string, uint16_t> >& confs) const
+        {
+            confs.push_back(GetConfig());
+        }
+
+        /************************************
+        * Method:    连接成功的配置
+        * Returns:   
+        * Parameter: ip 连接IP
+        * Parameter: port 连接端口
+        *************************************/
+        virtual void OnConfigConnected(const std::string& /*ip*/, uint16_t /*port*/)
+        {
+
+        }
+
         /************************************
         * Method:    端口连接并清理资源
         * Returns:   
@@ -181,13 +391,27 @@ namespace klib {
         *************************************/
         void DisconnectConnection(SocketType fd)
         {
+            KEpoch::Guard guard(m_epoch);
             KLockGuard<KMutex> lock(m_connMtx);
-            typename std::map<SocketType, KTcpConnection<MessageType>*>::iterator it = m_connections.find(fd);
-            if (it != m_connections.end())
-            {
-                KTcpConnection<MessageType>* c = it->second;
+            KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(fd));
+            if (c != NULL)
                 c->Disconnect(fd);
-            }
+        }
+
+        /************************************
+        * Method:    断开句柄对应的连接，socket 已被新连接复用时不断开
+        * Returns:   断开返回true，句柄过期返回false
+        * Parameter: h 连接句柄
+        *************************************/
+        bool DisconnectConnection(const ConnectionHandle& h)
+        {
+            KEpoch::Guard guard(m_epoch);
+            KLockGuard<KMutex> lock(m_connMtx);
+            KTcpConnection<MessageType>* c = GetConnection(h);
+            if (c == NULL)
+                return false;
+            c->Disconnect(h.fd);
+            return true;
         }
 
     private:
@@ -202,48 +426,56 @@ namespace klib {
             {
                 if (m_connected)
                 {
+                    KEpoch::Guard guard(m_epoch);
                     PollSocket();
+                    CheckTimers();
                 }
-                else
+                else if (!ListenSelf())
                 {
-                    std::pair<std::string, uint16_t> conf = GetConfig();
-                    if ((m_fd = Listen(conf.first, conf.second)) > 0)
-                    {
-                        std::ostringstream os;
-                        os << conf.first << ":" << conf.second;
-
-                        if (SetSocketNonBlock(m_fd) && SetPollEvent(m_fd))
-                            m_connected = true;
-                        else
-                            CloseSocket(m_fd);
-                    }
-                    else
-                        KTime::MSleep(1000);
+                    KTime::MSleep(1000);
                 }
             }
             else
             {
                 if (m_connected)
                 {
-                    if (PollSocket() < 1)
+                    // io_uring 多次触发的接收已经在读，不能再直接读 //
+                    if (PollSocket() < 1 && !IsUringEnabled())
                         ReadSocket2(m_fd);
+                    CheckTimers();
                 }
                 else
                 {
-                    std::pair<std::string, uint16_t> conf = GetConfig();
-                    if ((m_fd = Connect(conf.first, conf.second)) > 0)
-                    {
-                        std::ostringstream os;
-                        os << conf.first << ":" << conf.second;
-                        AddSocket(m_fd, os.str());
-                    }
-                    else
+                    if (!ConnectHosts())
                         KTime::MSleep(1000);
                 }
             }
+            ReapConnections();
             PostForce(0);
         }     
         
+        /************************************
+        * Method:    监听配置的IP和端口
+        * Returns:   成功返回true失败返回false
+        *************************************/
+        bool ListenSelf()
+        {
+            std::pair<std::string, uint16_t> conf = GetConfig();
+            if ((m_fd = Listen(conf.first, conf.second)) <= 0)
+                return false;
+
+            if (!SetSocketNonBlock(m_fd))
+            {
+                CloseSocket(m_fd);
+                return false;
+            }
+
+            if (!SetPollEvent(m_fd))
+                return false;
+            m_connected = true;
+            return true;
+        }
+
         /************************************
         * Method:    轮询socket ID
         * Returns:   
@@ -276,6 +508,8 @@ namespace klib {
                     ProcessSocketEvent(fds[i].fd, fds[i].revents);
             }
 #elif defined(LINUX)
+            if (IsUringEnabled())
+                return PollUring();
             rc = epoll_wait(m_pfd, m_ps, MaxEvent, PollTimeOut);
             for (int i = 0; i < rc; ++i)
                 ProcessSocketEvent(m_ps[i].data.fd, m_ps[i].events);
@@ -302,6 +536,13 @@ namespace klib {
         *************************************/
         void ProcessSocketEvent(SocketType fd, short evt)
         {
+            if (IsConnecting(fd))
+            {
+                if (evt != 0)
+                    ConnectEvent(fd, evt);
+                return;
+            }
+
             if (evt & epollin)
             {
                 if (m_isServer && IsSelfSocket(fd))
@@ -334,39 +575,61 @@ namespace klib {
         }
 
         /************************************
-        * Method:    删除socket 
-        * Returns:   删除成功返回true否则返回false
+        * Method:    从轮询集合中移除socket，不关闭socket
+        * Returns:   移除成功返回true否则返回false
         * Parameter: fd socket ID
+        * Parameter: closing 是否将要关闭，io_uring 取消完成后由轮询线程关闭
         *************************************/
-        bool DeleteSocket(SocketType fd)
+        bool RemovePollEvent(SocketType fd, bool closing = false)
         {
-            bool rc = false;
+            KLockGuard<KMutex> lock(m_fdsMtx);
+            size_t idx = SocketIndex(fd);
+            if (idx >= m_fdPos.size() || m_fdPos[idx] == 0)
+                return false;
+
+            // 用最后一个元素填补空位，避免移动整个数组 //
+            size_t pos = m_fdPos[idx] - 1;
+            m_fdPos[idx] = 0;
+            if (pos + 1 != m_fds.size())
             {
-                KLockGuard<KMutex> lock(m_fdsMtx);
-                std::vector<pollfd>::iterator it = m_fds.begin();
-                while (it != m_fds.end())
-                {
-                    if (it->fd == fd)
-                    {
-                        m_fds.erase(it);
+                m_fds[pos] = m_fds.back();
+                m_fdPos[SocketIndex(m_fds[pos].fd)] = pos + 1;
+            }
+            m_fds.pop_back();
 #if defined(AIX)
-                        poll_ctl ev;
-                        ev.fd = fd;
-                        // PS_ADD PS_MOD PS_DELETE
-                        ev.cmd = PS_DELETE;
-                        //int rc = pollset_ctl(pollset_t ps, struct poll_ctl* pollctl_array,int array_length)
-                        pollset_ctl(m_pfd, &ev, 1);
+            poll_ctl ev;
+            ev.fd = fd;
+            // PS_ADD PS_MOD PS_DELETE
+            ev.cmd = PS_DELETE;
+            //int rc = pollset_ctl(pollset_t ps, struct poll_ctl* pollctl_array,int array_length)
+            pollset_ctl(m_pfd, &ev, 1);
 #elif defined(LINUX)
-                        epoll_event ev;
-                        ev.data.fd = fd;
-                        epoll_ctl(m_pfd, EPOLL_CTL_DEL, fd, &ev);
+            if (IsUringEnabled())
+            {
+                CancelUringEvent(fd, closing);
+                return true;
+            }
+            epoll_event ev;
+            ev.data.fd = fd;
+            epoll_ctl(m_pfd, EPOLL_CTL_DEL, fd, &ev);
 #endif
-                        rc = true;
-                        CloseSocket(fd);
-                        break;
-                    }
-                    ++it;
-                }
+            return true;
+        }
+
+        /************************************
+        * Method:    删除socket 
+        * Returns:   删除成功返回true否则返回false
+        * Parameter: fd socket ID
+        *************************************/
+        bool DeleteSocket(SocketType fd)
+        {
+            bool rc = RemovePollEvent(fd, true);
+            if (rc)
+            {
+                // 关闭socket 之前清空槽位，关闭后socket 可能被新连接复用 //
+                RecycleConnection(fd);
+                if (!IsUringEnabled())
+                    CloseSocket(fd);
             }
 
             if (IsSelfSocket(fd))
@@ -387,6 +650,9 @@ namespace klib {
             std::map<SocketType, std::string> socks;
 #if defined(WIN32)
             while ((nfd = ::accept(fd, (struct sockaddr*)&caddr, &addrlen)) != INVALID_SOCKET)
+#elif defined(LINUX)
+            // 接受时直接设置非阻塞，省去fcntl 调用 //
+            while ((nfd = ::accept4(fd, (struct sockaddr*)&caddr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC)) > 0)
 #else
             while ((nfd = ::accept(fd, (struct sockaddr*)&caddr, &addrlen)) > 0)
 #endif
@@ -399,7 +665,11 @@ namespace klib {
             std::map<SocketType, std::string>::const_iterator it = socks.begin();
             while (it != socks.end())
             {
+#if defined(LINUX)
+                AddSocket(it->first, it->second, true);
+#else
                 AddSocket(it->first, it->second);
+#endif
                 ++it;
             }
         }
@@ -409,29 +679,24 @@ namespace klib {
         * Returns:   
         * Parameter: fd socket ID
         * Parameter: ipport IP和端口
-        * Parameter: createConn 是否创建连接
+        * Parameter: nonBlocking socket 是否已经是非阻塞模式
         *************************************/
-        void AddSocket(SocketType fd, const std::string& ipport)
+        void AddSocket(SocketType fd, const std::string& ipport, bool nonBlocking = false)
         {
-            KLockGuard<KMutex> lock(m_connMtx);
-            KTcpConnection<MessageType>* recycle = NULL;
-            typename std::map<SocketType, KTcpConnection<MessageType>*>::iterator it = m_connections.begin();
-            while (it != m_connections.end())
+            if (!m_connections.IsValidIndex(SocketIndex(fd)))
             {
-                if (it->second->IsDisconnected())
-                {
-                    recycle = it->second;
-                    m_connections.erase(it);
-                    break;
-                }
-                ++it;
+                CloseSocket(fd);
+                printf("Socket out of connection table, fd:[%d]\n", fd);
+                return;
             }
 
-            if (!SetSocketNonBlock(fd))
+            KLockGuard<KMutex> lock(m_connMtx);
+            if (!nonBlocking && !SetSocketNonBlock(fd))
             {
                 CloseSocket(fd);
                 return;
             }
+            SetKeepAliveOption(fd);
 
             if (!SetPollEvent(fd))
             {
@@ -439,20 +704,25 @@ namespace klib {
                 return;
             }
 
+            KTcpConnection<MessageType>* recycle = GetRecycle();
             if (recycle)
             {
                 recycle->Connect(ipport, fd);
-                m_connections[fd] = recycle;
+                m_connections.Set(SocketIndex(fd), recycle);
+                AddTimer(fd, recycle->GetGeneration());
                 printf("Recycle connection started success\n");
             }
             else
             {
-                if (m_connections.size() < m_maxClient)
+                if (m_allocated < m_maxClient)
                 {
                     KTcpConnection<MessageType>* c = NewConnection(fd, ipport);
+                    c->SetThreadOptions(m_connOptions);
                     if (c->Start(m_isServer ? NmServer : NmClient, ipport, fd, m_needAuth))
                     {
-                        m_connections[fd] = c;
+                        m_connections.Set(SocketIndex(fd), c);
+                        ++m_allocated;
+                        AddTimer(fd, c->GetGeneration());
                         printf("New connection started success\n");
                     }
                     else
@@ -473,68 +743,807 @@ namespace klib {
                 m_connected = true;
         }
 
-        bool SetPollEvent(SocketType fd)
+        /************************************
+        * Method:    socket 在连接表中的下标
+        * Returns:   返回下标
+        * Parameter: fd socket ID
+        *************************************/
+        static inline size_t SocketIndex(SocketType fd)
         {
-            KLockGuard<KMutex> lock(m_fdsMtx);
-#if defined(AIX)
-            poll_ctl ev;
-            ev.fd = fd;
-            ev.events = POLLIN | POLLHUP | POLLERR;
-            // PS_ADD PS_MOD PS_DELETE
-            ev.cmd = PS_ADD;
-            //int rc = pollset_ctl(pollset_t ps, struct poll_ctl* pollctl_array,int array_length)
-            if (pollset_ctl(m_pfd, &ev, 1) < 0)
-            {
-                CloseSocket(fd);
-                return false;
-            };
-#elif defined(LINUX)
-            epoll_event ev;
-            ev.data.fd = fd;
-            ev.events = EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP;
-            if (epoll_ctl(m_pfd, EPOLL_CTL_ADD, fd, &ev) < 0)
-            {
-                CloseSocket(fd);
-                return false;
-            };
-#endif
-            pollfd p;
-            p.fd = fd;
 #if defined(WIN32)
-            p.events = epollin;
+            // windows socket 句柄是4的倍数 //
+            return size_t(fd) >> 2;
 #else
-            p.events = epollin | epollhup | epollerr;
+            return size_t(fd);
 #endif
-            m_fds.push_back(p);
-            return true;
-        };
+        }
 
         /************************************
-        * Method:    连接服务器
-        * Returns:   返回socket ID
-        * Parameter: ip 服务器IP
-        * Parameter: port 服务器端口
+        * Method:    从连接表中移除socket 对应的连接，放入回收队列
+        * Returns:   
+        * Parameter: fd socket ID
         *************************************/
-        SocketType Connect(const std::string& ip, uint16_t port) const
+        void RecycleConnection(SocketType fd)
         {
-            int fd = -1;
-            if ((fd = ::socket(AF_INET, SOCK_STREAM, 0)) < 0)
-                return -1;
+            KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(fd));
+            if (c == NULL || !m_connections.Remove(SocketIndex(fd), c))
+                return;
+
+            KLockGuard<KMutex> lock(m_recycleMtx);
+            if (m_recycleLimit > 0 && m_recycles.size() >= m_recycleLimit)
+            {
+                // 其他线程可能还持有该连接，纪元推进后再停止释放 //
+                m_epoch.Retire(c, &KTcpNetwork::RetireConnection, this);
+                return;
+            }
+            m_recycles.push_back(c);
+        }
+
+        /************************************
+        * Method:    连接已没有线程访问，放入待停止队列
+        * Returns:   
+        * Parameter: ptr 连接
+        * Parameter: ctx 网络对象
+        *************************************/
+        static void RetireConnection(void* ptr, void* ctx)
+        {
+            KTcpNetwork* net = static_cast<KTcpNetwork*>(ctx);
+            KLockGuard<KMutex> lock(net->m_recycleMtx);
+            net->m_closing.push_back(static_cast<KTcpConnection<MessageType>*>(ptr));
+        }
+
+        /************************************
+        * Method:    回收纪元已过的连接，线程退出后释放，在轮询线程中调用
+        * Returns:   
+        *************************************/
+        void ReapConnections()
+        {
+            m_epoch.Reclaim();
+            std::vector<KTcpConnection<MessageType>*> closing;
+            {
+                KLockGuard<KMutex> lock(m_recycleMtx);
+                if (m_closing.empty())
+                    return;
+                closing.swap(m_closing);
+            }
+
+            std::vector<KTcpConnection<MessageType>*> remains;
+            for (size_t i = 0; i < closing.size(); ++i)
+            {
+                KTcpConnection<MessageType>* c = closing[i];
+                c->Stop();
+                // 连接线程可能还在处理断开，不等待，下次再检查 //
+                if (c->IsThreadRunning())
+                {
+                    remains.push_back(c);
+                    continue;
+                }
+                c->WaitForStop();
+                delete c;
+
+                KLockGuard<KMutex> lock(m_connMtx);
+                --m_allocated;
+            }
+
+            if (!remains.empty())
+            {
+                KLockGuard<KMutex> lock(m_recycleMtx);
+                m_closing.insert(m_closing.end(), remains.begin(), remains.end());
+            }
+        }
+
+        /************************************
+        * Method:    取出一个已断开的连接
+        * Returns:   返回连接对象，没有返回NULL
+        *************************************/
+        KTcpConnection<MessageType>* GetRecycle()
+        {
+            KLockGuard<KMutex> lock(m_recycleMtx);
+            if (m_recycles.empty())
+                return NULL;
+            KTcpConnection<MessageType>* c = m_recycles.back();
+            m_recycles.pop_back();
+            return c;
+        }
+
+        /************************************
+        * Method:    添加连接的空闲检测定时器
+        * Returns:   
+        * Parameter: fd socket ID
+        * Parameter: generation 连接代数
+        *************************************/
+        void AddTimer(SocketType fd, uint32_t generation)
+        {
+            uint32_t interval = GetTimerInterval();
+            if (interval == 0)
+                return;
+
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            ConnectionTimer t;
+            t.fd = fd;
+            t.generation = generation;
+            m_timers.Add(now + interval, t);
+        }
+
+        /************************************
+        * Method:    获取定时器间隔，取空闲超时和心跳间隔中较小的非0值
+        * Returns:   返回毫秒数，0表示不需要定时器
+        *************************************/
+        uint32_t GetTimerInterval() const
+        {
+            if (m_idleTimeout == 0)
+                return m_heartbeat;
+            if (m_heartbeat == 0)
+                return m_idleTimeout;
+            return (m_idleTimeout < m_heartbeat ? m_idleTimeout : m_heartbeat);
+        }
+
+        /************************************
+        * Method:    处理到期的定时器，断开空闲超时的连接，给空闲连接发送心跳
+        * Returns:   
+        *************************************/
+        void CheckTimers()
+        {
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            std::vector<ConnectionTimer> timers;
+            if (!m_timers.GetExpired(now, timers))
+                return;
+
+            typename std::vector<ConnectionTimer>::const_iterator tit = timers.begin();
+            for (; tit != timers.end(); ++tit)
+            {
+                KLockGuard<KMutex> lock(m_connMtx);
+                KTcpConnection<MessageType>* c = m_connections.Get(SocketIndex(tit->fd));
+                // 连接已断开或者socket 已被新连接复用 //
+                if (c == NULL || !c->IsConnected() || c->GetGeneration() != tit->generation)
+                    continue;
+
+                uint64_t last = c->GetLastRecv();
+                if (m_idleTimeout > 0 && now - last >= m_idleTimeout)
+                {
+                    printf("%s idle timeout, disconnect\n", c->GetAddress().c_str());
+                    c->Disconnect(tit->fd);
+                    continue;
+                }
+
+                uint64_t next = now + GetTimerInterval();
+                if (m_idleTimeout > 0)
+                    next = last + m_idleTimeout;
+                if (m_heartbeat > 0)
+                {
+                    uint64_t hb = c->GetLastHeartbeat();
+                    if (hb < last)
+                        hb = last;
+                    if (now - hb >= m_heartbeat && c->Heartbeat(now))
+                        hb = now;
+                    if (hb + m_heartbeat < next)
+                        next = hb + m_heartbeat;
+                    if (next <= now)
+                        next = now + m_heartbeat;
+                }
+                m_timers.Add(next, *tit);
+            }
+        }
+
+        /************************************
+        * Method:    设置TCP keepalive选项
+        * Returns:   
+        * Parameter: fd socket ID
+        *************************************/
+        void SetKeepAliveOption(SocketType fd) const
+        {
+            if (m_keepIdle == 0)
+                return;
+#if defined(WIN32)
+            tcp_keepalive ka;
+            ka.onoff = 1;
+            ka.keepalivetime = m_keepIdle * 1000;
+            ka.keepaliveinterval = m_keepInterval * 1000;
+            DWORD bytes = 0;
+            WSAIoctl(fd, SIO_KEEPALIVE_VALS, &ka, sizeof(ka), NULL, 0, &bytes, NULL, NULL);
+#else
+            int on = 1;
+            int val = 0;
+            ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,
+                reinterpret_cast<const char*>(&on), sizeof(on));
+#if defined(TCP_KEEPIDLE)
+            val = m_keepIdle;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE,
+                reinterpret_cast<const char*>(&val), sizeof(val));
+#endif
+#if defined(TCP_KEEPINTVL)
+            val = m_keepInterval;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                reinterpret_cast<const char*>(&val), sizeof(val));
+#endif
+#if defined(TCP_KEEPCNT)
+            val = m_keepCount;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,
+                reinterpret_cast<const char*>(&val), sizeof(val));
+#endif
+#if defined(TCP_USER_TIMEOUT)
+            if (m_userTimeout > 0)
+            {
+                unsigned int ut = m_userTimeout;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                    reinterpret_cast<const char*>(&ut), sizeof(ut));
+            }
+#endif
+#endif
+        }
+
+        /************************************
+        * Method:    添加socket 到轮询集合
+        * Returns:   成功返回true失败返回false
+        * Parameter: fd socket ID
+        * Parameter: connecting 是否是正在连接的socket，是则等待可写事件
+        *************************************/
+        bool SetPollEvent(SocketType fd, bool connecting = false)
+        {
+            KLockGuard<KMutex> lock(m_fdsMtx);
+#if defined(AIX)
+            poll_ctl ev;
+            ev.fd = fd;
+            ev.events = (connecting ? POLLOUT : POLLIN) | POLLHUP | POLLERR;
+            // PS_ADD PS_MOD PS_DELETE
+            ev.cmd = PS_ADD;
+            //int rc = pollset_ctl(pollset_t ps, struct poll_ctl* pollctl_array,int array_length)
+            if (pollset_ctl(m_pfd, &ev, 1) < 0)
+            {
+                CloseSocket(fd);
+                return false;
+            };
+#elif defined(LINUX)
+            epoll_event ev;
+            ev.data.fd = fd;
+            ev.events = (connecting ? EPOLLOUT : (EPOLLIN | EPOLLET)) | EPOLLERR | EPOLLHUP;
+            if (IsUringEnabled() ? !AddUringEvent(fd, connecting) : epoll_ctl(m_pfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            {
+                CloseSocket(fd);
+                return false;
+            };
+#endif
+            pollfd p;
+            p.fd = fd;
+#if defined(WIN32)
+            p.events = (connecting ? epollout : epollin);
+#else
+            p.events = (connecting ? epollout : epollin) | epollhup | epollerr;
+#endif
+            size_t idx = SocketIndex(fd);
+            if (idx >= m_fdPos.size())
+                m_fdPos.resize(idx + 1, 0);
+            m_fdPos[idx] = m_fds.size() + 1;
+            m_fds.push_back(p);
+            return true;
+        };
+
+        /************************************
+        * Method:    创建io_uring
+        * Returns:   成功返回true失败返回false
+        *************************************/
+        bool InitUring()
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            return m_uring.IsValid() || m_uring.Initialize(UringEntries, UringBufCount, UringBufSize);
+#else
+            return false;
+#endif
+        }
+
+        /************************************
+        * Method:    socket 是否在轮询集合中
+        * Returns:   是返回true否则返回false
+        * Parameter: fd socket ID
+        *************************************/
+        bool IsPolling(SocketType fd)
+        {
+            KLockGuard<KMutex> lock(m_fdsMtx);
+            size_t idx = SocketIndex(fd);
+            return idx < m_fdPos.size() && m_fdPos[idx] != 0;
+        }
+
+        /************************************
+        * Method:    提交io_uring 请求：监听socket 接受连接，正在连接的socket 等待可写，其他socket 接收数据
+        * Returns:   成功返回true失败返回false
+        * Parameter: fd socket ID
+        * Parameter: connecting 是否是正在连接的socket
+        *************************************/
+        bool AddUringEvent(SocketType fd, bool connecting)
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            if (connecting)
+                return m_uring.Poll(fd, POLLOUT | POLLERR | POLLHUP);
+            if (m_isServer && IsSelfSocket(fd))
+                return m_uring.Accept(fd);
+            return m_uring.Recv(fd);
+#else
+            (void)fd;
+            (void)connecting;
+            return false;
+#endif
+        }
+
+        /************************************
+        * Method:    取消socket 上的io_uring 请求
+        * Returns:   
+        * Parameter: fd socket ID
+        * Parameter: closing 是否在取消完成后关闭socket
+        *************************************/
+        void CancelUringEvent(SocketType fd, bool closing)
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            // 先关闭读写让对端尽快感知，socket 在取消完成后再关闭，避免被复用后收到旧请求的完成事件 //
+            if (closing)
+                ::shutdown(fd, SHUT_RDWR);
+            if (!m_uring.Cancel(fd, closing) && closing)
+                CloseSocket(fd);
+#else
+            (void)fd;
+            (void)closing;
+#endif
+        }
+
+        /************************************
+        * Method:    处理io_uring 完成事件
+        * Returns:   返回完成事件个数
+        *************************************/
+        int PollUring()
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            int rc = m_uring.Wait(PollTimeOut);
+            std::map<SocketType, std::vector<KBuffer> > recvs;
+            std::vector<SocketType> disconnects;
+            std::vector<SocketType> closes;
+            KIoUring::Completion c;
+            while (m_uring.Peek(c))
+            {
+                switch (c.GetOpType())
+                {
+                case KIoUring::UoAccept:
+                    UringAccepted(c);
+                    break;
+                case KIoUring::UoRecv:
+                    UringReceived(c, recvs, disconnects);
+                    break;
+                case KIoUring::UoSend:
+                    UringSent(c);
+                    break;
+                case KIoUring::UoPoll:
+                    if (c.res > 0)
+                        ProcessSocketEvent(c.GetSocket(), short(c.res));
+                    break;
+                case KIoUring::UoClose:
+                    closes.push_back(c.GetSocket());
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            // 先分发数据再断开，最后关闭socket，保证本轮的事件不会落到复用socket 的新连接上 //
+            typename std::map<SocketType, std::vector<KBuffer> >::iterator it = recvs.begin();
+            for (; it != recvs.end(); ++it)
+            {
+                if (!SendDataToConnection(it->first, SocketEvent::SeRecv, it->second))
+                    Release(it->second);
+            }
+
+            std::vector<SocketType>::const_iterator dit = disconnects.begin();
+            for (; dit != disconnects.end(); ++dit)
+                DisconnectConnection(*dit);
+
+            std::vector<SocketType>::const_iterator cit = closes.begin();
+            for (; cit != closes.end(); ++cit)
+                CloseSocket(*cit);
+            return rc;
+#else
+            return 0;
+#endif
+        }
+
+#if defined(LINUX) && defined(__IO_URING__)
+        /************************************
+        * Method:    处理接受连接的完成事件
+        * Returns:   
+        * Parameter: c 完成事件
+        *************************************/
+        void UringAccepted(const KIoUring::Completion& c)
+        {
+            if (c.res >= 0)
+            {
+                SocketType nfd = c.res;
+                sockaddr_in caddr = { 0 };
+                SocketLength addrlen = sizeof(caddr);
+                ::getpeername(nfd, (struct sockaddr*)&caddr, &addrlen);
+                std::ostringstream os;
+                os << inet_ntoa(caddr.sin_addr) << ":" << ntohs(caddr.sin_port);
+                AddSocket(nfd, os.str(), true);
+            }
+            else if (c.res != -ECANCELED)
+            {
+                printf("io_uring accept failed, error:[%d]\n", -c.res);
+            }
+
+            // 多次触发的请求结束后重新提交 //
+            SocketType fd = c.GetSocket();
+            if (!c.HasMore() && c.res != -ECANCELED && IsPolling(fd) && !m_uring.Accept(fd))
+                printf("io_uring resubmit accept failed\n");
+        }
+
+        /************************************
+        * Method:    处理接收数据的完成事件
+        * Returns:   
+        * Parameter: c 完成事件
+        * Parameter: recvs 按socket 合并收到的数据
+        * Parameter: disconnects 需要断开的socket
+        *************************************/
+        void UringReceived(const KIoUring::Completion& c, std::map<SocketType, std::vector<KBuffer> >& recvs,
+            std::vector<SocketType>& disconnects)
+        {
+            SocketType fd = c.GetSocket();
+            if (c.HasBuffer())
+            {
+                uint16_t bid = c.GetBufferId();
+                if (c.res > 0)
+                {
+                    KBuffer b(c.res);
+                    b.ApendBuffer(m_uring.GetBuffer(bid), c.res);
+                    recvs[fd].push_back(b);
+                }
+                m_uring.RecycleBuffer(bid);
+            }
+
+            if (c.HasMore() || c.res == -ECANCELED || !IsPolling(fd))
+                return;
+
+            // 缓存不足或者内核结束了多次触发则重新提交，0表示对端关闭 //
+            if ((c.res > 0 || c.res == -ENOBUFS) && m_uring.Recv(fd))
+                return;
+            disconnects.push_back(fd);
+        }
+
+        /************************************
+        * Method:    提交链接发送，调用者持有m_sendMtx
+        * Returns:   成功返回true失败返回false
+        * Parameter: fd socket ID
+        *************************************/
+        bool FlushUringSend(SocketType fd)
+        {
+            UringSend& s = m_sends[fd];
+            UringSendChain* chain = new UringSendChain;
+            chain->fd = fd;
+            chain->done = 0;
+            chain->failed = false;
+            chain->bufs.swap(s.pending);
+            chain->submitted = m_uring.Send(fd, &chain->bufs[0], chain->bufs.size(), chain);
+            if (chain->submitted == 0)
+            {
+                s.pending.swap(chain->bufs);
+                delete chain;
+                return false;
+            }
+
+            // 提交队列放不下的部分等本次发送完成后再提交 //
+            if (chain->submitted < chain->bufs.size())
+            {
+                s.pending.assign(chain->bufs.begin() + chain->submitted, chain->bufs.end());
+                chain->bufs.resize(chain->submitted);
+            }
+            s.inflight = true;
+            return true;
+        }
+
+        /************************************
+        * Method:    处理发送的完成事件，一次链接发送全部完成后提交下一次
+        * Returns:   
+        * Parameter: c 完成事件
+        *************************************/
+        void UringSent(const KIoUring::Completion& c)
+        {
+            UringSendChain* chain = static_cast<UringSendChain*>(c.GetContext());
+            if (c.res != int32_t(chain->bufs[chain->done].GetSize()))
+                chain->failed = true;
+            if (++chain->done < chain->submitted)
+                return;
+
+            SocketType fd = chain->fd;
+            bool failed = chain->failed;
+            {
+                KLockGuard<KMutex> lock(m_sendMtx);
+                typename std::map<SocketType, UringSend>::iterator it = m_sends.find(fd);
+                if (it != m_sends.end())
+                {
+                    if (failed || it->second.pending.empty() || !FlushUringSend(fd))
+                    {
+                        failed = (failed || !it->second.pending.empty());
+                        Release(it->second.pending);
+                        m_sends.erase(it);
+                    }
+                }
+            }
+
+            Release(chain->bufs);
+            delete chain;
+            if (failed)
+                DisconnectConnection(fd);
+        }
+#endif
+
+        /************************************
+        * Method:    io_uring 发送数据，同一socket 一次只有一组链接发送在进行
+        * Returns:   成功返回true失败返回false
+        * Parameter: fd socket ID
+        * Parameter: head 先发送的数据
+        * Parameter: bufs 待发送的数据，调用后由轮询线程负责释放
+        *************************************/
+        bool SendUring(SocketType fd, const std::string& head, std::vector<KBuffer>& bufs)
+        {
+#if defined(LINUX) && defined(__IO_URING__)
+            KLockGuard<KMutex> lock(m_sendMtx);
+            UringSend& s = m_sends[fd];
+            if (!head.empty())
+            {
+                KBuffer b(head.size());
+                b.ApendBuffer(head.c_str(), head.size());
+                s.pending.push_back(b);
+            }
+            s.pending.insert(s.pending.end(), bufs.begin(), bufs.end());
+            bufs.clear();
+            if (s.inflight || s.pending.empty())
+                return true;
+
+            if (!FlushUringSend(fd))
+            {
+                Release(s.pending);
+                m_sends.erase(fd);
+                return false;
+            }
+            return true;
+#else
+            (void)fd;
+            (void)head;
+            (void)bufs;
+            return false;
+#endif
+        }
+
+        /************************************
+        * Method:    并行连接候选主机，先连上的胜出
+        * Returns:   本轮所有候选主机都连接失败返回false，否则返回true
+        *************************************/
+        bool ConnectHosts()
+        {
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            if (m_pendings.empty() && m_candidates.empty())
+            {
+                GetConfigs(m_candidates);
+                m_candidateIndex = 0;
+            }
+
+            // 没有进行中的连接时立即发起下一个，否则错开m_connectStagger毫秒再发起 //
+            while (!m_connected && m_candidateIndex < m_candidates.size()
+                && (m_pendings.empty() || (m_pendings.size() < m_connectParallel
+                    && now - m_lastConnectStart >= m_connectStagger)))
+            {
+                std::pair<std::string, uint16_t> conf = m_candidates[m_candidateIndex++];
+                StartConnect(conf.first, conf.second, now);
+            }
+
+            if (!m_pendings.empty())
+            {
+                PollSocket();
+                KTime::NowMillisecond(now);
+                ExpireConnects(now);
+            }
+
+            if (m_connected || !m_pendings.empty() || m_candidateIndex < m_candidates.size())
+                return true;
+
+            m_candidates.clear();
+            m_candidateIndex = 0;
+            return false;
+        }
+
+        /************************************
+        * Method:    发起非阻塞连接
+        * Returns:   
+        * Parameter: ip 服务器IP
+        * Parameter: port 服务器端口
+        * Parameter: now 当前毫秒数
+        *************************************/
+        void StartConnect(const std::string& ip, uint16_t port, uint64_t now)
+        {
+            bool inProgress = false;
+            SocketType fd = Connect(ip, port, inProgress);
+            if (fd <= 0)
+            {
+                printf("Connect to %s:%d failed\n", ip.c_str(), port);
+                return;
+            }
+
+            if (!inProgress)
+            {
+                ConnectSuccess(fd, ip, port);
+                return;
+            }
+
+            // SetPollEvent 失败时会关闭socket //
+            if (SetPollEvent(fd, true))
+            {
+                PendingConnect pc;
+                pc.fd = fd;
+                pc.ip = ip;
+                pc.port = port;
+                pc.start = now;
+                m_pendings.push_back(pc);
+                m_lastConnectStart = now;
+            }
+        }
+
+        /************************************
+        * Method:    是否是正在连接的socket
+        * Returns:   
+        * Parameter: fd socket ID
+        *************************************/
+        bool IsConnecting(SocketType fd) const
+        {
+            typename std::vector<PendingConnect>::const_iterator it = m_pendings.begin();
+            while (it != m_pendings.end())
+            {
+                if (it->fd == fd)
+                    return true;
+                ++it;
+            }
+            return false;
+        }
+
+        /************************************
+        * Method:    处理正在连接的socket 产生的event
+        * Returns:   
+        * Parameter: fd socket ID
+        * Parameter: evt 事件
+        *************************************/
+        void ConnectEvent(SocketType fd, short evt)
+        {
+            typename std::vector<PendingConnect>::iterator it = m_pendings.begin();
+            while (it != m_pendings.end() && it->fd != fd)
+                ++it;
+            if (it == m_pendings.end())
+                return;
+
+            PendingConnect pc = *it;
+            m_pendings.erase(it);
+            if ((evt & epollout) && !(evt & epollerr) && !(evt & epollhup) && GetSocketError(fd) == 0)
+            {
+                RemovePollEvent(fd);
+                ConnectSuccess(fd, pc.ip, pc.port);
+            }
+            else
+            {
+                ClosePendingSocket(fd);
+                printf("Connect to %s:%d failed\n", pc.ip.c_str(), pc.port);
+            }
+        }
+
+        /************************************
+        * Method:    取消正在连接的socket 的轮询并关闭，io_uring 下在取消完成后关闭，
+        *            避免socket 被复用后收到旧的轮询完成事件
+        * Returns:   
+        * Parameter: fd socket ID
+        *************************************/
+        void ClosePendingSocket(SocketType fd)
+        {
+            if (RemovePollEvent(fd, true) && IsUringEnabled())
+                return;
+            CloseSocket(fd);
+        }
+
+        /************************************
+        * Method:    关闭超时的连接
+        * Returns:   
+        * Parameter: now 当前毫秒数
+        *************************************/
+        void ExpireConnects(uint64_t now)
+        {
+            typename std::vector<PendingConnect>::iterator it = m_pendings.begin();
+            while (it != m_pendings.end())
+            {
+                if (now - it->start >= m_connectTimeout)
+                {
+                    ClosePendingSocket(it->fd);
+                    printf("Connect to %s:%d timeout\n", it->ip.c_str(), it->port);
+                    it = m_pendings.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+
+        /************************************
+        * Method:    连接成功，取消其他进行中的连接
+        * Returns:   
+        * Parameter: fd socket ID
+        * Parameter: ip 服务器IP
+        * Parameter: port 服务器端口
+        *************************************/
+        void ConnectSuccess(SocketType fd, const std::string& ip, uint16_t port)
+        {
+            typename std::vector<PendingConnect>::iterator it = m_pendings.begin();
+            while (it != m_pendings.end())
+            {
+                ClosePendingSocket(it->fd);
+                ++it;
+            }
+            m_pendings.clear();
+            m_candidates.clear();
+            m_candidateIndex = 0;
+
+            OnConfigConnected(ip, port);
+            std::ostringstream os;
+            os << ip << ":" << port;
+            m_fd = fd;
+            AddSocket(m_fd, os.str());
+        }
+
+        /************************************
+        * Method:    非阻塞连接服务器
+        * Returns:   返回socket ID
+        * Parameter: ip 服务器IP
+        * Parameter: port 服务器端口
+        * Parameter: inProgress 连接是否仍在进行中
+        *************************************/
+        SocketType Connect(const std::string& ip, uint16_t port, bool& inProgress) const
+        {
+            int fd = -1;
+            if ((fd = ::socket(AF_INET, SOCK_STREAM, 0)) < 0)
+                return -1;
 
             DisableNagle(fd);
+            if (!SetSocketNonBlock(fd))
+            {
+                CloseSocket(fd);
+                return 0;
+            }
 
             sockaddr_in server;
             server.sin_family = AF_INET;
             server.sin_port = htons(port);
             server.sin_addr.s_addr = inet_addr(ip.c_str());
+            inProgress = false;
             if (::connect(fd, (sockaddr*)(&server), sizeof(server)) != 0)
             {
-                CloseSocket(fd);
-                return 0;
+#if defined(WIN32)
+                if (KError::ErrorCode() != WSAEWOULDBLOCK)
+#else
+                if (errno != EINPROGRESS)
+#endif
+                {
+                    CloseSocket(fd);
+                    return 0;
+                }
+                inProgress = true;
             }
             return fd;
         }
 
+        /************************************
+        * Method:    获取socket 错误码
+        * Returns:   返回错误码，0表示无错误
+        * Parameter: fd socket ID
+        *************************************/
+        int GetSocketError(SocketType fd) const
+        {
+            int err = 0;
+            SocketLength len = sizeof(err);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &len) != 0)
+                return KError::ErrorCode();
+            return err;
+        }
+
         /************************************
         * Method:    监听IP和port端口
         * Returns:   返回socket ID
@@ -548,6 +1557,8 @@ namespace klib {
                 return -1;
 
             ReuseAddress(fd);
+            if (m_reuseShards > 0)
+                ReusePort(fd);
             DisableNagle(fd);
 
             sockaddr_in server;
@@ -560,14 +1571,53 @@ namespace klib {
                 return 0;
             }
 
-            if (::listen(fd, 200) != 0)
+            if (::listen(fd, m_backlog) != 0)
             {
                 CloseSocket(fd);
                 return -2;
             }
+
+            if (m_reuseCpu)
+                AttachCpuFilter(fd);
             return fd;
         }
 
+        /************************************
+        * Method:    socket 设置端口复用属性
+        * Returns:   
+        * Parameter: fd socket ID
+        *************************************/
+        void ReusePort(SocketType fd) const
+        {
+#if defined(SO_REUSEPORT)
+            int on = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+                reinterpret_cast<const char*>(&on), sizeof(on));
+#endif
+        }
+
+        /************************************
+        * Method:    给端口复用组挂载按CPU 分发的BPF 程序
+        * Returns:   
+        * Parameter: fd 监听socket ID
+        *************************************/
+        void AttachCpuFilter(SocketType fd) const
+        {
+#if defined(LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+            // A = 收包CPU % 分片数，返回值即复用组内socket 的下标 //
+            sock_filter code[] = {
+                { BPF_LD | BPF_W | BPF_ABS, 0, 0, uint32_t(SKF_AD_OFF + SKF_AD_CPU) },
+                { BPF_ALU | BPF_MOD | BPF_K, 0, 0, m_reuseShards },
+                { BPF_RET | BPF_A, 0, 0, 0 }
+            };
+            sock_fprog prog;
+            prog.len = sizeof(code) / sizeof(code[0]);
+            prog.filter = code;
+            if (::setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0)
+                printf("Attach reuseport cpu filter failed, error:[%d]\n", KError::ErrorCode());
+#endif
+        }
+
         /************************************
         * Method:    关闭socket
         * Returns:   
@@ -629,6 +1679,60 @@ namespace klib {
         }
 
     private:
+        /**
+        正在进行中的连接
+        **/
+        struct PendingConnect
+        {
+            SocketType fd;
+            std::string ip;
+            uint16_t port;
+            uint64_t start;
+        };
+
+        /**
+        连接空闲检测定时器
+        **/
+        struct ConnectionTimer
+        {
+            SocketType fd;
+            uint32_t generation;
+        };
+
+#if defined(LINUX) && defined(__IO_URING__)
+        /**
+        socket 的io_uring 发送状态
+        **/
+        struct UringSend
+        {
+            // 是否有链接发送在进行 //
+            bool inflight;
+            // 等待发送的数据 //
+            std::vector<KBuffer> pending;
+
+            UringSend() :inflight(false) {}
+        };
+
+        /**
+        一组链接发送
+        **/
+        struct UringSendChain
+        {
+            SocketType fd;
+            std::vector<KBuffer> bufs;
+            // 已提交和已完成的个数 //
+            size_t submitted;
+            size_t done;
+            bool failed;
+        };
+#endif
+
+        /************************************
+        * Method:    分配连接代数，由连接在每次连接时调用
+        * Returns:   返回新的代数
+        *************************************/
+        inline uint32_t NextGeneration() { return ++m_generation; }
+
         template<typename T>
         friend class KTcpConnection;
 #if defined(AIX)
@@ -637,11 +1741,20 @@ namespace klib {
 #elif defined(LINUX)
         int m_pfd;
         epoll_event m_ps[MaxEvent];
+#endif
+#if defined(LINUX) && defined(__IO_URING__)
+        KIoUring m_uring;
+        // io_uring 发送互斥量 //
+        KMutex m_sendMtx;
+        // io_uring 发送状态 //
+        std::map<SocketType, UringSend> m_sends;
 #endif
         // socket 互斥量 //
         KMutex m_fdsMtx;
         // socket 集合 //
         std::vector<pollfd> m_fds;
+        // socket 在集合中的位置加1，按socket 下标索引，0表示不在集合中 //
+        std::vector<size_t> m_fdPos;
         // socket id //
         SocketType m_fd;
         // IP //
@@ -658,8 +1771,58 @@ namespace klib {
         uint16_t m_maxClient;
         // 连接对象互斥量 //
         KMutex m_connMtx;
-        // 连接缓存 //
-        std::map<SocketType, KTcpConnection<MessageType>*> m_connections;
+        // 连接缓存，按socket 索引 //
+        KSlotTable<KTcpConnection<MessageType> > m_connections;
+        // 已创建的连接个数 //
+        uint16_t m_allocated;
+        // 回收连接互斥量 //
+        KMutex m_recycleMtx;
+        // 已断开待复用的连接 //
+        std::vector<KTcpConnection<MessageType>*> m_recycles;
+        // 回收队列长度，超过时释放连接 //
+        size_t m_recycleLimit;
+        // 已过纪元等待线程退出的连接 //
+        std::vector<KTcpConnection<MessageType>*> m_closing;
+        // 保护不加锁读取的连接对象 //
+        KEpoch m_epoch;
+        // 最近分配的连接代数 //
+        AtomicInteger<uint32_t> m_generation;
+        // 监听队列长度 //
+        int m_backlog;
+        // 复用端口的服务对象个数 //
+        uint16_t m_reuseShards;
+        // 是否按CPU 分发连接 //
+        bool m_reuseCpu;
+        // 连接线程选项 //
+        KThreadOptions m_connOptions;
+        // 连接超时毫秒数 //
+        uint32_t m_connectTimeout;
+        // 相邻两次发起连接的间隔毫秒数 //
+        uint32_t m_connectStagger;
+        // 同时尝试连接的主机个数 //
+        uint16_t m_connectParallel;
+        // 候选主机 //
+        std::vector<std::pair<std::string, uint16_t> > m_candidates;
+        // 下一个候选主机 //
+        size_t m_candidateIndex;
+        // 最近一次发起连接的毫秒数 //
+        uint64_t m_lastConnectStart;
+        // 进行中的连接 //
+        std::vector<PendingConnect> m_pendings;
+        // 空闲超时毫秒数 //
+        uint32_t m_idleTimeout;
+        // 心跳间隔毫秒数 //
+        uint32_t m_heartbeat;
+        // keepalive 空闲秒数 //
+        uint32_t m_keepIdle;
+        // keepalive 探测间隔秒数 //
+        uint32_t m_keepInterval;
+        // keepalive 探测次数 //
+        uint32_t m_keepCount;
+        // TCP_USER_TIMEOUT 毫秒数 //
+        uint32_t m_userTimeout;
+        // 空闲检测定时器 //
+        KTimerQueue<ConnectionTimer> m_timers;
     };
 };
 
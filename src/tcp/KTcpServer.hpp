@@ -23,7 +23,7 @@ namespace klib {
         * Parameter: hosts 格式："1.1.1.1:1234,2.2.2.2:2345"
         * Parameter: needAuth  是否需要授权
         *************************************/
-        bool Start(const std::string& hosts, bool needAuth = false)
+        bool Start(const std::string& hosts, bool needAuth = false, PollBackend backend = PbDefault)
         {
             std::vector<std::string> brokers;
             klib::KStringUtility::SplitString(hosts, ",", brokers);
@@ -55,7 +55,7 @@ namespace klib {
             }
 
             m_it = m_hostip.begin();
-            return KTcpNetwork<MessageType>::Start(m_it->first, m_it->second, true, needAuth);
+            return KTcpNetwork<MessageType>::Start(m_it->first, m_it->second, true, needAuth, backend);
         }
 
     protected:
@@ -20,6 +20,29 @@ namespace klib
         * Parameter: msg
         *************************************/
         bool Send(SocketType fd, const std::string& msg)
+        {
+            return Send(ConnectionHandle(fd), msg, false);
+        }
+
+        /************************************
+        * Method:    发送数据给句柄对应的客户端，socket 已被新连接复用时不发送
+        * Returns:   
+        * Parameter: h 连接句柄
+        * Parameter: msg
+        *************************************/
+        bool Send(const ConnectionHandle& h, const std::string& msg)
+        {
+            return Send(h, msg, true);
+        }
+
+    protected:
+        virtual KTcpConnection<KWebsocketMessage>* NewConnection(SocketType fd, const std::string& ipport)
+        {
+            return new KTcpWebsocket(this);
+        }
+
+    private:
+        bool Send(const ConnectionHandle& h, const std::string& msg, bool checkGeneration)
         {
             KWebsocketMessage wmsg;
             wmsg.Initialize(msg);
@@ -27,19 +50,15 @@ namespace klib
             wmsg.Serialize(buf);
             std::vector<KBuffer> bufs;
             bufs.push_back(buf);
-            if (!SendDataToConnection(fd, SocketEvent::SeSent, bufs))
+            bool sent = (checkGeneration ? SendDataToConnection(h, SocketEvent::SeSent, bufs)
+                : SendDataToConnection(h.fd, SocketEvent::SeSent, bufs));
+            if (!sent)
             {
                 buf.Release();
                 return false;
             }
             return true;
         }
-
-    protected:
-        virtual KTcpConnection<KWebsocketMessage>* NewConnection(SocketType fd, const std::string& ipport)
-        {
-            return new KTcpWebsocket(this);
-        }
     };
 };
 #endif
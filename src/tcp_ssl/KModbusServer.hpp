@@ -24,15 +24,24 @@ namespace klib
         *************************************/
         bool Send(SocketType fd, const KBuffer& msg)
         {
-            KModbusMessage wmsg(0xff, 0x04);
-            wmsg.InitializeResponse(0, msg.GetSize(), msg);
-            klib::KBuffer buf;
-            wmsg.Serialize(buf);
             std::vector<KBuffer> bufs;
-            bufs.push_back(buf);
+            Serialize(msg, bufs);
             return SendDataToConnection(fd, SocketEvent::SeSent, bufs);
         }
 
+        /************************************
+        * Method:    发送数据给句柄对应的客户端，socket 已被新连接复用时不发送
+        * Returns:   成功返回true失败false
+        * Parameter: h 连接句柄
+        * Parameter: msg 数据
+        *************************************/
+        bool Send(const ConnectionHandle& h, const KBuffer& msg)
+        {
+            std::vector<KBuffer> bufs;
+            Serialize(msg, bufs);
+            return SendDataToConnection(h, SocketEvent::SeSent, bufs);
+        }
+
     protected:
         /************************************
         * Method:    创建新连接
@@ -44,6 +53,22 @@ namespace klib
         {
             return new KTcpModbus(this);
         }
+
+    private:
+        /************************************
+        * Method:    打包成modbus 响应
+        * Returns:   
+        * Parameter: msg 数据
+        * Parameter: bufs 打包后的数据
+        *************************************/
+        void Serialize(const KBuffer& msg, std::vector<KBuffer>& bufs)
+        {
+            KModbusMessage wmsg(0xff, 0x04);
+            wmsg.InitializeResponse(0, msg.GetSize(), msg);
+            klib::KBuffer buf;
+            wmsg.Serialize(buf);
+            bufs.push_back(buf);
+        }
     };
 };
 
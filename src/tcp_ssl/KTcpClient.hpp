@@ -87,6 +87,35 @@ namespace klib {
             }
         }
 
+        /************************************
+        * Method:    获取所有候选配置，从上次连接成功的主机开始
+        * Returns:   
+        * Parameter: confs 候选IP和端口
+        *************************************/
+        virtual void GetConfigs(std::vector<std::pair<std::string, uint16_t> >& confs) const
+        {
+            std::map<std::string, uint16_t>::const_iterator it = m_it;
+            do
+            {
+                confs.push_back(*it);
+                if (++it == m_hostip.end())
+                    it = m_hostip.begin();
+            } while (it != m_it);
+        }
+
+        /************************************
+        * Method:    记录连接成功的主机，下次优先连接
+        * Returns:   
+        * Parameter: ip 连接IP
+        * Parameter: port 连接端口
+        *************************************/
+        virtual void OnConfigConnected(const std::string& ip, uint16_t /*port*/)
+        {
+            std::map<std::string, uint16_t>::const_iterator it = m_hostip.find(ip);
+            if (it != m_hostip.end())
+                m_it = it;
+        }
+
     private:
         std::map<std::string, uint16_t> m_hostip;
         mutable std::map<std::string, uint16_t>::const_iterator m_it;
@@ -1,6 +1,7 @@
 #pragma once
 #if defined(WIN32)
 #include <WS2tcpip.h>
+#include <mstcpip.h>
 #elif defined(AIX)
 #include <fcntl.h>
 #include <arpa/inet.h>
@@ -23,6 +24,7 @@
 #include <sys/epoll.h>
 #include <sys/poll.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 #else
 #error "WINDOWS AIX HPUX LINUX supported only"
 #endif // defined(WIN32)
@@ -278,6 +280,20 @@ namespace klib {
         }
     };
 
+    /**
+    连接句柄，socket 关闭后会被新连接复用，用代数识别句柄是否过期
+    **/
+    struct ConnectionHandle
+    {
+        SocketType fd;
+        uint32_t generation;
+
+        ConnectionHandle(SocketType fd = 0, uint32_t generation = 0)
+            :fd(fd), generation(generation)
+        {
+        }
+    };
+
     enum NetworkState
     {
         // 连接上，断开，就绪 //
@@ -351,6 +367,10 @@ namespace klib {
                 dat.push_back(b);
                 bytes += rc;
             }
+            else if (rc == 0) // 对端关闭连接
+            {
+                return -1;
+            }
             else
             {
 #if defined(WIN32)
@@ -380,7 +400,8 @@ namespace klib {
     public:
         KTcpConnection(KTcpNetwork<MessageType> *poller)
             :KEventObject<SocketEvent>("Socket event thread", 1000),
-            m_state(NsUndefined), m_mode(NmUndefined), m_poller(poller),m_ssl(NULL)
+            m_state(NsUndefined), m_mode(NmUndefined), m_poller(poller),m_ssl(NULL),
+            m_lastRecv(0), m_lastHeartbeat(0), m_generation(0)
         {
 
         }
@@ -422,6 +443,9 @@ namespace klib {
                 m_auth.authSent = true;
             m_ipport = ipport;
             m_fd = fd;
+            m_generation.Store(m_poller->NextGeneration(), MoRelease);
+            m_lastHeartbeat = 0;
+            Touch();
             OnConnected(GetMode(), ipport);
         }
 
@@ -455,7 +479,7 @@ namespace klib {
         * Method:    是否断开
         * Returns:   是返回true否则返回false
         *************************************/
-        inline bool IsDisconnected() const { return m_state == NsDisconnected; }
+        inline bool IsDisconnected() const { return GetState() == NsDisconnected; }
 
         /************************************
         * Method:    获取socket
@@ -472,24 +496,59 @@ namespace klib {
         * Returns:   返回IP和端口
         *************************************/
         inline  const std::string& GetAddress() const { return m_ipport; }
+
+        /************************************
+        * Method:    获取连接代数，每次连接从网络对象取新值，同一网络对象内不重复，用于识别socket 复用
+        * Returns:   返回代数
+        *************************************/
+        inline uint32_t GetGeneration() const { return m_generation.Load(MoAcquire); }
+
+        /************************************
+        * Method:    获取连接句柄，连接断开后句柄失效
+        * Returns:   返回句柄
+        *************************************/
+        inline ConnectionHandle GetHandle() const { return ConnectionHandle(m_fd, GetGeneration()); }
+
+        /************************************
+        * Method:    获取最后一次收到数据的毫秒数
+        * Returns:   返回毫秒数
+        *************************************/
+        inline uint64_t GetLastRecv() const { return m_lastRecv.Load(MoRelaxed); }
+
+        /************************************
+        * Method:    获取最后一次发送心跳的毫秒数
+        * Returns:   返回毫秒数
+        *************************************/
+        inline uint64_t GetLastHeartbeat() const { return m_lastHeartbeat; }
+
+        /************************************
+        * Method:    发送心跳
+        * Returns:   协议支持心跳并发送成功返回true否则返回false
+        * Parameter: now 当前毫秒数
+        *************************************/
+        bool Heartbeat(uint64_t now)
+        {
+            m_lastHeartbeat = now;
+            return OnHeartbeat();
+        }
         
     protected:
         /************************************
         * Method:    获取模式
         * Returns:   返回模式
         *************************************/
-        inline NetworkMode GetMode() const { return static_cast<NetworkMode>(int32_t(m_mode)); }
+        inline NetworkMode GetMode() const { return static_cast<NetworkMode>(m_mode.Load(MoRelaxed)); }
         /************************************
         * Method:    获取状态
         * Returns:   返回状态
         *************************************/
-        inline NetworkState GetState() const { return static_cast<NetworkState>(int32_t(m_state)); }
+        inline NetworkState GetState() const { return static_cast<NetworkState>(m_state.Load(MoAcquire)); }
         /************************************
         * Method:    设置状态
         * Returns:   
         * Parameter: s 状态
         *************************************/
-        inline void SetState(NetworkState s) const { m_state = s; }
+        inline void SetState(NetworkState s) const { m_state.Store(s, MoRelease); }
         /************************************
         * Method:    连接触发操作
         * Returns:   
@@ -564,6 +623,50 @@ namespace klib {
         {
             return !m_auth.need;
         }
+        /************************************
+        * Method:    触发心跳，由轮询线程在连接空闲时调用
+        * Returns:   发送了心跳返回true，协议不支持心跳返回false
+        *************************************/
+        virtual bool OnHeartbeat()
+        {
+            return false;
+        }
+        /************************************
+        * Method:    判断是否为心跳的响应，心跳响应在分发前丢弃
+        * Returns:   是心跳响应返回true
+        * Parameter: msg 消息
+        *************************************/
+        virtual bool IsHeartbeat(const MessageType& /*msg*/) const
+        {
+            return false;
+        }
+        /************************************
+        * Method:    释放不再分发的消息持有的缓存
+        * Returns:   
+        * Parameter: msg 消息
+        *************************************/
+        virtual void ReleaseMessage(MessageType& /*msg*/)
+        {
+        }
+        /************************************
+        * Method:    发送数据，由连接线程写socket
+        * Returns:   入队成功返回true否则返回false
+        * Parameter: bufs 数据，入队失败时释放
+        *************************************/
+        bool SendData(const std::vector<KBuffer>& bufs)
+        {
+            SocketEvent e;
+            e.fd = m_fd;
+            e.ssl = m_ssl;
+            e.ev = SocketEvent::SeSent;
+            e.dat1 = bufs;
+            if (!IsConnected() || !Post(e))
+            {
+                m_poller->Release(e.dat1);
+                return false;
+            }
+            return true;
+        }
 
     private:
         /************************************
@@ -635,6 +738,7 @@ namespace klib {
                 }
                 case SocketEvent::SeRecv:
                 {
+                    Touch();
                     if (bufs.empty())
                     {
                         std::vector<KBuffer> buffers;
@@ -668,6 +772,37 @@ namespace klib {
             }
         }
         /************************************
+        * Method:    记录收到数据的时间
+        * Returns:   
+        *************************************/
+        inline void Touch()
+        {
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            m_lastRecv.Store(now, MoRelaxed);
+        }
+        /************************************
+        * Method:    丢弃并释放心跳响应，保持其余消息的顺序
+        * Returns:   
+        * Parameter: msgs 消息
+        *************************************/
+        void DropHeartbeats(std::vector<MessageType>& msgs)
+        {
+            size_t n = 0;
+            for (size_t i = 0; i < msgs.size(); ++i)
+            {
+                if (IsHeartbeat(msgs[i]))
+                {
+                    ReleaseMessage(msgs[i]);
+                    continue;
+                }
+                if (n != i)
+                    msgs[n] = msgs[i];
+                ++n;
+            }
+            msgs.resize(n);
+        }
+        /************************************
         * Method:    解析数据
         * Returns:   
         * Parameter: fd socket
@@ -687,6 +822,7 @@ namespace klib {
                 {
                     std::vector<MessageType> msgs;
                     Parse(bufs, msgs, m_remain);
+                    DropHeartbeats(msgs);
                     if (!msgs.empty())
                         OnMessage(msgs);
                 }
@@ -715,5 +851,11 @@ namespace klib {
         Authorization m_auth;
         
         SSL* m_ssl;
+        // 最后一次收到数据的毫秒数 //
+        AtomicInteger<uint64_t> m_lastRecv;
+        // 最后一次发送心跳的毫秒数，只在轮询线程读写 //
+        uint64_t m_lastHeartbeat;
+        // 连接代数 //
+        AtomicInteger<uint32_t> m_generation;
     };
 };
@@ -13,6 +13,9 @@ namespace klib
 #define MaxRegisterCount 32765
 
 #define MaxModbusAddress 65535
+
+// 心跳保留的事务ID，客户端的普通请求不使用 //
+#define ModbusHeartbeatSeq 0xffff
     
     struct KModbusMessage :public KTcpMessage
     {
@@ -170,6 +173,16 @@ namespace klib
         *************************************/
         inline uint16_t GetSeq() const { return seq; }
         /************************************
+        * Method:    获取设备ID
+        * Returns:   返回设备ID
+        *************************************/
+        inline uint8_t GetDevice() const { return dev; }
+        /************************************
+        * Method:    获取功能码
+        * Returns:   返回功能码
+        *************************************/
+        inline uint8_t GetFunction() const { return func; }
+        /************************************
         * Method:    获取开始地址
         * Returns:   返回地址
         *************************************/
@@ -304,5 +317,45 @@ namespace klib
             printf("%s recv raw message, count:[%d]\n", ev.size());
             KTcpNetwork<KModbusMessage>::Release(const_cast<std::vector<KBuffer>&>(ev));
         }
+
+        /************************************
+        * Method:    心跳触发，客户端用保留的事务ID 发送读一个寄存器的请求
+        * Returns:   
+        *************************************/
+        virtual bool OnHeartbeat()
+        {
+            if (GetMode() != NmClient)
+                return false;
+
+            KModbusMessage msg(0xff, 0x04);
+            msg.InitializeRequest(ModbusHeartbeatSeq, 0, 1);
+            KBuffer buf;
+            msg.Serialize(buf);
+            std::vector<KBuffer> bufs;
+            bufs.push_back(buf);
+            return SendData(bufs);
+        }
+
+        /************************************
+        * Method:    客户端收到的心跳响应不交给应用
+        * Returns:   是心跳响应返回true
+        * Parameter: msg 消息
+        *************************************/
+        virtual bool IsHeartbeat(const KModbusMessage& msg) const
+        {
+            return GetMode() == NmClient && msg.GetSeq() == ModbusHeartbeatSeq
+                && msg.GetDevice() == 0xff && msg.GetFunction() == 0x04;
+        }
+
+        /************************************
+        * Method:    释放丢弃的消息的缓存
+        * Returns:   
+        * Parameter: msg 消息
+        *************************************/
+        virtual void ReleaseMessage(KModbusMessage& msg)
+        {
+            msg.ReleasePayload();
+            msg.ReleaseData();
+        }
     };
 };
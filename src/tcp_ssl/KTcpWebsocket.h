@@ -106,14 +106,27 @@ namespace klib
         * Parameter: msg
         *************************************/
         void Initialize(const std::string& msg)
+        {
+            Initialize(msg.c_str(), msg.size(), optext);
+        }
+
+        /************************************
+        * Method:    初始化指定类型的消息
+        * Returns:   
+        * Parameter: dat 数据
+        * Parameter: sz 数据大小
+        * Parameter: op 消息类型，如optext、opping、oppong
+        *************************************/
+        void Initialize(const char* dat, size_t sz, uint8_t op)
         {
             fin = finlast;
             reserved = 0;
-            opcode = optext;
+            opcode = op;
             mask = 0;
-            SetPayloadSize(msg.size());
+            SetPayloadSize(sz);
             memset(maskkey, 0, sizeof(maskkey));
-            payload.ApendBuffer(msg.c_str(), msg.size());
+            if (sz > 0)
+                payload.ApendBuffer(dat, sz);
         }
 
         /************************************
@@ -413,7 +426,37 @@ namespace klib
             KTcpNetwork<KWebsocketMessage>::Release(const_cast<std::vector<KBuffer>&>(ev));
         }
 
+        /************************************
+        * Method:    心跳触发，握手完成后发送ping
+        * Returns:   
+        *************************************/
+        virtual bool OnHeartbeat()
+        {
+            if (GetState() != NsReadyToWork)
+                return false;
+            return SendControl(KWebsocketMessage::opping, NULL, 0);
+        }
+
     private:
+        /************************************
+        * Method:    发送控制消息
+        * Returns:   
+        * Parameter: op 消息类型
+        * Parameter: dat 数据
+        * Parameter: sz 数据大小
+        *************************************/
+        bool SendControl(uint8_t op, const char* dat, size_t sz)
+        {
+            KWebsocketMessage wmsg;
+            wmsg.Initialize(dat, sz, op);
+            KBuffer buf;
+            wmsg.Serialize(buf);
+            wmsg.payload.Release();
+            std::vector<KBuffer> bufs;
+            bufs.push_back(buf);
+            return SendData(bufs);
+        }
+
         /************************************
         * Method:    获取key
         * Returns:   
@@ -512,6 +555,18 @@ namespace klib
                 msg.payload.Release();
                 break;
             }
+            case KWebsocketMessage::opping:
+            {
+                // 原样带回payload //
+                SendControl(KWebsocketMessage::oppong, msg.payload.GetData(), msg.payload.GetSize());
+                msg.payload.Release();
+                break;
+            }
+            case KWebsocketMessage::oppong:
+            {
+                msg.payload.Release();
+                break;
+            }
             default:
                 break;
             }
@@ -0,0 +1,65 @@
+#include "thread/KAdaptiveCondVariable.h"
+#include <climits>
+namespace klib {
+    KAdaptiveCondVariable::KAdaptiveCondVariable()
+        :m_sequence(0), m_mutex(NULL)
+    {
+    }
+
+    void KAdaptiveCondVariable::Notify() const
+    {
+        if (m_waiters == 0)
+        {
+            m_skipped.FetchAdd(1, MoRelaxed);
+            return;
+        }
+
+        KFutex::AddFetch(&m_sequence, 1);
+        m_notifies.FetchAdd(1, MoRelaxed);
+        KFutex::Wake(&m_sequence, 1);
+    }
+
+    void KAdaptiveCondVariable::NotifyAll() const
+    {
+        if (m_waiters == 0)
+        {
+            m_skipped.FetchAdd(1, MoRelaxed);
+            return;
+        }
+
+        int seq = KFutex::AddFetch(&m_sequence, 1);
+        m_notifies.FetchAdd(1, MoRelaxed);
+        const KAdaptiveMutex* mtx = m_mutex;
+        if (mtx)
+            KFutex::Requeue(&m_sequence, seq, &mtx->m_state);
+        else
+            KFutex::Wake(&m_sequence, INT_MAX);
+    }
+
+    void KAdaptiveCondVariable::GetStats(Stats& st) const
+    {
+        st.waits = m_waits;
+        st.timeouts = m_timeouts;
+        st.notifies = m_notifies;
+        st.skipped = m_skipped;
+    }
+
+    bool KAdaptiveCondVariable::WaitFor(const KAdaptiveMutex& mtx, int ms) const
+    {
+        // 在锁内读取序号，解锁后的通知都会改变序号，不会丢失 //
+        int seq = m_sequence;
+        m_mutex = &mtx;
+        ++m_waiters;
+        m_waits.FetchAdd(1, MoRelaxed);
+        mtx.Unlock();
+
+        bool rc = KFutex::Wait(&m_sequence, seq, ms);
+        --m_waiters;
+        if (!rc)
+            m_timeouts.FetchAdd(1, MoRelaxed);
+
+        // 可能是从互斥量上被唤醒，其他等待者还在互斥量上，必须按有等待者的状态加锁 //
+        mtx.LockContended();
+        return rc;
+    }
+};
@@ -0,0 +1,109 @@
+#ifndef _ADAPTIVECONDVARIABLE_HPP_
+#define _ADAPTIVECONDVARIABLE_HPP_
+
+#include <stdint.h>
+#include "thread/KException.h"
+#include "thread/KAtomic.h"
+#include "thread/KAdaptiveMutex.h"
+/**
+基于futex 的条件变量，与KAdaptiveMutex 配合使用
+没有等待者时通知不进入内核，NotifyAll只唤醒一个线程，其余的转移到互斥量上依次唤醒，避免惊群
+**/
+namespace klib {
+    class KAdaptiveCondVariable
+    {
+    public:
+        /**
+        统计
+        **/
+        struct Stats
+        {
+            // 等待次数 //
+            uint32_t waits;
+            // 超时次数 //
+            uint32_t timeouts;
+            // 进入内核的通知次数 //
+            uint32_t notifies;
+            // 没有等待者而省略的通知次数 //
+            uint32_t skipped;
+        };
+
+        KAdaptiveCondVariable();
+
+        /************************************
+        * Method:    通知
+        * Returns:
+        *************************************/
+        void Notify() const;
+
+        /************************************
+        * Method:    通知所有
+        * Returns:
+        *************************************/
+        void NotifyAll() const;
+
+        /************************************
+        * Method:    等待
+        * Returns:
+        * Parameter: lock 已加锁的KLockGuard<KAdaptiveMutex>
+        *************************************/
+        template <typename Lock>
+        void Wait(const Lock& lock) const;
+
+        /************************************
+        * Method:    等待ms毫秒
+        * Returns:   超时返回false
+        * Parameter: lock 已加锁的KLockGuard<KAdaptiveMutex>
+        * Parameter: ms
+        *************************************/
+        template <typename Lock>
+        bool TimedWait(const Lock& lock, const size_t& ms) const;
+
+        /************************************
+        * Method:    获取统计
+        * Returns:
+        * Parameter: st 统计
+        *************************************/
+        void GetStats(Stats& st) const;
+
+    private:
+        KAdaptiveCondVariable(const KAdaptiveCondVariable&);
+        KAdaptiveCondVariable& operator=(const KAdaptiveCondVariable&);
+
+        /************************************
+        * Method:    解锁并等待序号改变，返回前重新加锁
+        * Returns:   超时返回false
+        * Parameter: mtx 互斥量
+        * Parameter: ms 超时毫秒，小于0表示一直等待
+        *************************************/
+        bool WaitFor(const KAdaptiveMutex& mtx, int ms) const;
+
+    private:
+        // 每次通知加1 //
+        mutable volatile int m_sequence;
+        // 最近一次等待使用的互斥量，NotifyAll时把等待者转移到该互斥量上 //
+        mutable const KAdaptiveMutex* volatile m_mutex;
+        mutable AtomicInteger<int32_t> m_waiters;
+        mutable AtomicInteger<uint32_t> m_waits;
+        mutable AtomicInteger<uint32_t> m_timeouts;
+        mutable AtomicInteger<uint32_t> m_notifies;
+        mutable AtomicInteger<uint32_t> m_skipped;
+    };
+
+    template <typename Lock>
+    void KAdaptiveCondVariable::Wait(const Lock& lock) const
+    {
+        if (!lock.Acquired())
+            throw KException(__FILE__, __LINE__, "not acquired");
+        WaitFor(lock.m_tmtx, -1);
+    }
+
+    template <typename Lock>
+    bool KAdaptiveCondVariable::TimedWait(const Lock& lock, const size_t& ms) const
+    {
+        if (!lock.Acquired())
+            throw KException(__FILE__, __LINE__, "not acquired");
+        return WaitFor(lock.m_tmtx, int(ms));
+    }
+};
+#endif // !_ADAPTIVECONDVARIABLE_HPP_
@@ -0,0 +1,145 @@
+#include "thread/KAdaptiveMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KCondVariable.h"
+#include "util/KTime.h"
+#include <climits>
+#if defined(LINUX)
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+namespace klib {
+#if defined(LINUX)
+    bool KFutex::Wait(volatile int* addr, int val, int ms, bool shared)
+    {
+        timespec ts;
+        timespec* pts = NULL;
+        if (ms >= 0)
+        {
+            ts.tv_sec = ms / 1000;
+            ts.tv_nsec = (ms % 1000) * 1000000;
+            pts = &ts;
+        }
+        long rc = syscall(SYS_futex, addr, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val, pts, NULL, 0);
+        return !(rc != 0 && errno == ETIMEDOUT);
+    }
+
+    void KFutex::Wake(volatile int* addr, int count, bool shared)
+    {
+        syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+    }
+
+    void KFutex::Requeue(volatile int* addr, int val, volatile int* target)
+    {
+        // 值已改变说明有新的通知，全部唤醒 //
+        long rc = syscall(SYS_futex, addr, FUTEX_CMP_REQUEUE_PRIVATE, 1, (void*)(long)INT_MAX, target, val);
+        if (rc < 0)
+            Wake(addr, INT_MAX);
+    }
+#else
+    // 按地址散列的等待队列 //
+    static const size_t ParkBuckets = 64;
+    static KMutex s_parkMtx[ParkBuckets];
+    static KCondVariable s_parkCond[ParkBuckets];
+
+    static inline size_t ParkBucket(volatile int* addr)
+    {
+        return (size_t(addr) >> 4) % ParkBuckets;
+    }
+
+    bool KFutex::Wait(volatile int* addr, int val, int ms, bool shared)
+    {
+        if (shared)
+        {
+            // 等待队列不能跨进程，轮询 //
+            if (*addr == val && ms != 0)
+                KTime::MSleep(1);
+            return true;
+        }
+
+        size_t b = ParkBucket(addr);
+        KLockGuard<KMutex> lock(s_parkMtx[b]);
+        if (*addr != val)
+            return true;
+        if (ms < 0)
+        {
+            s_parkCond[b].Wait(lock);
+            return true;
+        }
+        return s_parkCond[b].TimedWait(lock, ms);
+    }
+
+    void KFutex::Wake(volatile int* addr, int count, bool shared)
+    {
+        if (shared)
+            return;
+
+        // 多个地址可能共用一个队列，只能全部唤醒 //
+        size_t b = ParkBucket(addr);
+        KLockGuard<KMutex> lock(s_parkMtx[b]);
+        s_parkCond[b].NotifyAll();
+    }
+
+    void KFutex::Requeue(volatile int* addr, int val, volatile int* target)
+    {
+        Wake(addr, INT_MAX);
+    }
+#endif
+
+    KAdaptiveMutex::KAdaptiveMutex(int maxSpins)
+        :m_state(Unlocked), m_maxSpins(maxSpins > 0 ? maxSpins : 0), m_spinAvg(0)
+    {
+    }
+
+    void KAdaptiveMutex::GetStats(Stats& st) const
+    {
+        st.contended = m_contended;
+        st.spinAcquired = m_spinAcquired;
+        st.parked = m_parked;
+        st.spinLimit = m_spinAvg * 2 + 10;
+        if (st.spinLimit > m_maxSpins)
+            st.spinLimit = m_maxSpins;
+    }
+
+    void KAdaptiveMutex::ResetStats()
+    {
+        m_contended = 0;
+        m_spinAcquired = 0;
+        m_parked = 0;
+    }
+
+    void KAdaptiveMutex::LockSlow() const
+    {
+        m_contended.FetchAdd(1, MoRelaxed);
+        int limit = m_spinAvg * 2 + 10;
+        if (limit > m_maxSpins)
+            limit = m_maxSpins;
+
+        for (int i = 0; i < limit; ++i)
+        {
+            KFutex::Pause();
+            // 先读再交换，避免自旋时反复独占缓存行 //
+            if (m_state == Unlocked && KFutex::CompareExchange(&m_state, Unlocked, Locked) == Unlocked)
+            {
+                m_spinAvg += (i - m_spinAvg) / 8;
+                m_spinAcquired.FetchAdd(1, MoRelaxed);
+                return;
+            }
+        }
+
+        if (limit > 0)
+            m_spinAvg += (limit - m_spinAvg) / 8;
+        LockContended();
+    }
+
+    void KAdaptiveMutex::LockContended() const
+    {
+        while (KFutex::Exchange(&m_state, Contended) != Unlocked)
+        {
+            m_parked.FetchAdd(1, MoRelaxed);
+            KFutex::Wait(&m_state, Contended);
+        }
+    }
+};
@@ -0,0 +1,221 @@
+#ifndef _ADAPTIVEMUTEX_HPP_
+#define _ADAPTIVEMUTEX_HPP_
+
+#include <stdint.h>
+#include <pthread.h>
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include "thread/KAtomic.h"
+/**
+自适应互斥量，先自旋等待一段时间，仍未获得锁再挂起(linux 使用futex，其他平台使用按地址散列的条件变量)
+自旋次数根据最近获得锁所需的次数自动调整，适用于临界区很短的场景，可直接用于KLockGuard
+**/
+namespace klib {
+    /**
+    futex 封装，非linux 平台用按地址散列的互斥量和条件变量模拟
+    **/
+    class KFutex
+    {
+    public:
+        /************************************
+        * Method:    *addr == val 时挂起，直到被唤醒或超时
+        * Returns:   超时返回false，否则返回true(可能是虚假唤醒)
+        * Parameter: addr 等待的地址
+        * Parameter: val 期望值
+        * Parameter: ms 超时毫秒，小于0表示一直等待
+        * Parameter: shared 地址在进程间共享内存中，非linux 平台退化为短暂休眠后返回
+        *************************************/
+        static bool Wait(volatile int* addr, int val, int ms = -1, bool shared = false);
+
+        /************************************
+        * Method:    唤醒在addr 上等待的线程
+        * Returns:
+        * Parameter: addr 等待的地址
+        * Parameter: count 唤醒个数
+        * Parameter: shared 地址在进程间共享内存中
+        *************************************/
+        static void Wake(volatile int* addr, int count, bool shared = false);
+
+        /************************************
+        * Method:    *addr == val 时唤醒一个在addr 上等待的线程，其余的转移到target 上等待
+        *            非linux 平台唤醒全部
+        * Returns:
+        * Parameter: addr 等待的地址
+        * Parameter: val 期望值
+        * Parameter: target 转移到的地址
+        *************************************/
+        static void Requeue(volatile int* addr, int val, volatile int* target);
+
+        /************************************
+        * Method:    比较并交换
+        * Returns:   返回原来的值
+        *************************************/
+        static inline int CompareExchange(volatile int* addr, int expected, int desired)
+        {
+#if defined(WIN32)
+            return InterlockedCompareExchange((volatile LONG*)addr, desired, expected);
+#else
+            return __sync_val_compare_and_swap(addr, expected, desired);
+#endif
+        }
+
+        /************************************
+        * Method:    交换
+        * Returns:   返回原来的值
+        *************************************/
+        static inline int Exchange(volatile int* addr, int val)
+        {
+#if defined(WIN32)
+            return InterlockedExchange((volatile LONG*)addr, val);
+#else
+            __sync_synchronize();
+            return __sync_lock_test_and_set(addr, val);
+#endif
+        }
+
+        /************************************
+        * Method:    顺序一致的读，x86 上是普通读
+        * Returns:   返回当前值
+        *************************************/
+        static inline int Load(volatile int* addr)
+        {
+#if defined(WIN32)
+            MemoryBarrier();
+            return *addr;
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_load_n(addr, __ATOMIC_SEQ_CST);
+#else
+            __sync_synchronize();
+            return *addr;
+#endif
+        }
+
+        /************************************
+        * Method:    加上val
+        * Returns:   返回相加后的值
+        *************************************/
+        static inline int AddFetch(volatile int* addr, int val)
+        {
+#if defined(WIN32)
+            return InterlockedExchangeAdd((volatile LONG*)addr, val) + val;
+#else
+            return __sync_add_and_fetch(addr, val);
+#endif
+        }
+
+        /************************************
+        * Method:    自旋等待提示，降低功耗并让出超线程的执行资源
+        * Returns:
+        *************************************/
+        static inline void Pause()
+        {
+#if defined(WIN32)
+            YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+            __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+            __asm__ __volatile__("yield" ::: "memory");
+#else
+            __sync_synchronize();
+#endif
+        }
+    };
+
+    class KAdaptiveMutex
+    {
+    public:
+        /**
+        竞争统计
+        **/
+        struct Stats
+        {
+            // 首次尝试未获得锁的次数 //
+            uint32_t contended;
+            // 自旋期间获得锁的次数 //
+            uint32_t spinAcquired;
+            // 挂起等待的次数 //
+            uint32_t parked;
+            // 当前的自旋上限 //
+            int spinLimit;
+        };
+
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: maxSpins 最大自旋次数，0表示不自旋直接挂起
+        *************************************/
+        explicit KAdaptiveMutex(int maxSpins = 100);
+
+        /************************************
+        * Method:    上锁
+        * Returns:
+        *************************************/
+        inline void Lock() const
+        {
+            if (KFutex::CompareExchange(&m_state, Unlocked, Locked) != Unlocked)
+                LockSlow();
+        }
+
+        /************************************
+        * Method:    解锁
+        * Returns:
+        *************************************/
+        inline void Unlock() const
+        {
+            if (KFutex::Exchange(&m_state, Unlocked) == Contended)
+                KFutex::Wake(&m_state, 1);
+        }
+
+        /************************************
+        * Method:    尝试加锁
+        * Returns:
+        *************************************/
+        inline bool TryLock() const
+        {
+            return KFutex::CompareExchange(&m_state, Unlocked, Locked) == Unlocked;
+        }
+
+        /************************************
+        * Method:    获取竞争统计
+        * Returns:
+        * Parameter: st 统计
+        *************************************/
+        void GetStats(Stats& st) const;
+
+        /************************************
+        * Method:    清空竞争统计
+        * Returns:
+        *************************************/
+        void ResetStats();
+
+    private:
+        KAdaptiveMutex(const KAdaptiveMutex&);
+        KAdaptiveMutex& operator=(const KAdaptiveMutex&);
+
+        /************************************
+        * Method:    首次尝试失败后自旋，再挂起
+        * Returns:
+        *************************************/
+        void LockSlow() const;
+
+        /************************************
+        * Method:    按有等待者的状态加锁，用于条件变量唤醒后重新加锁
+        * Returns:
+        *************************************/
+        void LockContended() const;
+
+    private:
+        // 0:未加锁 1:加锁 2:加锁且可能有线程挂起 //
+        enum State { Unlocked = 0, Locked = 1, Contended = 2 };
+        mutable volatile int m_state;
+        int m_maxSpins;
+        // 最近获得锁的平均自旋次数，多线程更新不加锁，仅作估计 //
+        mutable volatile int m_spinAvg;
+        mutable AtomicInteger<uint32_t> m_contended;
+        mutable AtomicInteger<uint32_t> m_spinAcquired;
+        mutable AtomicInteger<uint32_t> m_parked;
+        friend class KAdaptiveCondVariable;
+    };
+};
+#endif // !_ADAPTIVEMUTEX_HPP_
@@ -3,6 +3,7 @@
 
 #if defined(WIN32)
 #include <windows.h>
+#include <intrin.h>
 #endif
 #include <map>
 
@@ -13,6 +14,147 @@
 **/
 
 namespace klib {
+    // ڴ򣬶ӦC++11 memory_order //
+    enum MemoryOrder
+    {
+        MoRelaxed,
+        MoAcquire,
+        MoRelease,
+        MoAcqRel,
+        MoSeqCst
+    };
+
+#if !defined(WIN32) && defined(__ATOMIC_RELAXED)
+    // gcc 4.7 Ϻclang ṩ__atomic ڽڴΪ //
+    inline int AtomicOrder(MemoryOrder mo)
+    {
+        switch (mo)
+        {
+        case MoRelaxed: return __ATOMIC_RELAXED;
+        case MoAcquire: return __ATOMIC_ACQUIRE;
+        case MoRelease: return __ATOMIC_RELEASE;
+        case MoAcqRel: return __ATOMIC_ACQ_REL;
+        default: return __ATOMIC_SEQ_CST;
+        }
+    }
+
+    // ʹrelease  //
+    inline int AtomicLoadOrder(MemoryOrder mo)
+    {
+        return (mo == MoRelaxed ? __ATOMIC_RELAXED : (mo == MoAcquire ? __ATOMIC_ACQUIRE : __ATOMIC_SEQ_CST));
+    }
+
+    // дʹacquire  //
+    inline int AtomicStoreOrder(MemoryOrder mo)
+    {
+        return (mo == MoRelaxed ? __ATOMIC_RELAXED : (mo == MoRelease ? __ATOMIC_RELEASE : __ATOMIC_SEQ_CST));
+    }
+#endif
+
+    /************************************
+    * Method:    ڴ
+    * Returns:   
+    * Parameter: mo ڴ
+    *************************************/
+    inline void AtomicFence(MemoryOrder mo = MoSeqCst)
+    {
+#if defined(WIN32)
+        MemoryBarrier();
+#elif defined(__ATOMIC_RELAXED)
+        __atomic_thread_fence(AtomicOrder(mo));
+#else
+        __sync_synchronize();
+#endif
+    }
+#if defined(WIN32)
+    // ֮д֮ǰϣx86/x64 ֹֻ //
+    inline void AtomicOrderBarrier()
+    {
+#if defined(_M_IX86) || defined(_M_X64)
+        _ReadWriteBarrier();
+#else
+        MemoryBarrier();
+#endif
+    }
+
+    // ѡInterlocked ֻ֧4 8 ֽ //
+    template<size_t Size>
+    struct InterlockedOps;
+
+    template<>
+    struct InterlockedOps<4>
+    {
+        typedef LONG ValueType;
+
+        static inline LONG Load(volatile LONG* p, MemoryOrder mo)
+        {
+            LONG v = *p;
+            if (mo != MoRelaxed)
+                AtomicOrderBarrier();
+            return v;
+        }
+
+        static inline void Store(volatile LONG* p, LONG v, MemoryOrder mo)
+        {
+            if (mo == MoSeqCst)
+            {
+                InterlockedExchange(p, v);
+                return;
+            }
+            if (mo != MoRelaxed)
+                AtomicOrderBarrier();
+            *p = v;
+        }
+
+        static inline LONG Exchange(volatile LONG* p, LONG v) { return InterlockedExchange(p, v); }
+        static inline LONG CompareExchange(volatile LONG* p, LONG v, LONG cmp) { return InterlockedCompareExchange(p, v, cmp); }
+        static inline LONG ExchangeAdd(volatile LONG* p, LONG v) { return InterlockedExchangeAdd(p, v); }
+        static inline LONG Or(volatile LONG* p, LONG v) { return InterlockedOr(p, v); }
+        static inline LONG And(volatile LONG* p, LONG v) { return InterlockedAnd(p, v); }
+    };
+
+    template<>
+    struct InterlockedOps<8>
+    {
+        typedef LONGLONG ValueType;
+
+        // 32 λϵͳ64 λдԭӵģInterlocked  //
+        static inline LONGLONG Load(volatile LONGLONG* p, MemoryOrder mo)
+        {
+#if defined(_WIN64)
+            LONGLONG v = *p;
+            if (mo != MoRelaxed)
+                AtomicOrderBarrier();
+            return v;
+#else
+            return InterlockedCompareExchange64(p, 0, 0);
+#endif
+        }
+
+        static inline void Store(volatile LONGLONG* p, LONGLONG v, MemoryOrder mo)
+        {
+#if defined(_WIN64)
+            if (mo == MoSeqCst)
+            {
+                InterlockedExchange64(p, v);
+                return;
+            }
+            if (mo != MoRelaxed)
+                AtomicOrderBarrier();
+            *p = v;
+#else
+            InterlockedExchange64(p, v);
+#endif
+        }
+
+        static inline LONGLONG Exchange(volatile LONGLONG* p, LONGLONG v) { return InterlockedExchange64(p, v); }
+        static inline LONGLONG CompareExchange(volatile LONGLONG* p, LONGLONG v, LONGLONG cmp) { return InterlockedCompareExchange64(p, v, cmp); }
+        static inline LONGLONG ExchangeAdd(volatile LONGLONG* p, LONGLONG v) { return InterlockedExchangeAdd64(p, v); }
+        static inline LONGLONG Or(volatile LONGLONG* p, LONGLONG v) { return InterlockedOr64(p, v); }
+        static inline LONGLONG And(volatile LONGLONG* p, LONGLONG v) { return InterlockedAnd64(p, v); }
+    };
+#endif
+
     template<typename VariantType>
     class AtomicVariant
     {
@@ -119,7 +261,7 @@ namespace klib {
         AtomicInteger(IntegerType v = 0) :m_ival(v) {}
 
         inline operator IntegerType() const { return Load(); }
-        inline AtomicInteger& operator=(IntegerType v){ Exchange(v); return *this; }
+        inline AtomicInteger& operator=(IntegerType v){ Store(v); return *this; }
         inline IntegerType operator++() { return FetchAdd(1) + 1; }//prefix
         inline IntegerType operator--() { return FetchSub(1) - 1; }//prefix
         inline IntegerType operator++(int) { return FetchAdd(1); }//suffix
@@ -127,69 +269,189 @@ namespace klib {
         inline bool operator==(IntegerType v){ return Load() == v; }
         inline bool operator==(const AtomicInteger& rh){ return Load() == rh.Load(); }
 
-    private:
-        inline IntegerType FetchAdd(IntegerType val)
+        /************************************
+        * Method:    ȡ
+        * Returns:   صǰֵ
+        * Parameter: mo ڴMoRelaxedMoAcquire MoSeqCst
+        *************************************/
+        inline IntegerType Load(MemoryOrder mo = MoSeqCst) const
         {
 #if defined(WIN32)
-			KLockGuard<KMutex> lock(m_intMtx);
-			IntegerType tmp = m_ival;
-			m_ival += val;
-			return tmp;
+            return IntegerType(Ops::Load(Address(), mo));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_load_n(&m_ival, AtomicLoadOrder(mo));
 #else
-			return __sync_fetch_and_add(&m_ival, val);
+            IntegerType v = *const_cast<volatile IntegerType*>(&m_ival);
+            if (mo != MoRelaxed)
+                __sync_synchronize();
+            return v;
 #endif
         }
 
-        inline IntegerType FetchSub(IntegerType val)
+        /************************************
+        * Method:    д
+        * Returns:   
+        * Parameter: val ֵ
+        * Parameter: mo ڴMoRelaxedMoRelease MoSeqCst
+        *************************************/
+        inline void Store(IntegerType val, MemoryOrder mo = MoSeqCst)
         {
 #if defined(WIN32)
-            KLockGuard<KMutex> lock(m_intMtx);
-            IntegerType tmp = m_ival;
-            m_ival -= val;
-            return tmp;
+            Ops::Store(Address(), OpsType(val), mo);
+#elif defined(__ATOMIC_RELAXED)
+            __atomic_store_n(&m_ival, val, AtomicStoreOrder(mo));
+#else
+            if (mo != MoRelaxed)
+                __sync_synchronize();
+            *const_cast<volatile IntegerType*>(&m_ival) = val;
+            if (mo == MoSeqCst)
+                __sync_synchronize();
+#endif
+        }
+
+        /************************************
+        * Method:    
+        * Returns:   ԭֵ
+        * Parameter: val ֵ
+        * Parameter: mo ڴ
+        *************************************/
+        inline IntegerType Exchange(IntegerType val, MemoryOrder mo = MoSeqCst)
+        {
+#if defined(WIN32)
+            return IntegerType(Ops::Exchange(Address(), OpsType(val)));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_exchange_n(&m_ival, val, AtomicOrder(mo));
+#else
+            __sync_synchronize();
+            return __sync_lock_test_and_set(&m_ival, val);
+#endif
+        }
+
+        /************************************
+        * Method:    Ƚϲ
+        * Returns:   ǰֵexpected ʱдdesired trueѵǰֵдexpected false
+        * Parameter: expected ֵ
+        * Parameter: desired ֵ
+        * Parameter: mo ڴʧʱڴΪMoRelaxed
+        *************************************/
+        inline bool CompareExchange(IntegerType& expected, IntegerType desired, MemoryOrder mo = MoSeqCst)
+        {
+#if defined(WIN32)
+            IntegerType old = IntegerType(Ops::CompareExchange(Address(), OpsType(desired), OpsType(expected)));
+            if (old == expected)
+                return true;
+            expected = old;
+            return false;
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_compare_exchange_n(&m_ival, &expected, desired, false, AtomicOrder(mo), __ATOMIC_RELAXED);
+#else
+            IntegerType old = __sync_val_compare_and_swap(&m_ival, expected, desired);
+            if (old == expected)
+                return true;
+            expected = old;
+            return false;
+#endif
+        }
+
+        /************************************
+        * Method:    
+        * Returns:   ԭֵ
+        *************************************/
+        inline IntegerType FetchAdd(IntegerType val, MemoryOrder mo = MoSeqCst)
+        {
+#if defined(WIN32)
+            return IntegerType(Ops::ExchangeAdd(Address(), OpsType(val)));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_fetch_add(&m_ival, val, AtomicOrder(mo));
+#else
+            return __sync_fetch_and_add(&m_ival, val);
+#endif
+        }
+
+        /************************************
+        * Method:    
+        * Returns:   ԭֵ
+        *************************************/
+        inline IntegerType FetchSub(IntegerType val, MemoryOrder mo = MoSeqCst)
+        {
+#if defined(WIN32)
+            return IntegerType(Ops::ExchangeAdd(Address(), OpsType(0) - OpsType(val)));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_fetch_sub(&m_ival, val, AtomicOrder(mo));
 #else
             return __sync_fetch_and_sub(&m_ival, val);
 #endif
         }
 
-        inline IntegerType Load() const
+        /************************************
+        * Method:    λñ־λ
+        * Returns:   ԭֵ
+        *************************************/
+        inline IntegerType FetchOr(IntegerType val, MemoryOrder mo = MoSeqCst)
         {
 #if defined(WIN32)
-			KLockGuard<KMutex> lock(m_intMtx);
-			return m_ival;
+            return IntegerType(Ops::Or(Address(), OpsType(val)));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_fetch_or(&m_ival, val, AtomicOrder(mo));
 #else
-			return __sync_fetch_and_add(const_cast<IntegerType*>(&m_ival), 0);
+            return __sync_fetch_and_or(&m_ival, val);
 #endif
         }
 
-        inline IntegerType Exchange(IntegerType val)
+        /************************************
+        * Method:    λ룬־λ
+        * Returns:   ԭֵ
+        *************************************/
+        inline IntegerType FetchAnd(IntegerType val, MemoryOrder mo = MoSeqCst)
         {
 #if defined(WIN32)
-			KLockGuard<KMutex> lock(m_intMtx);
-			IntegerType tmp = m_ival;
-			m_ival = val;
-			return tmp;
+            return IntegerType(Ops::And(Address(), OpsType(val)));
+#elif defined(__ATOMIC_RELAXED)
+            return __atomic_fetch_and(&m_ival, val, AtomicOrder(mo));
 #else
-			__sync_synchronize();
-			return __sync_lock_test_and_set(&m_ival, val);
+            return __sync_fetch_and_and(&m_ival, val);
 #endif
         }
 
     private:
-        IntegerType m_ival;
 #if defined(WIN32)
-        KMutex m_intMtx;
+        typedef InterlockedOps<sizeof(IntegerType)> Ops;
+        typedef typename Ops::ValueType OpsType;
+
+        inline volatile OpsType* Address() const
+        {
+            return reinterpret_cast<volatile OpsType*>(const_cast<IntegerType*>(&m_ival));
+        }
 #endif
+
+    private:
+        IntegerType m_ival;
     };
 	
 	class AtomicBool
     {
     public:
         AtomicBool(bool v = false):m_dat(v ? 1 : 0){}
-        inline operator bool() const{ return (int(m_dat) != 0 ? true : false); }
-        inline AtomicBool& operator=(bool v){ m_dat = (v ? 1 : 0); return *this; }
+        inline operator bool() const{ return Load(); }
+        inline AtomicBool& operator=(bool v){ Store(v); return *this; }
         inline bool operator==(bool v) const{ return (operator bool() == v); }
-        inline bool operator==(const AtomicBool& rh) const{ return (m_dat == rh.m_dat); }
+        inline bool operator==(const AtomicBool& rh) const{ return (Load() == rh.Load()); }
+
+        inline bool Load(MemoryOrder mo = MoSeqCst) const { return m_dat.Load(mo) != 0; }
+        inline void Store(bool v, MemoryOrder mo = MoSeqCst) { m_dat.Store(v ? 1 : 0, mo); }
+        inline bool Exchange(bool v, MemoryOrder mo = MoSeqCst) { return m_dat.Exchange(v ? 1 : 0, mo) != 0; }
+
+        /************************************
+        * Method:    Ƚϲ
+        * Returns:   ɹtrueʧʱѵǰֵдexpected false
+        *************************************/
+        inline bool CompareExchange(bool& expected, bool desired, MemoryOrder mo = MoSeqCst)
+        {
+            int exp = (expected ? 1 : 0);
+            bool rc = m_dat.CompareExchange(exp, desired ? 1 : 0, mo);
+            expected = (exp != 0);
+            return rc;
+        }
 
     private:
         AtomicInteger<int> m_dat;
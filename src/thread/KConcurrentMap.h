@@ -0,0 +1,404 @@
+#ifndef _CONCURRENTMAP_HPP_
+#define _CONCURRENTMAP_HPP_
+
+#include <map>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KAtomic.h"
+#include "thread/KAdaptiveMutex.h"
+#include "util/KTime.h"
+/**
+并发哈希表，读不加锁，写按分段加锁
+桶个数在构造时确定，不扩容，应按预计的元素个数设置
+节点删除后等待该分段上已开始的读全部结束才释放(分段的读计数分两组交替使用，写者切换分组后等待旧分组归零)，
+所以Accessor 持有期间读到的值不会被释放
+**/
+namespace klib {
+    /**
+    默认哈希函数，整数和指针使用乘法散列
+    **/
+    template<typename KeyType>
+    struct KHash
+    {
+        inline size_t operator()(const KeyType& key) const
+        {
+            uint64_t h = uint64_t(key) * 0x9E3779B97F4A7C15ULL;
+            return size_t(h ^ (h >> 29));
+        }
+    };
+
+    template<typename T>
+    struct KHash<T*>
+    {
+        inline size_t operator()(T* key) const
+        {
+            uint64_t h = uint64_t(size_t(key)) * 0x9E3779B97F4A7C15ULL;
+            return size_t(h ^ (h >> 29));
+        }
+    };
+
+    template<>
+    struct KHash<std::string>
+    {
+        // FNV-1a //
+        inline size_t operator()(const std::string& key) const
+        {
+            uint64_t h = 14695981039346656037ULL;
+            for (size_t i = 0; i < key.size(); ++i)
+            {
+                h ^= uint8_t(key[i]);
+                h *= 1099511628211ULL;
+            }
+            return size_t(h);
+        }
+    };
+
+    template<typename KeyType, typename ValueType, typename HashType = KHash<KeyType> >
+    class KConcurrentMap
+    {
+        struct Node
+        {
+            Node(const KeyType& k, const ValueType& v, Node* n)
+                :key(k), value(v), next(n) {}
+
+            KeyType key;
+            ValueType value;
+            Node* volatile next;
+        };
+
+        /**
+        分段，按缓存行对齐避免不同分段的读计数互相干扰
+        **/
+        struct Stripe
+        {
+            KAdaptiveMutex mtx;
+            AtomicInteger<uint32_t> phase;
+            AtomicInteger<int32_t> readers[2];
+            char padding[64];
+        };
+
+    public:
+        /**
+        读访问，构造时查找，析构前找到的值不会被释放
+        **/
+        class Accessor
+        {
+        public:
+            Accessor(const KConcurrentMap& mp, const KeyType& key)
+                :m_map(mp), m_stripe(mp.StripeOf(key))
+            {
+                m_phase = m_map.ReadLock(m_stripe);
+                m_node = m_map.Find(key);
+            }
+
+            ~Accessor()
+            {
+                m_map.ReadUnlock(m_stripe, m_phase);
+            }
+
+            inline bool Found() const { return m_node != NULL; }
+            inline const ValueType& Value() const { return m_node->value; }
+
+        private:
+            Accessor(const Accessor&);
+            Accessor& operator=(const Accessor&);
+
+        private:
+            const KConcurrentMap& m_map;
+            size_t m_stripe;
+            uint32_t m_phase;
+            Node* m_node;
+        };
+
+    public:
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: buckets 桶个数，向上取2的幂
+        * Parameter: stripes 写锁分段个数，向上取2的幂，不超过桶个数
+        *************************************/
+        KConcurrentMap(size_t buckets = 1024, size_t stripes = 64)
+            :m_size(0)
+        {
+            m_bucketCount = RoundUp(buckets);
+            m_stripeCount = RoundUp(stripes);
+            if (m_stripeCount > m_bucketCount)
+                m_stripeCount = m_bucketCount;
+
+            m_buckets = new Node* volatile[m_bucketCount];
+            for (size_t i = 0; i < m_bucketCount; ++i)
+                m_buckets[i] = NULL;
+            m_stripes = new Stripe[m_stripeCount];
+        }
+
+        ~KConcurrentMap()
+        {
+            for (size_t i = 0; i < m_bucketCount; ++i)
+            {
+                Node* n = m_buckets[i];
+                while (n != NULL)
+                {
+                    Node* next = n->next;
+                    delete n;
+                    n = next;
+                }
+            }
+            delete[] m_buckets;
+            delete[] m_stripes;
+        }
+
+        /************************************
+        * Method:    插入或替换
+        * Returns:
+        * Parameter: key 键
+        * Parameter: val 值
+        *************************************/
+        void Assign(const KeyType& key, const ValueType& val)
+        {
+            size_t b = BucketOf(key);
+            size_t s = (b & (m_stripeCount - 1));
+            Node* old = NULL;
+            {
+                KLockGuard<KAdaptiveMutex> lock(m_stripes[s].mtx);
+                Node* volatile* prev = &m_buckets[b];
+                for (Node* n = *prev; n != NULL; prev = &n->next, n = n->next)
+                {
+                    if (n->key == key)
+                    {
+                        old = n;
+                        break;
+                    }
+                }
+
+                // 节点初始化完成后再发布 //
+                Node* node = new Node(key, val, old != NULL ? old->next : m_buckets[b]);
+                AtomicFence(MoRelease);
+                if (old != NULL)
+                    *prev = node;
+                else
+                {
+                    m_buckets[b] = node;
+                    ++m_size;
+                }
+
+                if (old != NULL)
+                    Synchronize(s);
+            }
+            delete old;
+        }
+
+        /************************************
+        * Method:    批量插入或替换
+        * Returns:
+        * Parameter: d 键值
+        *************************************/
+        void Assign(const std::map<KeyType, ValueType>& d)
+        {
+            typename std::map<KeyType, ValueType>::const_iterator it = d.begin();
+            for (; it != d.end(); ++it)
+                Assign(it->first, it->second);
+        }
+
+        /************************************
+        * Method:    获取值
+        * Returns:   存在返回true否则返回false
+        * Parameter: key 键
+        * Parameter: val 值
+        *************************************/
+        bool Get(const KeyType& key, ValueType& val) const
+        {
+            Accessor acc(*this, key);
+            if (acc.Found())
+            {
+                val = acc.Value();
+                return true;
+            }
+            return false;
+        }
+
+        /************************************
+        * Method:    获取所有键值，不是原子快照
+        * Returns:
+        * Parameter: d 键值
+        *************************************/
+        void Get(std::map<KeyType, ValueType>& d) const
+        {
+            d.clear();
+            for (size_t b = 0; b < m_bucketCount; ++b)
+            {
+                size_t s = (b & (m_stripeCount - 1));
+                uint32_t phase = ReadLock(s);
+                for (Node* n = Next(&m_buckets[b]); n != NULL; n = Next(&n->next))
+                    d[n->key] = n->value;
+                ReadUnlock(s, phase);
+            }
+        }
+
+        /************************************
+        * Method:    删除，返回时已没有读者持有该节点
+        * Returns:
+        * Parameter: key 键
+        *************************************/
+        void Erase(const KeyType& key)
+        {
+            size_t b = BucketOf(key);
+            size_t s = (b & (m_stripeCount - 1));
+            Node* old = NULL;
+            {
+                KLockGuard<KAdaptiveMutex> lock(m_stripes[s].mtx);
+                Node* volatile* prev = &m_buckets[b];
+                for (Node* n = *prev; n != NULL; prev = &n->next, n = n->next)
+                {
+                    if (n->key == key)
+                    {
+                        old = n;
+                        *prev = n->next;
+                        --m_size;
+                        Synchronize(s);
+                        break;
+                    }
+                }
+            }
+            delete old;
+        }
+
+        /************************************
+        * Method:    清空
+        * Returns:
+        *************************************/
+        void Clear()
+        {
+            std::vector<Node*> olds;
+            for (size_t s = 0; s < m_stripeCount; ++s)
+            {
+                {
+                    KLockGuard<KAdaptiveMutex> lock(m_stripes[s].mtx);
+                    for (size_t b = s; b < m_bucketCount; b += m_stripeCount)
+                    {
+                        // 读者可能还在链表上，不能修改next //
+                        for (Node* n = m_buckets[b]; n != NULL; n = n->next)
+                        {
+                            olds.push_back(n);
+                            --m_size;
+                        }
+                        m_buckets[b] = NULL;
+                    }
+                    if (!olds.empty())
+                        Synchronize(s);
+                }
+
+                for (size_t i = 0; i < olds.size(); ++i)
+                    delete olds[i];
+                olds.clear();
+            }
+        }
+
+        inline bool Empty() const { return Size() == 0; }
+
+        inline size_t Size() const { return m_size.Load(MoRelaxed); }
+
+    private:
+        KConcurrentMap(const KConcurrentMap&);
+        KConcurrentMap& operator=(const KConcurrentMap&);
+
+        static inline size_t RoundUp(size_t n)
+        {
+            size_t r = 1;
+            while (r < n)
+                r <<= 1;
+            return r;
+        }
+
+        inline size_t BucketOf(const KeyType& key) const
+        {
+            return (m_hash(key) & (m_bucketCount - 1));
+        }
+
+        inline size_t StripeOf(const KeyType& key) const
+        {
+            return (BucketOf(key) & (m_stripeCount - 1));
+        }
+
+        static inline Node* Next(Node* const volatile* p)
+        {
+            Node* n = *p;
+            AtomicFence(MoAcquire);
+            return n;
+        }
+
+        /************************************
+        * Method:    查找，需在ReadLock 期间调用
+        * Returns:
+        * Parameter: key 键
+        *************************************/
+        Node* Find(const KeyType& key) const
+        {
+            for (Node* n = Next(&m_buckets[BucketOf(key)]); n != NULL; n = Next(&n->next))
+            {
+                if (n->key == key)
+                    return n;
+            }
+            return NULL;
+        }
+
+        /************************************
+        * Method:    开始读，在当前分组的读计数上加1
+        * Returns:   返回分组
+        * Parameter: s 分段
+        *************************************/
+        uint32_t ReadLock(size_t s) const
+        {
+            Stripe& st = m_stripes[s];
+            for (;;)
+            {
+                uint32_t phase = (st.phase.Load(MoAcquire) & 1);
+                st.readers[phase].FetchAdd(1);
+                // 加计数后分组未变，写者一定能看到这次计数 //
+                if ((st.phase.Load() & 1) == phase)
+                    return phase;
+                st.readers[phase].FetchSub(1, MoRelease);
+            }
+        }
+
+        /************************************
+        * Method:    结束读
+        * Returns:
+        * Parameter: s 分段
+        * Parameter: phase 分组
+        *************************************/
+        inline void ReadUnlock(size_t s, uint32_t phase) const
+        {
+            m_stripes[s].readers[phase].FetchSub(1, MoRelease);
+        }
+
+        /************************************
+        * Method:    切换分组并等待旧分组上的读结束，需持有分段写锁
+        * Returns:
+        * Parameter: s 分段
+        *************************************/
+        void Synchronize(size_t s)
+        {
+            Stripe& st = m_stripes[s];
+            uint32_t old = (st.phase.FetchAdd(1) & 1);
+            for (int spins = 0; st.readers[old].Load(MoAcquire) != 0; ++spins)
+            {
+                if (spins < 100)
+                    KFutex::Pause();
+                else
+                    KTime::MSleep(0);
+            }
+        }
+
+    private:
+        Node* volatile* m_buckets;
+        size_t m_bucketCount;
+        mutable Stripe* m_stripes;
+        size_t m_stripeCount;
+        AtomicInteger<size_t> m_size;
+        HashType m_hash;
+    };
+};
+#endif // !_CONCURRENTMAP_HPP_
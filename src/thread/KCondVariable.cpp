@@ -1,8 +1,18 @@
 #include "thread/KCondVariable.h"
 namespace klib {
     KCondVariable::KCondVariable()
+        :m_monotonic(false)
     {
-        int rc = pthread_cond_init(&m_pcond, NULL);
+        int rc = 0;
+#if !defined(WIN32) && defined(_POSIX_MONOTONIC_CLOCK) && (_POSIX_MONOTONIC_CLOCK >= 0)
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        m_monotonic = (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0);
+        rc = pthread_cond_init(&m_pcond, &attr);
+        pthread_condattr_destroy(&attr);
+#else
+        rc = pthread_cond_init(&m_pcond, NULL);
+#endif
         if (rc != 0)
             throw KException(__FILE__, __LINE__, KError::StdErrorStr(rc).c_str());
     }
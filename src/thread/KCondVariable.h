@@ -6,7 +6,7 @@
 #include "thread/KError.h"
 #include <pthread.h>
 /**
-条件变量类
+条件变量类，支持时使用单调时钟计算超时，不受系统时间调整影响
 **/
 namespace klib {
     class KCondVariable
@@ -47,6 +47,8 @@ namespace klib {
 
     private:
         mutable pthread_cond_t m_pcond;
+        // 是否使用CLOCK_MONOTONIC //
+        bool m_monotonic;
     };
 
     template <typename Lock>
@@ -56,7 +58,10 @@ namespace klib {
             throw KException(__FILE__, __LINE__, "not acquired");
 
 		timespec ts;
-		KTime::GetTime(ts, ms);
+		if (m_monotonic)
+			KTime::GetMonotonicTime(ts, ms);
+		else
+			KTime::GetTime(ts, ms);
         //pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
         pthread_testcancel();
 		int rc = pthread_cond_timedwait(&m_pcond, &lock.m_tmtx.m_pmtx, &ts);
@@ -0,0 +1,148 @@
+#include "thread/KEpoch.h"
+#include "thread/KException.h"
+#include "thread/KError.h"
+#include "util/KTime.h"
+namespace klib {
+    KEpoch::KEpoch()
+        :m_records(NULL), m_epoch(0), m_pending(0)
+    {
+        int rc = pthread_key_create(&m_key, &KEpoch::ReleaseRecord);
+        if (rc != 0)
+            throw KException(__FILE__, __LINE__, KError::StdErrorStr(rc).c_str());
+    }
+
+    KEpoch::~KEpoch()
+    {
+        pthread_key_delete(m_key);
+        for (size_t i = 0; i < m_retired.size(); ++i)
+            m_retired[i].fn(m_retired[i].ptr, m_retired[i].ctx);
+        m_retired.clear();
+
+        Record* rec = m_records;
+        while (rec != NULL)
+        {
+            Record* next = rec->next;
+            delete rec;
+            rec = next;
+        }
+    }
+
+    void KEpoch::Enter() const
+    {
+        Record* rec = GetRecord();
+        if (rec->depth++ == 0)
+        {
+            // 交换保证活跃标志在之后的读之前可见 //
+            rec->state.Exchange((m_epoch.Load(MoAcquire) << 1) | 1);
+        }
+    }
+
+    void KEpoch::Exit() const
+    {
+        Record* rec = GetRecord();
+        if (--rec->depth == 0)
+            rec->state.Store(0, MoRelease);
+    }
+
+    void KEpoch::Retire(void* ptr, Reclaimer fn, void* ctx)
+    {
+        Retired r;
+        r.ptr = ptr;
+        r.fn = fn;
+        r.ctx = ctx;
+        KLockGuard<KMutex> lock(m_retireMtx);
+        r.epoch = m_epoch.Load();
+        m_retired.push_back(r);
+        ++m_pending;
+    }
+
+    size_t KEpoch::Reclaim()
+    {
+        if (m_pending.Load(MoRelaxed) == 0)
+            return 0;
+
+        TryAdvance();
+        uint32_t now = m_epoch.Load();
+        std::vector<Retired> frees;
+        {
+            KLockGuard<KMutex> lock(m_retireMtx);
+            size_t keep = 0;
+            for (size_t i = 0; i < m_retired.size(); ++i)
+            {
+                // 摘下后纪元已前进两次 //
+                if (uint32_t(now - m_retired[i].epoch) >= 2)
+                    frees.push_back(m_retired[i]);
+                else
+                    m_retired[keep++] = m_retired[i];
+            }
+            m_retired.resize(keep);
+            m_pending = int32_t(keep);
+        }
+
+        // 在锁外释放，释放函数中可以再调用Retire //
+        for (size_t i = 0; i < frees.size(); ++i)
+            frees[i].fn(frees[i].ptr, frees[i].ctx);
+        return frees.size();
+    }
+
+    void KEpoch::Synchronize()
+    {
+        uint32_t start = m_epoch.Load();
+        for (int i = 0; uint32_t(m_epoch.Load() - start) < 2; ++i)
+        {
+            if (!TryAdvance())
+                KTime::MSleep(i < 100 ? 0 : 1);
+        }
+    }
+
+    KEpoch::Record* KEpoch::GetRecord() const
+    {
+        Record* rec = static_cast<Record*>(pthread_getspecific(m_key));
+        if (rec != NULL)
+            return rec;
+
+        // 复用已退出线程的记录 //
+        for (rec = m_records; rec != NULL; rec = rec->next)
+        {
+            int32_t unused = 0;
+            if (rec->used.CompareExchange(unused, 1))
+                break;
+        }
+
+        if (rec == NULL)
+        {
+            rec = new Record;
+            rec->state = 0;
+            rec->used = 1;
+            KLockGuard<KMutex> lock(m_recordMtx);
+            rec->next = m_records;
+            AtomicFence(MoRelease);
+            m_records = rec;
+        }
+        rec->depth = 0;
+        pthread_setspecific(m_key, rec);
+        return rec;
+    }
+
+    void KEpoch::ReleaseRecord(void* ptr)
+    {
+        Record* rec = static_cast<Record*>(ptr);
+        rec->depth = 0;
+        rec->state.Store(0, MoRelease);
+        rec->used.Store(0, MoRelease);
+    }
+
+    bool KEpoch::TryAdvance()
+    {
+        uint32_t now = m_epoch.Load();
+        Record* rec = m_records;
+        AtomicFence(MoAcquire);
+        for (; rec != NULL; rec = rec->next)
+        {
+            uint32_t st = rec->state.Load();
+            if ((st & 1) && (st >> 1) != (now & 0x7FFFFFFF))
+                return false;
+        }
+        return m_epoch.CompareExchange(now, now + 1);
+    }
+};
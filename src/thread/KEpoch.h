@@ -0,0 +1,198 @@
+#ifndef _EPOCH_HPP_
+#define _EPOCH_HPP_
+
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KAtomic.h"
+/**
+基于纪元的内存回收(epoch-based reclamation)
+读者在Guard 内访问共享对象，不加锁；写者把对象从共享结构中摘下后调用Retire，
+全局纪元前进两次后，摘下前已进入的读者都已退出，此时才真正释放对象
+纪元在Reclaim 中推进：所有活跃读者都已看到当前纪元时才能前进，所以长时间持有Guard 会推迟回收
+**/
+namespace klib {
+    class KEpoch
+    {
+    public:
+        // 释放函数，ptr 为Retire 的对象，ctx 为Retire 时传入的上下文 //
+        typedef void (*Reclaimer)(void* ptr, void* ctx);
+
+        KEpoch();
+
+        // 析构时释放所有待回收的对象，调用者需保证已没有读者 //
+        ~KEpoch();
+
+        /************************************
+        * Method:    进入读临界区，可以嵌套
+        * Returns:
+        *************************************/
+        void Enter() const;
+
+        /************************************
+        * Method:    退出读临界区
+        * Returns:
+        *************************************/
+        void Exit() const;
+
+        /************************************
+        * Method:    延迟回收对象
+        * Returns:
+        * Parameter: ptr 已从共享结构中摘下的对象
+        * Parameter: fn 释放函数
+        * Parameter: ctx 上下文
+        *************************************/
+        void Retire(void* ptr, Reclaimer fn, void* ctx = NULL);
+
+        /************************************
+        * Method:    延迟delete 对象
+        * Returns:
+        * Parameter: ptr 已从共享结构中摘下的对象
+        *************************************/
+        template<typename ObjectType>
+        inline void Retire(ObjectType* ptr)
+        {
+            Retire(ptr, &KEpoch::DeleteObject<ObjectType>, NULL);
+        }
+
+        /************************************
+        * Method:    尝试推进纪元并释放可以释放的对象，不能在Guard 内调用
+        * Returns:   返回释放的个数
+        *************************************/
+        size_t Reclaim();
+
+        /************************************
+        * Method:    等待调用前进入的读者全部退出，不能在Guard 内调用
+        * Returns:
+        *************************************/
+        void Synchronize();
+
+        /************************************
+        * Method:    获取待回收的个数
+        * Returns:
+        *************************************/
+        inline size_t GetPending() const { return size_t(m_pending.Load(MoRelaxed)); }
+
+        /**
+        读临界区守卫
+        **/
+        class Guard
+        {
+        public:
+            Guard(const KEpoch& ep) :m_epoch(ep) { m_epoch.Enter(); }
+            ~Guard() { m_epoch.Exit(); }
+
+        private:
+            Guard(const Guard&);
+            Guard& operator=(const Guard&);
+            const KEpoch& m_epoch;
+        };
+
+    private:
+        KEpoch(const KEpoch&);
+        KEpoch& operator=(const KEpoch&);
+
+        template<typename ObjectType>
+        static void DeleteObject(void* ptr, void*)
+        {
+            delete static_cast<ObjectType*>(ptr);
+        }
+
+        /**
+        线程记录，线程退出后可被其他线程复用，直到析构才释放
+        **/
+        struct Record
+        {
+            // (纪元<<1)|活跃标志 //
+            AtomicInteger<uint32_t> state;
+            uint32_t depth;
+            AtomicInteger<int32_t> used;
+            Record* next;
+            char padding[64];
+        };
+
+        struct Retired
+        {
+            void* ptr;
+            Reclaimer fn;
+            void* ctx;
+            uint32_t epoch;
+        };
+
+        /************************************
+        * Method:    获取当前线程的记录
+        * Returns:
+        *************************************/
+        Record* GetRecord() const;
+
+        /************************************
+        * Method:    线程退出时释放记录
+        * Returns:
+        *************************************/
+        static void ReleaseRecord(void* rec);
+
+        /************************************
+        * Method:    所有活跃读者都已看到当前纪元时推进纪元
+        * Returns:   推进成功返回true
+        *************************************/
+        bool TryAdvance();
+
+    private:
+        mutable pthread_key_t m_key;
+        mutable Record* volatile m_records;
+        mutable KMutex m_recordMtx;
+        AtomicInteger<uint32_t> m_epoch;
+        AtomicInteger<int32_t> m_pending;
+        KMutex m_retireMtx;
+        std::vector<Retired> m_retired;
+    };
+
+    /**
+    受纪元保护的指针，读者在Guard 内Get，写者Update 后旧对象延迟释放，适用于配置快照等读多写少的数据
+    **/
+    template<typename ObjectType>
+    class KRcuPointer
+    {
+    public:
+        KRcuPointer(KEpoch& ep, ObjectType* init = NULL)
+            :m_epoch(ep), m_ptr(init) {}
+
+        ~KRcuPointer() { delete m_ptr; }
+
+        /************************************
+        * Method:    获取当前对象，需在KEpoch::Guard 内调用
+        * Returns:
+        *************************************/
+        inline ObjectType* Get() const
+        {
+            ObjectType* p = m_ptr;
+            AtomicFence(MoAcquire);
+            return p;
+        }
+
+        /************************************
+        * Method:    替换对象，旧对象延迟释放，多个写者需在外部加锁
+        * Returns:
+        * Parameter: ptr 新对象
+        *************************************/
+        void Update(ObjectType* ptr)
+        {
+            AtomicFence(MoRelease);
+            ObjectType* old = m_ptr;
+            m_ptr = ptr;
+            if (old != NULL)
+                m_epoch.Retire(old);
+        }
+
+    private:
+        KRcuPointer(const KRcuPointer&);
+        KRcuPointer& operator=(const KRcuPointer&);
+
+    private:
+        KEpoch& m_epoch;
+        ObjectType* volatile m_ptr;
+    };
+};
+#endif // !_EPOCH_HPP_
@@ -1,10 +1,13 @@
 #ifndef _EVENTOBJECT_HPP_
 #define _EVENTOBJECT_HPP_
 #include "thread/KQueue.h"
+#include "thread/KAdaptiveMutex.h"
+#include "thread/KAdaptiveCondVariable.h"
 #include "thread/KPthread.h"
 #include "thread/KAtomic.h"
 #include "thread/KMutex.h"
 #include "thread/KLockGuard.h"
+#include "thread/KConcurrentMap.h"
 
 #include <cassert>
 #include <map>
@@ -21,17 +24,14 @@ namespace klib {
 		KEventBase(const std::string& name)
 			:m_eventThread(name), m_running(false)
 		{
-			KLockGuard<KMutex> lock(s_eobjmtx);
 			m_objectID = ++s_eobjid;
-			s_eobjmap[m_objectID] = this;
+			s_eobjmap.Assign(m_objectID, this);
 		}
 
 		virtual ~KEventBase()
 		{
-			KLockGuard<KMutex> lock(s_eobjmtx);
-			std::map<uint32_t, KEventBase*>::iterator it = s_eobjmap.find(m_objectID);
-			if (it != s_eobjmap.end())
-				s_eobjmap.erase(it);
+			// 返回时已没有按ID 投递的线程在访问本对象 //
+			s_eobjmap.Erase(m_objectID);
 		}
 
 		/************************************
@@ -41,8 +41,24 @@ namespace klib {
 		virtual bool Start()
 		{
 			KLockGuard<KMutex> lock(m_wkMtx);
-			return (m_running = (m_eventThread.Run(this, &KEventBase::EventLoop, 0, &KEventBase::Log)
-				== KPthread::Success));
+			// IsRunning不加锁，必须在线程启动前设置，否则事件循环可能直接退出 //
+			m_running.Store(true, MoRelease);
+			bool rc = (m_eventThread.Run(this, &KEventBase::EventLoop, 0, &KEventBase::Log, (int*)NULL, m_threadOptions)
+				== KPthread::Success);
+			if (!rc)
+				m_running.Store(false, MoRelease);
+			return rc;
+		}
+
+		/************************************
+		* Method:    设置事件线程选项，下次Start 时生效
+		* Returns:   
+		* Parameter: opts 线程选项
+		*************************************/
+		inline void SetThreadOptions(const KThreadOptions& opts)
+		{
+			KLockGuard<KMutex> lock(m_wkMtx);
+			m_threadOptions = opts;
 		}
 
 		/************************************
@@ -52,7 +68,7 @@ namespace klib {
 		virtual void Stop()
 		{
 			KLockGuard<KMutex> lock(m_wkMtx);
-			m_running = false;
+			m_running.Store(false, MoRelease);
 		}
 
 		/************************************
@@ -70,8 +86,17 @@ namespace klib {
 		*************************************/
 		inline bool IsRunning() const
 		{
-			KLockGuard<KMutex> lock(m_wkMtx);
-			return m_running;
+			// 每处理一个事件都会检查，不加锁 //
+			return m_running.Load(MoAcquire);
+		}
+
+		/************************************
+		* Method:    事件线程是否还未退出
+		* Returns:   
+		*************************************/
+		inline bool IsThreadRunning() const
+		{
+			return m_eventThread.IsRunning();
 		}
 
 		/************************************
@@ -99,11 +124,12 @@ namespace klib {
 		KPthread m_eventThread;
 		AtomicInteger<uint32_t> m_objectID;
 		KMutex m_wkMtx;
-		volatile bool m_running;
+		AtomicBool m_running;
+		KThreadOptions m_threadOptions;
 
-		static KMutex s_eobjmtx;
 		static AtomicInteger<uint32_t> s_eobjid;
-		static std::map<uint32_t, KEventBase*> s_eobjmap;
+		// 按ID 投递时查找不加锁 //
+		static KConcurrentMap<uint32_t, KEventBase*> s_eobjmap;
 	};
 
     template<typename EventType>
@@ -111,7 +137,7 @@ namespace klib {
     {
     public:
 		KEventObject(const std::string& name, size_t maxSize = 50)
-			:m_eventQueue(maxSize),KEventBase(name)
+			:KEventBase(name),m_eventQueue(maxSize)
 		{
 
 		}
@@ -193,12 +219,12 @@ namespace klib {
         *************************************/
         static bool Post(uint32_t id, const EventType& ev)
         {
-			KLockGuard<KMutex> lock(s_eobjmtx);
-			std::map<uint32_t, KEventBase*>::iterator it = s_eobjmap.find(id);
-			if (it != s_eobjmap.end() && it->second->IsRunning())
+			KConcurrentMap<uint32_t, KEventBase*>::Accessor acc(s_eobjmap, id);
+			if (acc.Found() && acc.Value()->IsRunning())
 			{
-				KEventBase* b = it->second;
-				return dynamic_cast<KEventObject<EventType>*>(b)->Post(ev);
+				KEventObject<EventType>* obj = dynamic_cast<KEventObject<EventType>*>(acc.Value());
+				if (obj != NULL)
+					return obj->Post(ev);
 			}
 			return false;
         }
@@ -211,14 +237,13 @@ namespace klib {
         *************************************/
         static void PostForce(uint32_t id, const EventType& ev)
         {
-			KLockGuard<KMutex> lock(s_eobjmtx);
-			std::map<uint32_t, KEventBase*>::iterator it = s_eobjmap.find(id);
-			if (it != s_eobjmap.end() && it->second->IsRunning())
+			KConcurrentMap<uint32_t, KEventBase*>::Accessor acc(s_eobjmap, id);
+			if (acc.Found() && acc.Value()->IsRunning())
 			{
-				KEventBase* b = it->second;
-				return dynamic_cast<KEventObject<EventType>*>(b)->PostForce(ev);
+				KEventObject<EventType>* obj = dynamic_cast<KEventObject<EventType>*>(acc.Value());
+				if (obj != NULL)
+					obj->PostForce(ev);
 			}
-			return false;
         }
 
     protected:
@@ -256,7 +281,8 @@ namespace klib {
         }
 
     private:
-        KQueue<EventType> m_eventQueue;
+        // 投递和处理事件的临界区很短，使用自适应锁 //
+        KQueue<EventType, KAdaptiveMutex, KAdaptiveCondVariable> m_eventQueue;
     };
 };
 #endif // !_EVENTOBJECT_HPP_
@@ -5,6 +5,7 @@
 #include <pthread.h>
 namespace klib {
     class KCondVariable;
+    class KAdaptiveCondVariable;
     template<typename MutexType>
     class KLockGuard
     {
@@ -64,6 +65,7 @@ namespace klib {
         const MutexType& m_tmtx;
         mutable volatile bool m_acquired;
         friend class KCondVariable;
+        friend class KAdaptiveCondVariable;
     };
 };
 #endif // !_LOCKGUARD_HPP_
@@ -4,6 +4,15 @@
 #include <pthread.h>
 #include <string>
 #include <stdint.h>
+#include <vector>
+#include <cstdio>
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(LINUX)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
 #include "thread/KMutex.h"
 #include "thread/KLockGuard.h"
 #include "thread/KException.h"
@@ -13,6 +22,26 @@
 线程类
 **/
 namespace klib {
+    /**
+    线程选项，在线程启动后由线程自己设置，设置失败只打印错误不影响线程运行
+    **/
+    struct KThreadOptions
+    {
+        // 绑定的CPU，空表示不绑定 //
+        std::vector<int> cpus;
+        // 内存优先分配的NUMA 节点(linux)，-1表示不设置，未指定CPU 时绑定到该节点的CPU //
+        int numaNode;
+        // 调度策略SCHED_FIFO、SCHED_RR、SCHED_OTHER(linux)，-1表示不设置，实时策略需要权限 //
+        int policy;
+        // 调度优先级 //
+        int priority;
+        // 是否设置系统线程名(linux 最长15个字符)，便于perf、top 查看 //
+        bool setName;
+
+        KThreadOptions()
+            :numaNode(-1), policy(-1), priority(0), setName(true) {}
+    };
+
     class KPthread
     {
     public:
@@ -45,15 +74,18 @@ namespace klib {
         * Parameter: arg 函数参数
         * Parameter: lf 记录日志的成员函数
         * Parameter: ret 返回值指针
+        * Parameter: opts 线程选项
         *************************************/
         template<typename ObjectType, typename RetType, typename ArgType>
-         int Run(ObjectType* obj, RetType(ObjectType::* rf)(ArgType), ArgType arg, void(ObjectType::* lf)(const std::string&) = NULL, RetType* ret = NULL)
+         int Run(ObjectType* obj, RetType(ObjectType::* rf)(ArgType), ArgType arg, void(ObjectType::* lf)(const std::string&) = NULL, RetType* ret = NULL,
+             const KThreadOptions& opts = KThreadOptions())
         {
             KLockGuard<KMutex> lock(m_tmtx);
             if (m_running)
             {
                 return AlreadRunning;
             }
+            m_options = opts;
 
             if (!obj || !rf)
             {
@@ -101,13 +133,16 @@ namespace klib {
         * Parameter: arg 函数参数
         * Parameter: lf 记录日志的函数
         * Parameter: ret 返回值
+        * Parameter: opts 线程选项
         *************************************/
         template<typename RetType, typename ArgType>
-        int Run(RetType(*rf)(ArgType), ArgType arg, void(*lf)(const std::string&) = NULL, RetType* ret = NULL)
+        int Run(RetType(*rf)(ArgType), ArgType arg, void(*lf)(const std::string&) = NULL, RetType* ret = NULL,
+            const KThreadOptions& opts = KThreadOptions())
         {
             KLockGuard<KMutex> lock(m_tmtx);
             if (m_running)
                 return AlreadRunning;
+            m_options = opts;
 
             if (!rf)
                 return InvalidArgument;
@@ -229,6 +264,7 @@ namespace klib {
 				KLockGuard<KMutex> lock(dat->self->m_tmtx);
                 dat->self->m_running = true;
             }
+            dat->self->ApplyOptions();
             if (dat->lf)
                 (dat->obj->*dat->lf)(dat->self->m_name + " Running");
 
@@ -272,6 +308,7 @@ namespace klib {
 				KLockGuard<KMutex> lock(dat->self->m_tmtx);
 				dat->self->m_running = true;
 			}
+			dat->self->ApplyOptions();
 			if (dat->lf)
 				(*dat->lf)(dat->self->m_name + " Running");
 
@@ -291,6 +328,115 @@ namespace klib {
             return 0;
         }
 
+        /************************************
+        * Method:    在线程内设置线程选项
+        * Returns:   
+        *************************************/
+        void ApplyOptions()
+        {
+            KThreadOptions opts;
+            {
+                KLockGuard<KMutex> lock(m_tmtx);
+                opts = m_options;
+            }
+            std::vector<int> cpus = opts.cpus;
+#if defined(LINUX)
+            if (opts.setName)
+            {
+                std::string name = m_name.substr(0, 15);
+                pthread_setname_np(pthread_self(), name.c_str());
+            }
+
+            if (opts.numaNode >= 0)
+            {
+                // MPOL_PREFERRED，节点内存不足时从其他节点分配 //
+                unsigned long mask[16] = { 0 };
+                size_t bits = sizeof(unsigned long) * 8;
+                if (size_t(opts.numaNode) < sizeof(mask) * 8)
+                {
+                    mask[opts.numaNode / bits] = (1UL << (opts.numaNode % bits));
+                    if (syscall(SYS_set_mempolicy, 1, mask, sizeof(mask) * 8) != 0)
+                        printf("%s set numa node:[%d] failed, error:[%d]\n", m_name.c_str(), opts.numaNode, errno);
+                }
+
+                if (cpus.empty())
+                    GetNodeCpus(opts.numaNode, cpus);
+            }
+
+            if (!cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (size_t i = 0; i < cpus.size(); ++i)
+                {
+                    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+                        CPU_SET(cpus[i], &set);
+                }
+                int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                if (rc != 0)
+                    printf("%s set cpu affinity failed, error:[%s]\n", m_name.c_str(), KError::StdErrorStr(rc).c_str());
+            }
+
+            if (opts.policy >= 0)
+            {
+                sched_param param;
+                param.sched_priority = opts.priority;
+                int rc = pthread_setschedparam(pthread_self(), opts.policy, &param);
+                if (rc != 0)
+                    printf("%s set schedule policy:[%d] priority:[%d] failed, error:[%s]\n",
+                        m_name.c_str(), opts.policy, opts.priority, KError::StdErrorStr(rc).c_str());
+            }
+#elif defined(WIN32)
+            if (!cpus.empty())
+            {
+                DWORD_PTR mask = 0;
+                for (size_t i = 0; i < cpus.size(); ++i)
+                {
+                    if (cpus[i] >= 0 && cpus[i] < int(sizeof(mask) * 8))
+                        mask |= (DWORD_PTR(1) << cpus[i]);
+                }
+                if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+                    printf("%s set cpu affinity failed, error:[%d]\n", m_name.c_str(), int(GetLastError()));
+            }
+#endif
+        }
+
+#if defined(LINUX)
+        /************************************
+        * Method:    获取NUMA 节点的CPU
+        * Returns:   
+        * Parameter: node 节点
+        * Parameter: cpus CPU 列表
+        *************************************/
+        static void GetNodeCpus(int node, std::vector<int>& cpus)
+        {
+            char path[128] = { 0 };
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE* fp = fopen(path, "r");
+            if (fp == NULL)
+                return;
+
+            // 格式：0-3,8-11 //
+            int first = 0, last = 0;
+            while (fscanf(fp, "%d", &first) == 1)
+            {
+                last = first;
+                int c = fgetc(fp);
+                if (c == '-')
+                {
+                    if (fscanf(fp, "%d", &last) != 1)
+                        break;
+                    c = fgetc(fp);
+                }
+                for (int i = first; i <= last; ++i)
+                    cpus.push_back(i);
+                if (c != ',')
+                    break;
+            }
+            fclose(fp);
+        }
+#endif
+
         /************************************
         * Method:    获取错误信息
         * Returns:   
@@ -318,6 +464,7 @@ namespace klib {
         std::string m_name;
         KMutex m_tmtx;
         volatile bool m_running;
+        KThreadOptions m_options;
     };
 };
 #endif // !_PTHREAD_HPP_
@@ -10,7 +10,8 @@
 队列
 **/
 namespace klib {
-    template<typename ElementType>
+    // MutexType、CondType 可以是KMutex、KCondVariable 或KAdaptiveMutex、KAdaptiveCondVariable //
+    template<typename ElementType, typename MutexType = KMutex, typename CondType = KCondVariable>
     class KQueue :private std::deque<ElementType>
     {
         typedef std::deque<ElementType> QueueBase;
@@ -28,7 +29,7 @@ namespace klib {
 			m_emptyCond.NotifyAll();
 			m_fullCond.NotifyAll();
 #endif
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
         }
 
         // 从后面批量追加元素，如果空间不够则返回false，否则放入元素返回true //
@@ -37,7 +38,7 @@ namespace klib {
         {
             bool qempty = false;
             {
-                KLockGuard<KMutex> lock(m_queueMutex);
+                KLockGuard<MutexType> lock(m_queueMutex);
                 if (dat.size() > m_queueMaxSize - QueueBase::size())
 					return false;
                 qempty = QueueBase::empty();
@@ -57,8 +58,7 @@ namespace klib {
 			bool qempty = false;
 			bool rc = false;
 			{
-				KLockGuard<KMutex> lock(m_queueMutex);
-				qempty = QueueBase::empty();
+				KLockGuard<MutexType> lock(m_queueMutex);
 				if (QueueBase::size() == m_queueMaxSize)
 				{
 					if (ms < 0)
@@ -73,6 +73,7 @@ namespace klib {
 
 				if (QueueBase::size() < m_queueMaxSize)
 				{
+					qempty = QueueBase::empty();
 					QueueBase::push_back(v);
 					rc = true;
 				}
@@ -91,8 +92,7 @@ namespace klib {
 			bool qempty = false;
 			bool rc = false;
 			{
-				KLockGuard<KMutex> lock(m_queueMutex);
-				qempty = QueueBase::empty();
+				KLockGuard<MutexType> lock(m_queueMutex);
 				if (QueueBase::size() == m_queueMaxSize)
 				{
 					if (ms < 0)
@@ -109,6 +109,7 @@ namespace klib {
 
 				if (QueueBase::size() < m_queueMaxSize)
 				{
+					qempty = QueueBase::empty();
 					QueueBase::push_front(v);
 					rc = true;
 				}
@@ -127,7 +128,7 @@ namespace klib {
         {
 			bool qempty = false;
 			{
-				KLockGuard<KMutex> lock(m_queueMutex);
+				KLockGuard<MutexType> lock(m_queueMutex);
 				qempty = QueueBase::empty();
 				if (QueueBase::size() == m_queueMaxSize)
 					QueueBase::pop_front();
@@ -147,8 +148,7 @@ namespace klib {
 			bool qfull = false;
 			bool rc = false;
 			{
-				KLockGuard<KMutex> lock(m_queueMutex);
-				qfull = (QueueBase::size() == m_queueMaxSize);
+				KLockGuard<MutexType> lock(m_queueMutex);
 				if (QueueBase::empty())
 				{
 					if (ms < 0)
@@ -162,6 +162,8 @@ namespace klib {
 
 				if (!QueueBase::empty())
 				{
+					// 等待后队列状态可能已改变，取出前再判断是否满 //
+					qfull = (QueueBase::size() == m_queueMaxSize);
 					v = QueueBase::front();
 					QueueBase::pop_front();
 					rc = true;
@@ -178,7 +180,7 @@ namespace klib {
 		*************************************/
 		inline size_t Size() const
         {
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			return QueueBase::size();
         }
 
@@ -188,14 +190,14 @@ namespace klib {
 		*************************************/
 		inline void Clear()
         {
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			QueueBase::clear();
         }
 
         // 查看指定的元素 //
 		inline ElementType& Peek(size_t i)
         {
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			return QueueBase::operator [](i);
         }
 
@@ -203,7 +205,7 @@ namespace klib {
         template<typename ContainerType>
 		inline void PeekAll(ContainerType& dat)
         {
-            KLockGuard<KMutex> lock(m_queueMutex);
+            KLockGuard<MutexType> lock(m_queueMutex);
 			if (!QueueBase::empty())
 				ContainerType(QueueBase::begin(), QueueBase::end()).swap(dat);
         }
@@ -212,7 +214,7 @@ namespace klib {
 		template<typename ContainerType>
 		inline void GetAll(ContainerType& dat)
 		{
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			if (!QueueBase::empty())
 			{
 				ContainerType(QueueBase::begin(), QueueBase::end()).swap(dat);
@@ -224,7 +226,7 @@ namespace klib {
 		template<typename ContainerType>
 		inline void GetPart(size_t count, ContainerType& dat)
 		{
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			if (!QueueBase::empty())
 			{
 				count = (QueueBase::size() > count ? count : QueueBase::size());
@@ -238,21 +240,21 @@ namespace klib {
 
 		inline bool IsEmpty() const
         {
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			return QueueBase::empty();
         }
 
         inline bool IsFull() const
         {
-			KLockGuard<KMutex> lock(m_queueMutex);
+			KLockGuard<MutexType> lock(m_queueMutex);
 			return QueueBase::size() == m_queueMaxSize;
         }
 
     private:
         size_t m_queueMaxSize;
-        KMutex m_queueMutex;
-        KCondVariable m_emptyCond;
-        KCondVariable m_fullCond;
+        MutexType m_queueMutex;
+        CondType m_emptyCond;
+        CondType m_fullCond;
     };
 };
 #endif // !_QUEUE_HPP_
@@ -0,0 +1,122 @@
+#ifndef _SEQLOCK_HPP_
+#define _SEQLOCK_HPP_
+
+#include <stdint.h>
+#include "thread/KAtomic.h"
+#include "thread/KAdaptiveMutex.h"
+/**
+顺序锁，读者不写任何共享内存，读完后检查序号，期间有写入则重读
+只适用于可以按字节拷贝的小数据(不能包含指针、std::string 等)，写者之间互斥
+用法：
+    uint32_t seq;
+    do { seq = lock.ReadBegin(); copy = data; } while (lock.ReadRetry(seq));
+**/
+namespace klib {
+    class KSeqLock
+    {
+    public:
+        KSeqLock() :m_sequence(0) {}
+
+        /************************************
+        * Method:    开始读，等待正在进行的写完成
+        * Returns:   返回序号
+        *************************************/
+        inline uint32_t ReadBegin() const
+        {
+            for (;;)
+            {
+                uint32_t seq = m_sequence.Load(MoAcquire);
+                if ((seq & 1) == 0)
+                    return seq;
+                KFutex::Pause();
+            }
+        }
+
+        /************************************
+        * Method:    读完后检查是否需要重读
+        * Returns:   读期间有写入返回true
+        * Parameter: seq ReadBegin 返回的序号
+        *************************************/
+        inline bool ReadRetry(uint32_t seq) const
+        {
+            // 保证数据的读在序号的读之前完成 //
+            AtomicFence(MoAcquire);
+            return m_sequence.Load(MoRelaxed) != seq;
+        }
+
+        /************************************
+        * Method:    读取数据
+        * Returns:
+        * Parameter: src 受保护的数据
+        * Parameter: dst 拷贝
+        *************************************/
+        template<typename T>
+        inline void Read(const T& src, T& dst) const
+        {
+            uint32_t seq = 0;
+            do
+            {
+                seq = ReadBegin();
+                dst = src;
+            } while (ReadRetry(seq));
+        }
+
+        /************************************
+        * Method:    开始写，序号变为奇数
+        * Returns:
+        *************************************/
+        inline void Lock() const
+        {
+            m_writerMtx.Lock();
+            m_sequence.Store(m_sequence.Load(MoRelaxed) + 1, MoRelaxed);
+            // 保证序号的写在数据的写之前可见 //
+            AtomicFence(MoRelease);
+        }
+
+        /************************************
+        * Method:    结束写，序号变为偶数
+        * Returns:
+        *************************************/
+        inline void Unlock() const
+        {
+            m_sequence.Store(m_sequence.Load(MoRelaxed) + 1, MoRelease);
+            m_writerMtx.Unlock();
+        }
+
+        /************************************
+        * Method:    尝试开始写
+        * Returns:   成功返回true
+        *************************************/
+        inline bool TryLock() const
+        {
+            if (!m_writerMtx.TryLock())
+                return false;
+            m_sequence.Store(m_sequence.Load(MoRelaxed) + 1, MoRelaxed);
+            AtomicFence(MoRelease);
+            return true;
+        }
+
+        /************************************
+        * Method:    写入数据
+        * Returns:
+        * Parameter: dst 受保护的数据
+        * Parameter: src 新数据
+        *************************************/
+        template<typename T>
+        inline void Write(T& dst, const T& src) const
+        {
+            Lock();
+            dst = src;
+            Unlock();
+        }
+
+    private:
+        KSeqLock(const KSeqLock&);
+        KSeqLock& operator=(const KSeqLock&);
+
+    private:
+        mutable AtomicInteger<uint32_t> m_sequence;
+        KAdaptiveMutex m_writerMtx;
+    };
+};
+#endif // !_SEQLOCK_HPP_
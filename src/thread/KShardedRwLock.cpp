@@ -0,0 +1,175 @@
+#include "thread/KShardedRwLock.h"
+#include "util/KTime.h"
+#include <climits>
+#include <pthread.h>
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+namespace klib {
+    static pthread_once_t s_slotOnce = PTHREAD_ONCE_INIT;
+    static pthread_key_t s_slotKey;
+    static AtomicInteger<uint32_t> s_nextSlot;
+
+    static void CreateSlotKey()
+    {
+        pthread_key_create(&s_slotKey, NULL);
+    }
+
+    static size_t DefaultShards()
+    {
+#if defined(WIN32)
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return size_t(si.dwNumberOfProcessors);
+#else
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return (n > 0 ? size_t(n) : 1);
+#endif
+    }
+
+    KShardedRwLock::KShardedRwLock(size_t shards, Preference pref)
+        :m_preference(pref), m_writer(0)
+    {
+        if (shards == 0)
+            shards = DefaultShards();
+        m_shardCount = 1;
+        while (m_shardCount < shards)
+            m_shardCount <<= 1;
+        m_shards = new Shard[m_shardCount];
+    }
+
+    KShardedRwLock::~KShardedRwLock()
+    {
+        delete[] m_shards;
+    }
+
+    uint32_t KShardedRwLock::CurrentSlot()
+    {
+        pthread_once(&s_slotOnce, CreateSlotKey);
+        // 保存序号加1，0表示未分配 //
+        size_t slot = size_t(pthread_getspecific(s_slotKey));
+        if (slot == 0)
+        {
+            slot = size_t(++s_nextSlot);
+            pthread_setspecific(s_slotKey, (void*)slot);
+        }
+        return uint32_t(slot - 1);
+    }
+
+    void KShardedRwLock::RdLock() const
+    {
+        AtomicInteger<int32_t>& readers = CurrentShard();
+        for (;;)
+        {
+            // 先加计数再检查写者，写者先置标志再检查计数，两者至少有一方能看到对方 //
+            readers.FetchAdd(1);
+            if (KFutex::Load(&m_writer) == 0)
+                return;
+            readers.FetchSub(1, MoRelease);
+            WaitWriter();
+        }
+    }
+
+    bool KShardedRwLock::TryRdLock() const
+    {
+        AtomicInteger<int32_t>& readers = CurrentShard();
+        readers.FetchAdd(1);
+        if (KFutex::Load(&m_writer) == 0)
+            return true;
+        readers.FetchSub(1, MoRelease);
+        return false;
+    }
+
+    void KShardedRwLock::RdUnlock() const
+    {
+        CurrentShard().FetchSub(1, MoRelease);
+    }
+
+    void KShardedRwLock::WRLock() const
+    {
+        m_writerMtx.Lock();
+        for (int spins = 0;; ++spins)
+        {
+            KFutex::Exchange(&m_writer, 1);
+            if (m_preference == PreferWriter)
+            {
+                // 新读者会让出，等待已有的读者结束 //
+                for (int i = 0; !Drained(); ++i)
+                {
+                    if (i < 100)
+                        KFutex::Pause();
+                    else
+                        KTime::MSleep(0);
+                }
+                return;
+            }
+
+            if (Drained())
+                return;
+
+            // 读者优先，让出后重试 //
+            ClearWriter();
+            if (spins < 100)
+                KFutex::Pause();
+            else
+                KTime::MSleep(0);
+        }
+    }
+
+    bool KShardedRwLock::TryWRLock() const
+    {
+        if (!m_writerMtx.TryLock())
+            return false;
+
+        KFutex::Exchange(&m_writer, 1);
+        if (Drained())
+            return true;
+
+        ClearWriter();
+        m_writerMtx.Unlock();
+        return false;
+    }
+
+    void KShardedRwLock::WRUnlock() const
+    {
+        ClearWriter();
+        m_writerMtx.Unlock();
+    }
+
+    void KShardedRwLock::WaitWriter() const
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            if (m_writer == 0)
+                return;
+            KFutex::Pause();
+        }
+
+        // 置为2表示有读者挂起，写者释放时才需要唤醒 //
+        int w = 0;
+        while ((w = KFutex::Load(&m_writer)) != 0)
+        {
+            if (w == 1 && KFutex::CompareExchange(&m_writer, 1, 2) != 1)
+                continue;
+            KFutex::Wait(&m_writer, 2);
+        }
+    }
+
+    bool KShardedRwLock::Drained() const
+    {
+        for (size_t i = 0; i < m_shardCount; ++i)
+        {
+            if (m_shards[i].readers.Load() != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void KShardedRwLock::ClearWriter() const
+    {
+        if (KFutex::Exchange(&m_writer, 0) == 2)
+            KFutex::Wake(&m_writer, INT_MAX);
+    }
+};
@@ -0,0 +1,145 @@
+#ifndef _SHARDEDRWLOCK_HPP_
+#define _SHARDEDRWLOCK_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "thread/KAtomic.h"
+#include "thread/KAdaptiveMutex.h"
+/**
+分片读写锁(big-reader lock)，每个线程固定使用一个分片的读计数，分片按缓存行隔开，
+多个线程同时读不会争用同一缓存行；写者需要等待所有分片的读计数归零，写开销较大，适用于读远多于写的数据
+不支持同一线程重复加读锁
+**/
+namespace klib {
+    class KShardedRwLock
+    {
+    public:
+        // 写者优先时读者看到写者等待即让出，读者优先时写者在有读者时让出并重试 //
+        enum Preference { PreferWriter, PreferReader };
+
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: shards 分片个数，0表示CPU 个数，向上取2的幂
+        * Parameter: pref 读写优先策略
+        *************************************/
+        explicit KShardedRwLock(size_t shards = 0, Preference pref = PreferWriter);
+
+        ~KShardedRwLock();
+
+        /************************************
+        * Method:    加读锁
+        * Returns:
+        *************************************/
+        void RdLock() const;
+
+        /************************************
+        * Method:    尝试加读锁
+        * Returns:   成功返回true，有写者时返回false
+        *************************************/
+        bool TryRdLock() const;
+
+        /************************************
+        * Method:    解读锁
+        * Returns:
+        *************************************/
+        void RdUnlock() const;
+
+        /************************************
+        * Method:    加写锁
+        * Returns:
+        *************************************/
+        void WRLock() const;
+
+        /************************************
+        * Method:    尝试加写锁
+        * Returns:   成功返回true，有写者或读者时返回false
+        *************************************/
+        bool TryWRLock() const;
+
+        /************************************
+        * Method:    解写锁
+        * Returns:
+        *************************************/
+        void WRUnlock() const;
+
+        /**
+        读锁守卫
+        **/
+        class ReadGuard
+        {
+        public:
+            ReadGuard(const KShardedRwLock& lock) :m_lock(lock) { m_lock.RdLock(); }
+            ~ReadGuard() { m_lock.RdUnlock(); }
+
+        private:
+            ReadGuard(const ReadGuard&);
+            ReadGuard& operator=(const ReadGuard&);
+            const KShardedRwLock& m_lock;
+        };
+
+        /**
+        写锁守卫
+        **/
+        class WriteGuard
+        {
+        public:
+            WriteGuard(const KShardedRwLock& lock) :m_lock(lock) { m_lock.WRLock(); }
+            ~WriteGuard() { m_lock.WRUnlock(); }
+
+        private:
+            WriteGuard(const WriteGuard&);
+            WriteGuard& operator=(const WriteGuard&);
+            const KShardedRwLock& m_lock;
+        };
+
+    private:
+        KShardedRwLock(const KShardedRwLock&);
+        KShardedRwLock& operator=(const KShardedRwLock&);
+
+        /************************************
+        * Method:    当前线程的序号，首次调用时分配
+        * Returns:
+        *************************************/
+        static uint32_t CurrentSlot();
+
+        inline AtomicInteger<int32_t>& CurrentShard() const
+        {
+            return m_shards[CurrentSlot() & (m_shardCount - 1)].readers;
+        }
+
+        /************************************
+        * Method:    等待写者释放
+        * Returns:
+        *************************************/
+        void WaitWriter() const;
+
+        /************************************
+        * Method:    所有分片的读计数是否为0
+        * Returns:
+        *************************************/
+        bool Drained() const;
+
+        /************************************
+        * Method:    清除写者标志并唤醒等待的读者
+        * Returns:
+        *************************************/
+        void ClearWriter() const;
+
+    private:
+        struct Shard
+        {
+            AtomicInteger<int32_t> readers;
+            char padding[64];
+        };
+
+        Shard* m_shards;
+        size_t m_shardCount;
+        Preference m_preference;
+        // 写者之间互斥 //
+        KAdaptiveMutex m_writerMtx;
+        // 0:没有写者 1:有写者等待或持有锁 2:有写者且有读者挂起 //
+        mutable volatile int m_writer;
+    };
+};
+#endif // !_SHARDEDRWLOCK_HPP_
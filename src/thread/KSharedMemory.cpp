@@ -1 +1,444 @@
 #include "KSharedMemory.h"
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KAdaptiveMutex.h"
+#include "util/KTime.h"
+#include <map>
+#include <cstring>
+#include <cstdlib>
+#if !defined(WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(LINUX)
+#include <sys/syscall.h>
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+#endif
+namespace klib
+{
+	// 本进程打开的System V key 与名称，不同名称散列到同一个key 时拒绝创建 //
+	static std::map<int32_t, std::string> s_sysvNames;
+	static KMutex s_sysvMtx;
+
+	// added 为true 表示本次新登记，创建失败时需要撤销 //
+	static bool RegisterSysV(int32_t key, const std::string& name, bool& added)
+	{
+		KLockGuard<KMutex> lock(s_sysvMtx);
+		std::map<int32_t, std::string>::iterator it = s_sysvNames.find(key);
+		added = (it == s_sysvNames.end());
+		if (!added && it->second != name)
+		{
+			printf("Shared memory [%s] hash code:[%d] collides with [%s]\n", name.c_str(), key, it->second.c_str());
+			return false;
+		}
+		s_sysvNames[key] = name;
+		return true;
+	}
+
+	static void UnregisterSysV(int32_t key)
+	{
+		KLockGuard<KMutex> lock(s_sysvMtx);
+		s_sysvNames.erase(key);
+	}
+
+#ifndef WIN32
+	static void CloseFd(int& fd)
+	{
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+	}
+#endif
+
+	// posix 对象名以/开头且不能再含/ //
+	static std::string PosixName(const std::string& key)
+	{
+		std::string name("/");
+		for (size_t i = 0; i < key.size(); ++i)
+			name.push_back(key[i] == '/' ? '_' : key[i]);
+		return name;
+	}
+
+	static int CurrentProcess()
+	{
+#if defined(WIN32)
+		return int(GetCurrentProcessId());
+#else
+		return int(getpid());
+#endif
+	}
+
+	static bool ProcessAlive(int pid)
+	{
+#if defined(WIN32)
+		HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, DWORD(pid));
+		if (h == NULL)
+			return false;
+		bool alive = (WaitForSingleObject(h, 0) == WAIT_TIMEOUT);
+		CloseHandle(h);
+		return alive;
+#else
+		return kill(pid_t(pid), 0) == 0 || errno != ESRCH;
+#endif
+	}
+
+	static size_t RoundUp(size_t len, size_t align)
+	{
+		return (len + align - 1) / align * align;
+	}
+
+	KSharedMemory::KSharedMemory()
+#ifdef WIN32
+		:m_shmBuf(NULL), m_hMap(NULL),
+#else
+		:m_shmId(-1), m_shmBuf(NULL),
+#endif
+		m_fd(-1), m_size(0), m_backend(SbSysV), m_hugePage(HpNone)
+	{
+	}
+
+	bool KSharedMemory::Create(const std::string& key, size_t len, const KShmOptions& opts)
+	{
+		m_name = key;
+		// 共享内存标识符 创建共享内存  //
+#ifdef WIN32
+		int hashKey = HashCode(key);
+		printf("str:[%s] hash code:[%d]\n", key.c_str(), hashKey);
+		// 首先试图打开一个命名的内存映射文件对象  //
+		m_hMap = OpenFileMapping(FILE_MAP_ALL_ACCESS, 0, key.c_str());
+		if (NULL == m_hMap)
+			m_hMap = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, len, key.c_str());
+		if (NULL == m_hMap)
+			return false;
+		// 映射对象的一个视图，得到指向共享内存的指针，设置里面的数据 //
+		m_shmBuf = MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		m_size = len;
+		return true;
+#else
+		m_backend = opts.backend;
+		m_hugePage = opts.hugePage;
+		if (m_hugePage == HpTlb)
+			len = RoundUp(len, GetHugePageSize());
+
+		if (m_backend == SbSysV)
+		{
+			int hashKey = HashCode(key);
+			bool added = false;
+			if (!RegisterSysV(hashKey, key, added))
+				return false;
+
+			int flags = opts.mode | (opts.create ? IPC_CREAT : 0);
+#if defined(SHM_HUGETLB)
+			if (m_hugePage == HpTlb)
+				flags |= SHM_HUGETLB;
+#endif
+			m_shmId = shmget((key_t)hashKey, len, flags);
+			if (m_shmId == -1)
+			{
+				printf("shmget failed\n");
+				if (added)
+					UnregisterSysV(hashKey);
+				return false;
+			}
+
+			m_shmBuf = shmat(m_shmId, 0, 0);
+			if (m_shmBuf == (void*)-1)
+			{
+				m_shmBuf = NULL;
+				m_shmId = -1;
+				printf("shmat failed\n");
+				if (added)
+					UnregisterSysV(hashKey);
+				return false;
+			}
+			m_size = len;
+			Advise();
+			return true;
+		}
+
+		int oflag = O_RDWR | (opts.create ? O_CREAT : 0);
+		if (m_backend == SbMemfd)
+		{
+#if defined(LINUX) && defined(SYS_memfd_create)
+			unsigned int flags = MFD_CLOEXEC | (m_hugePage == HpTlb ? MFD_HUGETLB : 0);
+			m_fd = int(syscall(SYS_memfd_create, key.c_str(), flags));
+#else
+			errno = ENOSYS;
+#endif
+		}
+		else if (m_hugePage == HpTlb)
+		{
+			// tmpfs 不支持预留大页，在hugetlbfs 下创建 //
+			m_path = opts.hugeDir + PosixName(key);
+			m_fd = open(m_path.c_str(), oflag, opts.mode);
+		}
+		else
+		{
+			m_path = PosixName(key);
+			m_fd = shm_open(m_path.c_str(), oflag, opts.mode);
+		}
+
+		if (m_fd < 0)
+		{
+			printf("Open shared memory [%s] failed:[%s]\n", key.c_str(), strerror(errno));
+			return false;
+		}
+
+		// 已存在的对象只扩大不缩小 //
+		struct stat st;
+		if (fstat(m_fd, &st) != 0)
+		{
+			printf("fstat shared memory [%s] failed:[%s]\n", key.c_str(), strerror(errno));
+			CloseFd(m_fd);
+			return false;
+		}
+		if (len == 0)
+			len = size_t(st.st_size);
+		else if (size_t(st.st_size) < len && ftruncate(m_fd, off_t(len)) != 0)
+		{
+			printf("ftruncate shared memory [%s] failed:[%s]\n", key.c_str(), strerror(errno));
+			CloseFd(m_fd);
+			return false;
+		}
+		if (!Map(len))
+		{
+			CloseFd(m_fd);
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	bool KSharedMemory::Attach(int fd, ShmHugePage hugePage)
+	{
+#ifdef WIN32
+		return false;
+#else
+		m_backend = SbMemfd;
+		m_hugePage = hugePage;
+		m_fd = dup(fd);
+		struct stat st;
+		if (m_fd < 0 || fstat(m_fd, &st) != 0)
+		{
+			printf("Attach shared memory fd:[%d] failed:[%s]\n", fd, strerror(errno));
+			CloseFd(m_fd);
+			return false;
+		}
+		if (!Map(size_t(st.st_size)))
+		{
+			CloseFd(m_fd);
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	bool KSharedMemory::Resize(size_t len)
+	{
+#ifdef WIN32
+		return false;
+#else
+		if (m_backend == SbSysV || m_fd < 0)
+			return false;
+		if (m_hugePage == HpTlb)
+			len = RoundUp(len, GetHugePageSize());
+
+		struct stat st;
+		if (fstat(m_fd, &st) != 0)
+			return false;
+		if (size_t(st.st_size) < len && ftruncate(m_fd, off_t(len)) != 0)
+		{
+			printf("ftruncate shared memory [%s] failed:[%s]\n", m_name.c_str(), strerror(errno));
+			return false;
+		}
+		return RemapTo(len);
+#endif
+	}
+
+	bool KSharedMemory::Remap()
+	{
+#ifdef WIN32
+		return false;
+#else
+		struct stat st;
+		if (m_backend == SbSysV || m_fd < 0 || fstat(m_fd, &st) != 0)
+			return false;
+		return RemapTo(size_t(st.st_size));
+#endif
+	}
+
+	bool KSharedMemory::Map(size_t len)
+	{
+#ifdef WIN32
+		return false;
+#else
+		void* buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (buf == MAP_FAILED)
+		{
+			printf("mmap shared memory [%s] failed:[%s]\n", m_name.c_str(), strerror(errno));
+			return false;
+		}
+		m_shmBuf = buf;
+		m_size = len;
+		Advise();
+		return true;
+#endif
+	}
+
+	bool KSharedMemory::RemapTo(size_t len)
+	{
+#ifdef WIN32
+		return false;
+#else
+		if (len == m_size)
+			return true;
+		if (m_shmBuf == NULL)
+			return Map(len);
+#if defined(LINUX) && defined(MREMAP_MAYMOVE)
+		void* buf = mremap(m_shmBuf, m_size, len, MREMAP_MAYMOVE);
+		if (buf != MAP_FAILED)
+		{
+			m_shmBuf = buf;
+			m_size = len;
+			Advise();
+			return true;
+		}
+#endif
+		// 大页映射可能不支持mremap //
+		munmap(m_shmBuf, m_size);
+		m_shmBuf = NULL;
+		m_size = 0;
+		return Map(len);
+#endif
+	}
+
+	void KSharedMemory::Advise()
+	{
+#if defined(LINUX) && defined(MADV_HUGEPAGE)
+		if (m_hugePage == HpAdvise && m_shmBuf != NULL)
+			madvise(m_shmBuf, m_size, MADV_HUGEPAGE);
+#endif
+	}
+
+	bool KSharedMemory::Detach()
+	{
+#ifdef WIN32
+		return UnmapViewOfFile(m_shmBuf);
+#else
+		if (m_backend == SbSysV)
+		{
+			// 把共享内存从当前进程中分离 //
+			if (shmdt(m_shmBuf) == -1)
+			{
+				printf("shmdt failed\n");
+				return false;
+			}
+			m_shmBuf = NULL;
+			return true;
+		}
+
+		if (m_fd >= 0)
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+		if (m_shmBuf != NULL && munmap(m_shmBuf, m_size) != 0)
+		{
+			printf("munmap failed\n");
+			return false;
+		}
+		m_shmBuf = NULL;
+		return true;
+#endif
+	}
+
+	void KSharedMemory::Release()
+	{
+#ifdef WIN32
+		CloseHandle(m_hMap);
+#else
+		if (m_backend == SbSysV)
+		{
+			// 删除共享内存 //
+			if (shmctl(m_shmId, IPC_RMID, 0) == -1)
+			{
+				printf("shmctl(IPC_RMID) failed\n");
+			}
+			UnregisterSysV(HashCode(m_name));
+		}
+		else if (m_backend == SbPosix)
+		{
+			int rc = (m_hugePage == HpTlb ? unlink(m_path.c_str()) : shm_unlink(m_path.c_str()));
+			if (rc == -1)
+				printf("Unlink shared memory [%s] failed:[%s]\n", m_path.c_str(), strerror(errno));
+		}
+#endif
+	}
+
+	int KSharedMemory::BeginInitialize(volatile int* state)
+	{
+		for (;;)
+		{
+			int st = KFutex::Load(state);
+			if (st == -1)
+				return 0;
+			if (st == 0)
+			{
+				if (KFutex::CompareExchange(state, 0, CurrentProcess()) == 0)
+					return 1;
+				continue;
+			}
+			if (st < 0)
+				return -1;
+
+			// 初始化的进程已退出，重新初始化 //
+			if (!ProcessAlive(st))
+				KFutex::CompareExchange(state, st, 0);
+			else
+				KTime::MSleep(1);
+		}
+	}
+
+	void KSharedMemory::EndInitialize(volatile int* state)
+	{
+		KFutex::Exchange(state, -1);
+	}
+
+	size_t KSharedMemory::GetHugePageSize()
+	{
+		static size_t hugePageSize = 0;
+		if (hugePageSize != 0)
+			return hugePageSize;
+
+		size_t sz = 2 * 1024 * 1024;
+#if defined(LINUX)
+		FILE* fp = fopen("/proc/meminfo", "r");
+		if (fp != NULL)
+		{
+			char line[128] = { 0 };
+			while (fgets(line, sizeof(line), fp) != NULL)
+			{
+				if (strncmp(line, "Hugepagesize:", 13) == 0)
+				{
+					size_t kb = size_t(strtoul(line + 13, NULL, 10));
+					if (kb > 0)
+						sz = kb * 1024;
+					break;
+				}
+			}
+			fclose(fp);
+		}
+#endif
+		hugePageSize = sz;
+		return sz;
+	}
+};
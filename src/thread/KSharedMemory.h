@@ -1,3 +1,6 @@
+#ifndef _SHAREDMEMORY_HPP_
+#define _SHAREDMEMORY_HPP_
+
 #ifdef WIN32
 #include <windows.h>
 #else
@@ -10,77 +13,97 @@
 #include <stdint.h>
 namespace klib
 {
+	enum ShmBackend
+	{
+		// System V(ɢΪkey)shm_open(Ƽ)memfd_create(̣ͨlinux) //
+		SbSysV, SbPosix, SbMemfd
+	};
+
+	enum ShmHugePage
+	{
+		// ͨҳmadvise ͸ҳԤҳ(SHM_HUGETLBMFD_HUGETLB hugetlbfsСҳ) //
+		HpNone, HpAdvise, HpTlb
+	};
+
+	/**
+	ڴѡwindows ֻʹĬѡ
+	**/
+	struct KShmOptions
+	{
+		KShmOptions()
+			:backend(SbSysV), hugePage(HpNone), create(true), mode(0666), hugeDir("/dev/hugepages")
+		{
+		}
+
+		ShmBackend backend;
+		ShmHugePage hugePage;
+		// ʱ //
+		bool create;
+		// ʱȨ //
+		int mode;
+		// shm_open ʹԤҳʱΪhugetlbfs Ŀ¼´ļ //
+		std::string hugeDir;
+	};
+
 	class KSharedMemory
 	{
 	public:
-		KSharedMemory()
-			:m_shmBuf(NULL)
+		KSharedMemory();
+
+		/************************************
+		* Method:    System V ڴ
+		* Returns:   ɹtrue
+		* Parameter: key 
+		* Parameter: len С
+		*************************************/
+		inline bool Create(const std::string& key, size_t len)
 		{
+			return Create(key, len, KShmOptions());
 		}
 
-		bool Create(const std::string& key, size_t len)
-		{
-			// ڴʶ ڴ  //
-#ifdef WIN32
-			int hashKey = HashCode(key);
-			printf("str:[%s] hash code:[%d]\n", key.c_str(), hashKey);
-			// ͼһڴӳļ  //
-			m_hMap = OpenFileMapping(FILE_MAP_ALL_ACCESS, 0, key.c_str());
-			if (NULL == m_hMap)
-				m_hMap = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, len, key.c_str());
-			if (NULL == m_hMap)
-				return false;
-			// ӳһͼõָڴָ룬 //
-			m_shmBuf = MapViewOfFile(m_hMap, FILE_MAP_ALL_ACCESS, 0, 0, 0);
-			return true;
-#else
-			int hashKey = HashCode(key);
-			m_shmId = shmget((key_t)hashKey, len, 0666 | IPC_CREAT);
-			if (m_shmId == -1)
-			{
-				printf("shmget failed\n");
-				return false;
-			}
+		/************************************
+		* Method:    ѡ򿪹ڴ棬ѴڵĶСlen ʱ
+		* Returns:   ɹtrueSystem V ɢ뱾Ѵ򿪵Ƴͻʱfalse
+		* Parameter: key ƣmemfd ʱֻڵ
+		* Parameter: len Сposix Ϊ0ʱʹжĴС
+		* Parameter: opts ѡ
+		*************************************/
+		bool Create(const std::string& key, size_t len, const KShmOptions& opts);
 
-			m_shmBuf = shmat(m_shmId, 0, 0);
-			if (m_shmBuf == (void*)-1)
-			{
-				printf("shmat failed\n");
-				return false;
-			}
-			return true;
-#endif
-		};
+		/************************************
+		* Method:    ӳ̴memfd ᱻ
+		* Returns:   ɹtrue
+		* Parameter: fd 
+		* Parameter: hugePage ҳѡHpTlb ʱ봴һ
+		*************************************/
+		bool Attach(int fd, ShmHugePage hugePage = HpNone);
+
+		/************************************
+		* Method:    Сֻ֧posix memfdӳַܸı䣬Remap
+		* Returns:   ɹtrue
+		* Parameter: len ´ССڶСʱֻС̵ӳ
+		*************************************/
+		bool Resize(size_t len);
+
+		/************************************
+		* Method:    ǰСӳ䣬ӳַܸı
+		* Returns:   ɹtrue
+		*************************************/
+		bool Remap();
 
 		inline void* GetBuffer() const { return m_shmBuf; }
 
-		bool Detach()
-		{
-#ifdef WIN32
-			return UnmapViewOfFile(m_shmBuf);
-#else
-			// ѹڴӵǰз //
-			if (shmdt(m_shmBuf) == -1)
-			{
-				printf("shmdt failed\n");
-				return false;
-			}
-			return true;
-#endif
-		};
+		inline size_t GetSize() const { return m_size; }
 
-		void Release()
-		{
-#ifdef WIN32
-			CloseHandle(m_hMap);
-#else
-			// ɾڴ //   
-			if (shmctl(m_shmId, IPC_RMID, 0) == -1)
-			{
-				printf("shmctl(IPC_RMID) failed\n");
-			}
-#endif
-		};
+		/************************************
+		* Method:    ȡڰmemfd 
+		* Returns:   System V windows -1
+		*************************************/
+		inline int GetFd() const { return m_fd; }
+
+		bool Detach();
+
+		void Release();
 
 		int32_t HashCode(const std::string& s)
 		{
@@ -96,6 +119,47 @@ namespace klib
 			return (hash & 0x7FFFFFFF);
 		};
 
+		/************************************
+		* Method:    ϵͳĬϴҳС
+		* Returns:
+		*************************************/
+		static size_t GetHugePageSize();
+
+		/************************************
+		* Method:    ʼʼڴеĽṹʼĽ˳³ʼ
+		* Returns:   1 ɵ߳ʼɺEndInitialize0 Ѿ-1 ״̬쳣
+		* Parameter: state ڴеĳʼ״̬½ʱΪ0Ϊ-1ʼΪ̺
+		*************************************/
+		static int BeginInitialize(volatile int* state);
+
+		/************************************
+		* Method:    ɳʼ
+		* Returns:
+		* Parameter: state ʼ״̬
+		*************************************/
+		static void EndInitialize(volatile int* state);
+
+	private:
+		/************************************
+		* Method:    ӳ
+		* Returns:   ɹtrue
+		* Parameter: len С
+		*************************************/
+		bool Map(size_t len);
+
+		/************************************
+		* Method:    ӳС
+		* Returns:   ɹtrue
+		* Parameter: len С
+		*************************************/
+		bool RemapTo(size_t len);
+
+		/************************************
+		* Method:    ѡ͸ҳ
+		* Returns:
+		*************************************/
+		void Advise();
+
 	private:
 #ifdef WIN32
 		LPVOID m_shmBuf;
@@ -106,6 +170,15 @@ namespace klib
 		void* m_shmBuf;
 
 #endif
+		int m_fd;
+		size_t m_size;
+		ShmBackend m_backend;
+		ShmHugePage m_hugePage;
+		// ƣSystem V ɢгͻposix ɾʱʹ //
+		std::string m_name;
+		// posix hugetlbfs ļ· //
+		std::string m_path;
 	};
 
 };
+#endif // !_SHAREDMEMORY_HPP_
@@ -0,0 +1,299 @@
+#include "thread/KShmRing.h"
+#include "thread/KAdaptiveMutex.h"
+#include "util/KTime.h"
+#include <cstring>
+#include <climits>
+namespace klib {
+    static const uint32_t RingMagic = 0x4B524E47;
+    static const uint32_t RingVersion = 1;
+    // 挂起前的自旋次数，对方通常很快就会读写 //
+    static const int RingSpins = 1000;
+
+    /************************************
+    * Method:    剩余等待时间
+    * Returns:   小于0表示一直等待，0表示已超时
+    * Parameter: ms 总等待毫秒
+    * Parameter: start 开始时间，首次调用时设置
+    *************************************/
+    static int RemainMs(int ms, uint64_t& start)
+    {
+        if (ms <= 0)
+            return ms;
+        uint64_t now = 0;
+        KTime::NowMillisecond(now);
+        if (start == 0)
+            start = now;
+        uint64_t elapsed = now - start;
+        return elapsed >= uint64_t(ms) ? 0 : int(ms - elapsed);
+    }
+
+    KShmRing::KShmRing()
+        :m_header(NULL), m_data(NULL), m_capacity(0), m_mode(SingleProducer), m_cachedHead(0)
+    {
+    }
+
+    KShmRing::~KShmRing()
+    {
+        Close();
+    }
+
+    bool KShmRing::Create(const std::string& key, size_t capacity, Mode mode, const KShmOptions& opts)
+    {
+        Close();
+        uint32_t cap = 4096;
+        while (cap < capacity && cap < 0x40000000)
+            cap <<= 1;
+
+        if (!m_shm.Create(key, sizeof(RingHeader) + cap, opts))
+            return false;
+
+        m_header = static_cast<RingHeader*>(m_shm.GetBuffer());
+        m_data = reinterpret_cast<char*>(m_header + 1);
+        m_capacity = cap;
+        m_mode = mode;
+        int rc = KSharedMemory::BeginInitialize(&m_header->initState);
+        if (rc < 0)
+        {
+            printf("Shm ring [%s] corrupted\n", key.c_str());
+            Close();
+            return false;
+        }
+
+        if (rc > 0)
+        {
+            Initialize();
+            KSharedMemory::EndInitialize(&m_header->initState);
+            m_cachedHead = 0;
+            return true;
+        }
+
+        if (m_header->magic != RingMagic || m_header->version != RingVersion
+            || m_header->capacity != cap || m_header->mode != uint32_t(mode))
+        {
+            printf("Shm ring [%s] mismatch, capacity:[%u] mode:[%u]\n", key.c_str(), m_header->capacity, m_header->mode);
+            Close();
+            return false;
+        }
+        m_cachedHead = uint32_t(m_header->head);
+        return true;
+    }
+
+    void KShmRing::Close()
+    {
+        if (m_header == NULL)
+            return;
+        m_shm.Detach();
+        m_header = NULL;
+        m_data = NULL;
+    }
+
+    void KShmRing::Destroy()
+    {
+        if (m_header == NULL)
+            return;
+        m_shm.Detach();
+        m_shm.Release();
+        m_header = NULL;
+        m_data = NULL;
+    }
+
+    void KShmRing::Reset()
+    {
+        if (m_header == NULL)
+            return;
+        Initialize();
+        KSharedMemory::EndInitialize(&m_header->initState);
+        m_cachedHead = 0;
+    }
+
+    void KShmRing::Initialize()
+    {
+        m_header->magic = RingMagic;
+        m_header->version = RingVersion;
+        m_header->capacity = m_capacity;
+        m_header->mode = uint32_t(m_mode);
+        m_header->tail = 0;
+        m_header->head = 0;
+        m_header->dataSignal = 0;
+        m_header->consumerWaiting = 0;
+        m_header->spaceSignal = 0;
+        m_header->producerWaiting = 0;
+        // 未提交的记录头必须为0 //
+        memset(m_data, 0, m_capacity);
+    }
+
+    bool KShmRing::Reserve(uint32_t need, uint32_t& pos, uint32_t& pad)
+    {
+        for (;;)
+        {
+            pos = uint32_t(m_mode == MultiProducer ? KFutex::Load(&m_header->tail) : m_header->tail);
+            // 到队尾放不下时填充，从头开始写 //
+            uint32_t rem = m_capacity - (pos & (m_capacity - 1));
+            pad = (rem < need ? rem : 0);
+            uint32_t total = pad + need;
+            if (m_mode == SingleProducer)
+            {
+                if (pos + total - m_cachedHead > m_capacity)
+                {
+                    m_cachedHead = uint32_t(KFutex::Load(&m_header->head));
+                    if (pos + total - m_cachedHead > m_capacity)
+                        return false;
+                }
+                m_header->tail = int(pos + total);
+                return true;
+            }
+
+            uint32_t head = uint32_t(KFutex::Load(&m_header->head));
+            if (pos + total - head > m_capacity)
+                return false;
+            if (KFutex::CompareExchange(&m_header->tail, int(pos), int(pos + total)) == int(pos))
+                return true;
+        }
+    }
+
+    bool KShmRing::Write(const void* data, uint32_t len, int ms)
+    {
+        if (m_header == NULL || len > GetMaxRecord())
+            return false;
+
+        uint32_t need = Align(uint32_t(sizeof(RecordHeader)) + len);
+        uint32_t pos = 0;
+        uint32_t pad = 0;
+        uint64_t start = 0;
+        for (int spins = 0; !Reserve(need, pos, pad); ++spins)
+        {
+            if (ms != 0 && spins < RingSpins)
+            {
+                KFutex::Pause();
+                continue;
+            }
+
+            int wait = RemainMs(ms, start);
+            if (wait == 0)
+                return false;
+
+            // 先登记再检查，消费者移动读取位置后看到登记会唤醒 //
+            int seq = KFutex::Load(&m_header->spaceSignal);
+            KFutex::AddFetch(&m_header->producerWaiting, 1);
+            bool reserved = Reserve(need, pos, pad);
+            if (!reserved)
+                KFutex::Wait(&m_header->spaceSignal, seq, wait, true);
+            KFutex::AddFetch(&m_header->producerWaiting, -1);
+            if (reserved)
+                break;
+        }
+
+        if (pad > 0)
+        {
+            RecordHeader* padding = RecordAt(pos);
+            padding->length = pad - uint32_t(sizeof(RecordHeader));
+            KFutex::Exchange(&padding->state, RecordPadding);
+            pos += pad;
+        }
+
+        RecordHeader* rec = RecordAt(pos);
+        rec->length = len;
+        memcpy(rec + 1, data, len);
+        // 交换保证数据先可见，且提交后再读等待标志 //
+        KFutex::Exchange(&rec->state, RecordData);
+        if (KFutex::Load(&m_header->consumerWaiting) > 0)
+        {
+            KFutex::AddFetch(&m_header->dataSignal, 1);
+            KFutex::Wake(&m_header->dataSignal, 1, true);
+        }
+        return true;
+    }
+
+    KShmRing::RecordHeader* KShmRing::NextRecord()
+    {
+        for (;;)
+        {
+            uint32_t pos = uint32_t(m_header->head);
+            RecordHeader* rec = RecordAt(pos);
+            int state = rec->state;
+            AtomicFence(MoAcquire);
+            if (state == RecordData)
+                return rec;
+            if (state != RecordPadding)
+                return NULL;
+            Advance(pos, uint32_t(sizeof(RecordHeader)) + rec->length);
+        }
+    }
+
+    void KShmRing::Advance(uint32_t pos, uint32_t size)
+    {
+        memset(RecordAt(pos), 0, size);
+        KFutex::Exchange(&m_header->head, int(pos + size));
+        if (KFutex::Load(&m_header->producerWaiting) > 0)
+        {
+            KFutex::AddFetch(&m_header->spaceSignal, 1);
+            KFutex::Wake(&m_header->spaceSignal, INT_MAX, true);
+        }
+    }
+
+    const char* KShmRing::Peek(uint32_t& len, int ms)
+    {
+        if (m_header == NULL)
+            return NULL;
+
+        uint64_t start = 0;
+        for (int spins = 0;; ++spins)
+        {
+            RecordHeader* rec = NextRecord();
+            if (rec == NULL)
+            {
+                if (ms != 0 && spins < RingSpins)
+                {
+                    KFutex::Pause();
+                    continue;
+                }
+
+                int wait = RemainMs(ms, start);
+                if (wait == 0)
+                    return NULL;
+
+                int seq = KFutex::Load(&m_header->dataSignal);
+                KFutex::AddFetch(&m_header->consumerWaiting, 1);
+                rec = NextRecord();
+                if (rec == NULL)
+                    KFutex::Wait(&m_header->dataSignal, seq, wait, true);
+                KFutex::AddFetch(&m_header->consumerWaiting, -1);
+                if (rec == NULL)
+                    continue;
+            }
+
+            len = rec->length;
+            return reinterpret_cast<const char*>(rec + 1);
+        }
+    }
+
+    void KShmRing::Pop()
+    {
+        if (m_header == NULL)
+            return;
+        uint32_t pos = uint32_t(m_header->head);
+        RecordHeader* rec = RecordAt(pos);
+        // 没有Peek 到的记录时不移动队首 //
+        if (KFutex::Load(&rec->state) != RecordData)
+            return;
+        Advance(pos, Align(uint32_t(sizeof(RecordHeader)) + rec->length));
+    }
+
+    bool KShmRing::Read(std::string& data, int ms)
+    {
+        uint32_t len = 0;
+        const char* dat = Peek(len, ms);
+        if (dat == NULL)
+            return false;
+        data.assign(dat, len);
+        Pop();
+        return true;
+    }
+
+    size_t KShmRing::GetUsed() const
+    {
+        if (m_header == NULL)
+            return 0;
+        return size_t(uint32_t(m_header->tail) - uint32_t(m_header->head));
+    }
+};
@@ -0,0 +1,192 @@
+#ifndef _SHMRING_HPP_
+#define _SHMRING_HPP_
+
+#include <string>
+#include <stdint.h>
+#include "thread/KBuffer.h"
+#include "thread/KSharedMemory.h"
+/**
+共享内存环形队列，用于进程间传递变长消息，一个消费者，一个或多个生产者
+每条记录为8字节头加数据，按8字节对齐，放不下时在队尾填充后从头开始写
+生产者写完数据后置提交标志，消费者只看记录头，不读写入位置；消费完把记录清零后移动读取位置
+读写位置放在不同缓存行，等待用共享内存上的futex，只在对方挂起时才唤醒
+共享内存在进程退出后仍保留，消费者重启后从原读取位置继续
+**/
+namespace klib {
+    class KShmRing
+    {
+    public:
+        // 单生产者不需要竞争写入位置 //
+        enum Mode { SingleProducer, MultiProducer };
+
+        KShmRing();
+
+        ~KShmRing();
+
+        /************************************
+        * Method:    创建或打开队列，首个进程初始化，初始化过程中进程退出时由后来的进程重新初始化
+        * Returns:   成功返回true，已存在的队列容量或模式不一致返回false
+        * Parameter: key 共享内存名称
+        * Parameter: capacity 数据区大小，向上取2的幂，至少4096
+        * Parameter: mode 生产者模式
+        * Parameter: opts 共享内存选项，大容量队列可使用posix 后端和大页
+        *************************************/
+        bool Create(const std::string& key, size_t capacity, Mode mode = SingleProducer, const KShmOptions& opts = KShmOptions());
+
+        /************************************
+        * Method:    断开共享内存，不删除
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    断开并删除共享内存
+        * Returns:
+        *************************************/
+        void Destroy();
+
+        /************************************
+        * Method:    清空队列并重新初始化，用于生产者写入过程中退出导致队列卡住，调用时其他进程不能读写
+        * Returns:
+        *************************************/
+        void Reset();
+
+        /************************************
+        * Method:    写入一条记录
+        * Returns:   成功返回true，队列满且超时返回false
+        * Parameter: data 数据
+        * Parameter: len 长度，不能超过容量的一半减8
+        * Parameter: ms 队列满时等待的毫秒，0不等待，小于0一直等待
+        *************************************/
+        bool Write(const void* data, uint32_t len, int ms = 0);
+
+        inline bool Write(const KBuffer& buf, int ms = 0)
+        {
+            return Write(buf.GetData(), uint32_t(buf.GetSize()), ms);
+        }
+
+        /************************************
+        * Method:    获取队首记录，不拷贝，处理完后调用Pop，只能在消费者进程调用
+        * Returns:   返回数据指针，队列空且超时返回NULL
+        * Parameter: len 数据长度
+        * Parameter: ms 队列空时等待的毫秒，0不等待，小于0一直等待
+        *************************************/
+        const char* Peek(uint32_t& len, int ms = 0);
+
+        /************************************
+        * Method:    移除队首记录，未打开或队首没有数据时不做处理
+        * Returns:
+        *************************************/
+        void Pop();
+
+        /************************************
+        * Method:    读取一条记录
+        * Returns:   成功返回true，队列空且超时返回false
+        * Parameter: data 数据
+        * Parameter: ms 队列空时等待的毫秒
+        *************************************/
+        bool Read(std::string& data, int ms = 0);
+
+        /************************************
+        * Method:    已使用的字节数，包括记录头和填充
+        * Returns:
+        *************************************/
+        size_t GetUsed() const;
+
+        inline size_t GetCapacity() const { return m_capacity; }
+
+        /************************************
+        * Method:    单条记录的最大长度
+        * Returns:
+        *************************************/
+        inline size_t GetMaxRecord() const { return m_capacity / 2 - sizeof(RecordHeader); }
+
+    private:
+        KShmRing(const KShmRing&);
+        KShmRing& operator=(const KShmRing&);
+
+        // 队列头，每组字段独占一个缓存行 //
+        struct RingHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t capacity;
+            uint32_t mode;
+            // 0:未初始化 -1:就绪 其他:正在初始化的进程号 //
+            volatile int initState;
+            char padding0[44];
+            // 写入位置，生产者预留空间后前移 //
+            volatile int tail;
+            char padding1[60];
+            // 读取位置，只有消费者修改 //
+            volatile int head;
+            char padding2[60];
+            // 消费者等待数据 //
+            volatile int dataSignal;
+            volatile int consumerWaiting;
+            char padding3[56];
+            // 生产者等待空间 //
+            volatile int spaceSignal;
+            volatile int producerWaiting;
+            char padding4[56];
+        };
+
+        struct RecordHeader
+        {
+            // 0:未写完 1:数据 2:填充 //
+            volatile int state;
+            uint32_t length;
+        };
+
+        enum { RecordEmpty = 0, RecordData = 1, RecordPadding = 2 };
+
+        /************************************
+        * Method:    初始化队列头和数据区
+        * Returns:
+        *************************************/
+        void Initialize();
+
+        /************************************
+        * Method:    取队首记录，跳过填充
+        * Returns:   队列空返回NULL
+        *************************************/
+        RecordHeader* NextRecord();
+
+        /************************************
+        * Method:    清零已消费的记录并移动读取位置
+        * Returns:
+        * Parameter: pos 读取位置
+        * Parameter: size 记录大小
+        *************************************/
+        void Advance(uint32_t pos, uint32_t size);
+
+        /************************************
+        * Method:    预留空间
+        * Returns:   成功返回true
+        * Parameter: need 记录大小
+        * Parameter: pos 预留的位置
+        * Parameter: pad 预留前需要填充的大小
+        *************************************/
+        bool Reserve(uint32_t need, uint32_t& pos, uint32_t& pad);
+
+        inline RecordHeader* RecordAt(uint32_t pos) const
+        {
+            return reinterpret_cast<RecordHeader*>(m_data + (pos & (m_capacity - 1)));
+        }
+
+        static inline uint32_t Align(uint32_t len)
+        {
+            return (len + 7) & ~uint32_t(7);
+        }
+
+    private:
+        KSharedMemory m_shm;
+        RingHeader* m_header;
+        char* m_data;
+        uint32_t m_capacity;
+        Mode m_mode;
+        // 单生产者缓存的读取位置，减少读对方缓存行 //
+        uint32_t m_cachedHead;
+    };
+};
+#endif // !_SHMRING_HPP_
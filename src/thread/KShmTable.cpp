@@ -0,0 +1,262 @@
+#include "thread/KShmTable.h"
+#include "thread/KAdaptiveMutex.h"
+#include "thread/KConcurrentMap.h"
+#include "util/KTime.h"
+namespace klib {
+    static const uint32_t TableMagic = 0x4B54424C;
+    static const uint32_t TableVersion = 1;
+    static const uint32_t ValueErased = 0xFFFFFFFF;
+
+    /************************************
+    * Method:    自旋等待，较长时让出CPU
+    * Returns:
+    * Parameter: spins 已自旋次数
+    *************************************/
+    static inline void Backoff(int spins)
+    {
+        if (spins < 100)
+            KFutex::Pause();
+        else
+            KTime::MSleep(0);
+    }
+
+    KShmTable::KShmTable()
+        :m_header(NULL), m_data(NULL), m_slots(0), m_slotSize(0), m_valueSize(0)
+    {
+    }
+
+    KShmTable::~KShmTable()
+    {
+        Close();
+    }
+
+    bool KShmTable::Create(const std::string& key, size_t capacity, size_t valueSize, const KShmOptions& opts)
+    {
+        Close();
+        // 装载因子不超过0.5，探测长度较短 //
+        size_t slots = 64;
+        while (slots < capacity * 2)
+            slots <<= 1;
+        size_t slotSize = (sizeof(SlotHeader) + valueSize + 63) / 64 * 64;
+
+        if (!m_shm.Create(key, sizeof(TableHeader) + slots * slotSize, opts))
+            return false;
+
+        m_header = static_cast<TableHeader*>(m_shm.GetBuffer());
+        m_data = reinterpret_cast<char*>(m_header + 1);
+        m_slots = slots;
+        m_slotSize = slotSize;
+        m_valueSize = valueSize;
+
+        int rc = KSharedMemory::BeginInitialize(&m_header->initState);
+        if (rc < 0)
+        {
+            printf("Shm table [%s] corrupted\n", key.c_str());
+            Close();
+            return false;
+        }
+
+        if (rc > 0)
+        {
+            Initialize();
+            KSharedMemory::EndInitialize(&m_header->initState);
+            return true;
+        }
+
+        if (m_header->magic != TableMagic || m_header->version != TableVersion
+            || m_header->headerSize != sizeof(TableHeader) || m_header->slotSize != slotSize
+            || m_header->slots != slots || m_header->valueSize != valueSize)
+        {
+            printf("Shm table [%s] mismatch, slots:[%u] value size:[%u]\n", key.c_str(), m_header->slots, m_header->valueSize);
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void KShmTable::Close()
+    {
+        if (m_header == NULL)
+            return;
+        m_shm.Detach();
+        m_header = NULL;
+        m_data = NULL;
+    }
+
+    void KShmTable::Destroy()
+    {
+        if (m_header == NULL)
+            return;
+        m_shm.Detach();
+        m_shm.Release();
+        m_header = NULL;
+        m_data = NULL;
+    }
+
+    void KShmTable::Reset()
+    {
+        if (m_header == NULL)
+            return;
+        Initialize();
+        KSharedMemory::EndInitialize(&m_header->initState);
+    }
+
+    void KShmTable::Initialize()
+    {
+        m_header->magic = TableMagic;
+        m_header->version = TableVersion;
+        m_header->headerSize = uint32_t(sizeof(TableHeader));
+        m_header->slotSize = uint32_t(m_slotSize);
+        m_header->slots = uint32_t(m_slots);
+        m_header->valueSize = uint32_t(m_valueSize);
+        m_header->count = 0;
+        memset(m_data, 0, m_slots * m_slotSize);
+    }
+
+    KShmTable::SlotHeader* KShmTable::FindSlot(uint64_t key, bool insert) const
+    {
+        size_t mask = m_slots - 1;
+        size_t index = KHash<uint64_t>()(key) & mask;
+        for (size_t probes = 0; probes < m_slots; ++probes, index = (index + 1) & mask)
+        {
+            SlotHeader* slot = SlotAt(index);
+            for (int spins = 0;; ++spins)
+            {
+                int state = KFutex::Load(&slot->state);
+                if (state == SlotUsed)
+                {
+                    if (slot->key == key)
+                        return slot;
+                    break;
+                }
+
+                if (state == SlotEmpty)
+                {
+                    if (!insert)
+                        return NULL;
+                    if (KFutex::CompareExchange(&slot->state, SlotEmpty, SlotClaiming) != SlotEmpty)
+                        continue;
+                    slot->key = key;
+                    slot->length = ValueErased;
+                    KFutex::Exchange(&slot->state, SlotUsed);
+                    KFutex::AddFetch(&m_header->count, 1);
+                    return slot;
+                }
+
+                // 其他写者正在占用，读者跳过，写者等待，避免同一个键占用两个槽位 //
+                if (!insert)
+                    break;
+                Backoff(spins);
+            }
+        }
+        return NULL;
+    }
+
+    void KShmTable::WriteSlot(SlotHeader* slot, const void* value, uint32_t len)
+    {
+        // 序号从偶数改为奇数即获得槽位的写锁 //
+        for (int spins = 0;; ++spins)
+        {
+            int seq = KFutex::Load(&slot->sequence);
+            if ((seq & 1) == 0 && KFutex::CompareExchange(&slot->sequence, seq, seq + 1) == seq)
+                break;
+            Backoff(spins);
+        }
+
+        if (value != NULL)
+        {
+            memcpy(slot + 1, value, len);
+            slot->length = len;
+        }
+        else
+            slot->length = ValueErased;
+
+        AtomicFence(MoRelease);
+        KFutex::AddFetch(&slot->sequence, 1);
+    }
+
+    bool KShmTable::Put(uint64_t key, const void* value, uint32_t len)
+    {
+        if (m_header == NULL || len > m_valueSize)
+            return false;
+
+        SlotHeader* slot = FindSlot(key, true);
+        if (slot == NULL)
+            return false;
+        WriteSlot(slot, value, len);
+        return true;
+    }
+
+    bool KShmTable::Get(uint64_t key, void* value, uint32_t& len, uint32_t* version) const
+    {
+        return Get(key, value, m_valueSize, len, version);
+    }
+
+    bool KShmTable::Get(uint64_t key, void* value, size_t size, uint32_t& len, uint32_t* version) const
+    {
+        if (m_header == NULL)
+            return false;
+
+        SlotHeader* slot = FindSlot(key, false);
+        if (slot == NULL)
+            return false;
+
+        for (int spins = 0;; ++spins)
+        {
+            int seq = slot->sequence;
+            AtomicFence(MoAcquire);
+            if (seq & 1)
+            {
+                Backoff(spins);
+                continue;
+            }
+
+            uint32_t length = slot->length;
+            if (length != ValueErased && length <= m_valueSize)
+                memcpy(value, slot + 1, length < size ? length : size);
+
+            // 保证数据的读在序号的读之前完成 //
+            AtomicFence(MoAcquire);
+            if (slot->sequence != seq)
+                continue;
+
+            if (length == ValueErased)
+                return false;
+            len = length;
+            if (version != NULL)
+                *version = uint32_t(seq) >> 1;
+            return true;
+        }
+    }
+
+    bool KShmTable::Erase(uint64_t key)
+    {
+        if (m_header == NULL)
+            return false;
+
+        SlotHeader* slot = FindSlot(key, false);
+        if (slot == NULL)
+            return false;
+        WriteSlot(slot, NULL, 0);
+        return true;
+    }
+
+    void KShmTable::GetKeys(std::vector<uint64_t>& keys) const
+    {
+        keys.clear();
+        if (m_header == NULL)
+            return;
+
+        for (size_t i = 0; i < m_slots; ++i)
+        {
+            SlotHeader* slot = SlotAt(i);
+            if (KFutex::Load(&slot->state) == SlotUsed)
+                keys.push_back(slot->key);
+        }
+    }
+
+    size_t KShmTable::Size() const
+    {
+        return m_header == NULL ? 0 : size_t(KFutex::Load(&m_header->count));
+    }
+};
@@ -0,0 +1,189 @@
+#ifndef _SHMTABLE_HPP_
+#define _SHMTABLE_HPP_
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+#include "thread/KSharedMemory.h"
+/**
+共享内存键值快照表，保存每个标签的最新值，一个进程写，多个进程读
+开放寻址(线性探测)，容量固定，键只插入不删除，Erase 只清除值
+每个槽位一个顺序锁，读者不加锁，拷贝后检查序号，期间有写入则重读；多个写者按槽位互斥
+值只能是可以按字节拷贝的数据，最大长度在创建时确定
+**/
+namespace klib {
+    class KShmTable
+    {
+    public:
+        KShmTable();
+
+        ~KShmTable();
+
+        /************************************
+        * Method:    创建或打开表，首个进程初始化
+        * Returns:   成功返回true，已存在的表布局不一致返回false
+        * Parameter: key 共享内存名称
+        * Parameter: capacity 最多键个数，槽位数取2倍后向上取2的幂
+        * Parameter: valueSize 值的最大长度
+        * Parameter: opts 共享内存选项
+        *************************************/
+        bool Create(const std::string& key, size_t capacity, size_t valueSize, const KShmOptions& opts = KShmOptions());
+
+        /************************************
+        * Method:    断开共享内存，不删除
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    断开并删除共享内存
+        * Returns:
+        *************************************/
+        void Destroy();
+
+        /************************************
+        * Method:    清空表，用于写者在写入过程中退出导致槽位卡住，调用时其他进程不能读写
+        * Returns:
+        *************************************/
+        void Reset();
+
+        /************************************
+        * Method:    写入最新值
+        * Returns:   成功返回true，表满或值超长返回false
+        * Parameter: key 键
+        * Parameter: value 值
+        * Parameter: len 长度
+        *************************************/
+        bool Put(uint64_t key, const void* value, uint32_t len);
+
+        template<typename ValueType>
+        inline bool Put(uint64_t key, const ValueType& value)
+        {
+            return Put(key, &value, uint32_t(sizeof(ValueType)));
+        }
+
+        /************************************
+        * Method:    读取最新值
+        * Returns:   键不存在或值已清除返回false
+        * Parameter: key 键
+        * Parameter: value 值，至少能放下创建时的最大长度
+        * Parameter: len 值的长度
+        * Parameter: version 值的版本，每次写入加1，可用于判断是否有更新
+        *************************************/
+        bool Get(uint64_t key, void* value, uint32_t& len, uint32_t* version = NULL) const;
+
+        template<typename ValueType>
+        inline bool Get(uint64_t key, ValueType& value) const
+        {
+            uint32_t len = 0;
+            return Get(key, &value, sizeof(ValueType), len, NULL) && len == sizeof(ValueType);
+        }
+
+        /************************************
+        * Method:    清除值，键仍占用槽位
+        * Returns:   键不存在返回false
+        * Parameter: key 键
+        *************************************/
+        bool Erase(uint64_t key);
+
+        /************************************
+        * Method:    获取所有键
+        * Returns:
+        * Parameter: keys 键
+        *************************************/
+        void GetKeys(std::vector<uint64_t>& keys) const;
+
+        /************************************
+        * Method:    键的个数
+        * Returns:
+        *************************************/
+        size_t Size() const;
+
+        inline size_t GetSlots() const { return m_slots; }
+
+        inline size_t GetValueSize() const { return m_valueSize; }
+
+    private:
+        KShmTable(const KShmTable&);
+        KShmTable& operator=(const KShmTable&);
+
+        /************************************
+        * Method:    读取最新值，最多拷贝size 字节
+        * Returns:   键不存在或值已清除返回false
+        * Parameter: key 键
+        * Parameter: value 值
+        * Parameter: size value 的大小
+        * Parameter: len 值的实际长度，可能大于size
+        * Parameter: version 值的版本
+        *************************************/
+        bool Get(uint64_t key, void* value, size_t size, uint32_t& len, uint32_t* version) const;
+
+        // 布局头，不同版本或参数的表不能互相打开 //
+        struct TableHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t headerSize;
+            uint32_t slotSize;
+            uint32_t slots;
+            uint32_t valueSize;
+            // 0:未初始化 -1:就绪 其他:正在初始化的进程号 //
+            volatile int initState;
+            volatile int count;
+            char padding[32];
+        };
+
+        // 槽位头，后面紧跟值，按缓存行对齐 //
+        struct SlotHeader
+        {
+            // 0:空 1:正在占用 2:已占用 //
+            volatile int state;
+            // 顺序锁序号，奇数表示正在写 //
+            volatile int sequence;
+            uint64_t key;
+            // 值长度，0xFFFFFFFF 表示已清除 //
+            uint32_t length;
+            uint32_t reserved;
+        };
+
+        enum { SlotEmpty = 0, SlotClaiming = 1, SlotUsed = 2 };
+
+        /************************************
+        * Method:    初始化布局头和槽位
+        * Returns:
+        *************************************/
+        void Initialize();
+
+        /************************************
+        * Method:    查找键所在的槽位
+        * Returns:   没有返回NULL
+        * Parameter: key 键
+        * Parameter: insert 不存在时占用空槽位
+        *************************************/
+        SlotHeader* FindSlot(uint64_t key, bool insert) const;
+
+        /************************************
+        * Method:    写入槽位的值
+        * Returns:
+        * Parameter: slot 槽位
+        * Parameter: value 值，NULL 表示清除
+        * Parameter: len 长度
+        *************************************/
+        void WriteSlot(SlotHeader* slot, const void* value, uint32_t len);
+
+        inline SlotHeader* SlotAt(size_t index) const
+        {
+            return reinterpret_cast<SlotHeader*>(m_data + index * m_slotSize);
+        }
+
+    private:
+        KSharedMemory m_shm;
+        TableHeader* m_header;
+        char* m_data;
+        size_t m_slots;
+        size_t m_slotSize;
+        size_t m_valueSize;
+    };
+};
+#endif // !_SHMTABLE_HPP_
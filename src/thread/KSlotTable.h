@@ -0,0 +1,223 @@
+#ifndef _SLOTTABLE_HPP_
+#define _SLOTTABLE_HPP_
+#if defined(WIN32)
+#include <windows.h>
+#endif
+#include <cstring>
+#include <stdint.h>
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KAtomic.h"
+/**
+按下标索引的指针表，读不加锁，写加锁
+每个槽位带有代数，槽位每次被修改代数加1，用于识别下标(如socket)被复用
+内存按页分配，页分配后直到析构才释放，所以读者不会访问到已释放的页
+**/
+namespace klib {
+#define SlotBarrier() AtomicFence(MoSeqCst)
+
+    template<typename ValueType>
+    class KSlotTable
+    {
+        struct Slot
+        {
+            // 偶数表示稳定，奇数表示正在写 //
+            volatile uint32_t sequence;
+            ValueType* volatile value;
+        };
+
+    public:
+        // 每页1024个槽位，最多1024页 //
+        enum { PageBits = 10, PageSize = 1 << PageBits, MaxPage = 1024 };
+
+        KSlotTable()
+            :m_size(0)
+        {
+            memset((void*)m_pages, 0, sizeof(m_pages));
+        }
+
+        ~KSlotTable()
+        {
+            for (size_t i = 0; i < MaxPage; ++i)
+                delete[] m_pages[i];
+        }
+
+        /************************************
+        * Method:    下标是否在表的范围内
+        * Returns:   
+        * Parameter: index 下标
+        *************************************/
+        inline bool IsValidIndex(size_t index) const
+        {
+            return index < size_t(PageSize) * MaxPage;
+        }
+
+        /************************************
+        * Method:    设置槽位
+        * Returns:   下标超出范围返回false
+        * Parameter: index 下标
+        * Parameter: v 指针，NULL表示清空
+        *************************************/
+        bool Set(size_t index, ValueType* v)
+        {
+            if (!IsValidIndex(index))
+                return false;
+
+            KLockGuard<KMutex> lock(m_slotMtx);
+            Slot* s = GetSlot(index, true);
+            if (s == NULL)
+                return false;
+            Write(s, v);
+            return true;
+        }
+
+        /************************************
+        * Method:    槽位是期望值时清空
+        * Returns:   清空返回true，槽位已经被修改返回false
+        * Parameter: index 下标
+        * Parameter: expected 期望值
+        *************************************/
+        bool Remove(size_t index, ValueType* expected)
+        {
+            if (!IsValidIndex(index))
+                return false;
+
+            KLockGuard<KMutex> lock(m_slotMtx);
+            Slot* s = GetSlot(index, false);
+            if (s == NULL || s->value != expected)
+                return false;
+            Write(s, NULL);
+            return true;
+        }
+
+        /************************************
+        * Method:    读取槽位，不加锁
+        * Returns:   返回指针，空槽位返回NULL
+        * Parameter: index 下标
+        *************************************/
+        inline ValueType* Get(size_t index) const
+        {
+            uint32_t generation = 0;
+            return Get(index, generation);
+        }
+
+        /************************************
+        * Method:    读取槽位和代数，不加锁
+        * Returns:   返回指针，空槽位返回NULL
+        * Parameter: index 下标
+        * Parameter: generation 槽位代数
+        *************************************/
+        ValueType* Get(size_t index, uint32_t& generation) const
+        {
+            generation = 0;
+            if (!IsValidIndex(index))
+                return NULL;
+
+            const Slot* s = GetSlot(index);
+            if (s == NULL)
+                return NULL;
+
+            while (true)
+            {
+                uint32_t seq = s->sequence;
+                SlotBarrier();
+                ValueType* v = s->value;
+                SlotBarrier();
+                if ((seq & 1) == 0 && seq == s->sequence)
+                {
+                    generation = (seq >> 1);
+                    return v;
+                }
+            }
+        }
+
+        /************************************
+        * Method:    获取所有非空槽位
+        * Returns:   
+        * Parameter: vals 指针集合
+        *************************************/
+        template<typename ContainerType>
+        void GetAll(ContainerType& vals) const
+        {
+            for (size_t i = 0; i < MaxPage; ++i)
+            {
+                Slot* page = m_pages[i];
+                if (page == NULL)
+                    continue;
+                for (size_t j = 0; j < PageSize; ++j)
+                {
+                    ValueType* v = page[j].value;
+                    if (v != NULL)
+                        vals.insert(vals.end(), v);
+                }
+            }
+        }
+
+        /************************************
+        * Method:    非空槽位个数
+        * Returns:   
+        *************************************/
+        inline size_t Size() const
+        {
+            return m_size;
+        }
+
+    private:
+        /************************************
+        * Method:    写槽位，调用者持有写锁
+        * Returns:   
+        * Parameter: s 槽位
+        * Parameter: v 指针
+        *************************************/
+        void Write(Slot* s, ValueType* v)
+        {
+            if (s->value == NULL && v != NULL)
+                ++m_size;
+            else if (s->value != NULL && v == NULL)
+                --m_size;
+
+            s->sequence = s->sequence + 1;
+            SlotBarrier();
+            s->value = v;
+            SlotBarrier();
+            s->sequence = s->sequence + 1;
+        }
+
+        /************************************
+        * Method:    获取槽位，页不存在时按需分配，调用者持有写锁
+        * Returns:   
+        * Parameter: index 下标
+        * Parameter: create 是否分配页
+        *************************************/
+        Slot* GetSlot(size_t index, bool create)
+        {
+            size_t pi = (index >> PageBits);
+            Slot* page = m_pages[pi];
+            if (page == NULL)
+            {
+                if (!create)
+                    return NULL;
+                page = new Slot[PageSize];
+                memset((void*)page, 0, sizeof(Slot) * PageSize);
+                SlotBarrier();
+                m_pages[pi] = page;
+            }
+            return &page[index & (PageSize - 1)];
+        }
+
+        inline const Slot* GetSlot(size_t index) const
+        {
+            const Slot* page = m_pages[index >> PageBits];
+            SlotBarrier();
+            if (page == NULL)
+                return NULL;
+            return &page[index & (PageSize - 1)];
+        }
+
+    private:
+        Slot* volatile m_pages[MaxPage];
+        volatile size_t m_size;
+        KMutex m_slotMtx;
+    };
+};
+#endif // !_SLOTTABLE_HPP_
@@ -0,0 +1,417 @@
+#include "thread/KThreadPool.h"
+#include <stdexcept>
+#include "util/KTime.h"
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+namespace klib {
+    KTask::KTask()
+        :m_refs(0), m_done(false), m_pool(NULL)
+    {
+
+    }
+
+    KTask::~KTask()
+    {
+
+    }
+
+    bool KTask::IsDone() const
+    {
+        KLockGuard<KMutex> lock(m_doneMtx);
+        return m_done;
+    }
+
+    void KTask::Wait() const
+    {
+        if (m_pool != NULL && m_pool->CurrentWorker() != NULL)
+        {
+            m_pool->HelpUntil(this);
+            return;
+        }
+
+        KLockGuard<KMutex> lock(m_doneMtx);
+        while (!m_done)
+            m_doneCond.Wait(lock);
+    }
+
+    bool KTask::Wait(size_t ms) const
+    {
+        // 在工作线程内等待自己队列中的任务时必须帮助执行，否则一定超时 //
+        if (m_pool != NULL && m_pool->CurrentWorker() != NULL)
+            return m_pool->HelpUntil(this, ms);
+
+        uint64_t now = 0;
+        KTime::MonotonicNanosecond(now);
+        uint64_t deadline = now + uint64_t(ms) * 1000000;
+        KLockGuard<KMutex> lock(m_doneMtx);
+        while (!m_done && now < deadline)
+        {
+            m_doneCond.TimedWait(lock, size_t((deadline - now + 999999) / 1000000));
+            KTime::MonotonicNanosecond(now);
+        }
+        return m_done;
+    }
+
+    const std::string& KTask::GetError() const
+    {
+        return m_error;
+    }
+
+    void KTask::AddRef()
+    {
+        ++m_refs;
+    }
+
+    void KTask::Release()
+    {
+        if (--m_refs == 0)
+            delete this;
+    }
+
+    void KTask::Execute()
+    {
+        try
+        {
+            Run();
+        }
+        catch (const std::exception& e)
+        {
+            m_error = e.what();
+        }
+        catch (...)
+        {
+            m_error = "unknown exception";
+        }
+
+        KLockGuard<KMutex> lock(m_doneMtx);
+        m_done = true;
+        m_doneCond.NotifyAll();
+    }
+
+    KTaskHandle::KTaskHandle()
+        :m_task(NULL)
+    {
+
+    }
+
+    KTaskHandle::KTaskHandle(KTask* task)
+        :m_task(task)
+    {
+        if (m_task != NULL)
+            m_task->AddRef();
+    }
+
+    KTaskHandle::KTaskHandle(const KTaskHandle& rh)
+        :m_task(rh.m_task)
+    {
+        if (m_task != NULL)
+            m_task->AddRef();
+    }
+
+    KTaskHandle& KTaskHandle::operator=(const KTaskHandle& rh)
+    {
+        if (rh.m_task != NULL)
+            rh.m_task->AddRef();
+        if (m_task != NULL)
+            m_task->Release();
+        m_task = rh.m_task;
+        return *this;
+    }
+
+    KTaskHandle::~KTaskHandle()
+    {
+        if (m_task != NULL)
+            m_task->Release();
+    }
+
+    bool KTaskHandle::IsDone() const
+    {
+        return m_task == NULL || m_task->IsDone();
+    }
+
+    void KTaskHandle::Wait() const
+    {
+        if (m_task != NULL)
+            m_task->Wait();
+    }
+
+    bool KTaskHandle::Wait(size_t ms) const
+    {
+        return m_task == NULL || m_task->Wait(ms);
+    }
+
+    const std::string& KTaskHandle::GetError() const
+    {
+        static const std::string empty;
+        return m_task == NULL ? empty : m_task->GetError();
+    }
+
+    KThreadPool::KThreadPool(const std::string& name)
+        :m_name(name), m_pending(0), m_idle(0), m_next(0), m_running(false), m_stopping(false), m_exiting(false), m_submitting(0)
+    {
+        int rc = pthread_key_create(&m_key, NULL);
+        if (rc != 0)
+            throw KException(__FILE__, __LINE__, KError::StdErrorStr(rc).c_str());
+    }
+
+    KThreadPool::~KThreadPool()
+    {
+        Stop();
+        pthread_key_delete(m_key);
+    }
+
+    bool KThreadPool::Start(size_t threads, const KThreadOptions& opts)
+    {
+        KLockGuard<KMutex> lock(m_stateMtx);
+        if (m_running)
+            return false;
+
+        if (threads == 0)
+            threads = GetCpuCount();
+
+        m_stopping = false;
+        m_exiting = false;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            Worker* w = new Worker;
+            w->index = i;
+            w->started = false;
+            w->thread = new KPthread(m_name);
+            m_workers.push_back(w);
+        }
+
+        // 队列全部创建后再启动线程，窃取时不会访问到未创建的队列 //
+        m_running = true;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            KThreadOptions wopts = opts;
+            if (!opts.cpus.empty())
+            {
+                wopts.cpus.clear();
+                wopts.cpus.push_back(opts.cpus[i % opts.cpus.size()]);
+            }
+            if (m_workers[i]->thread->Run(this, &KThreadPool::WorkerLoop, m_workers[i],
+                (void (KThreadPool::*)(const std::string&))NULL, (int*)NULL, wopts) != KPthread::Success)
+            {
+                lock.Release();
+                Stop();
+                return false;
+            }
+            m_workers[i]->started = true;
+        }
+        return true;
+    }
+
+    void KThreadPool::Stop()
+    {
+        KLockGuard<KMutex> lock(m_stateMtx);
+        if (!m_running)
+            return;
+
+        // 先拒绝新的提交，等正在入队的提交完成后再通知工作线程退出，不会有任务在最后一次检查后入队 //
+        m_stopping = true;
+        while (m_submitting > 0)
+            KTime::MSleep(1);
+
+        {
+            KLockGuard<KMutex> wlock(m_waitMtx);
+            m_exiting = true;
+            m_waitCond.NotifyAll();
+        }
+
+        std::vector<Worker*>::iterator it = m_workers.begin();
+        for (; it != m_workers.end(); ++it)
+        {
+            if ((*it)->started)
+                (*it)->thread->Join();
+        }
+
+        // 工作线程已全部退出，不会再有任务入队 //
+        m_running = false;
+        for (it = m_workers.begin(); it != m_workers.end(); ++it)
+        {
+            delete (*it)->thread;
+            delete *it;
+        }
+        m_workers.clear();
+    }
+
+    KTaskHandle KThreadPool::Submit(KTask* task, TaskPriority pri)
+    {
+        KTaskHandle h(task);
+        Push(task, pri);
+        return h;
+    }
+
+    size_t KThreadPool::GetCpuCount()
+    {
+#if defined(WIN32)
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwNumberOfProcessors > 0 ? size_t(si.dwNumberOfProcessors) : 1;
+#else
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? size_t(n) : 1;
+#endif
+    }
+
+    void KThreadPool::Push(KTask* task, TaskPriority pri)
+    {
+        task->AddRef();
+        // 与Stop 中的m_stopping、m_submitting 构成全屏障的握手，Stop 看到计数为0 后不会再有任务入队 //
+        ++m_submitting;
+        if (m_stopping || !m_running || m_workers.empty())
+        {
+            --m_submitting;
+            task->Execute();
+            task->Release();
+            return;
+        }
+
+        task->m_pool = this;
+        Worker* w = CurrentWorker();
+        if (w == NULL)
+            w = m_workers[m_next++ % m_workers.size()];
+        {
+            KLockGuard<KMutex> lock(w->mtx);
+            w->tasks[pri].push_back(task);
+        }
+
+        // 计数和空闲线程数都是全屏障操作，不会同时错过对方的修改 //
+        ++m_pending;
+        if (m_idle > 0)
+        {
+            KLockGuard<KMutex> lock(m_waitMtx);
+            m_waitCond.Notify();
+        }
+        --m_submitting;
+    }
+
+    KTask* KThreadPool::Take(Worker* self)
+    {
+        if (m_pending <= 0)
+            return NULL;
+
+        size_t n = m_workers.size();
+        size_t start = (self != NULL ? self->index : m_next % n);
+        for (int pri = TpHigh; pri < TpCount; ++pri)
+        {
+            if (self != NULL)
+            {
+                KLockGuard<KMutex> lock(self->mtx);
+                std::deque<KTask*>& q = self->tasks[pri];
+                if (!q.empty())
+                {
+                    KTask* task = q.back();
+                    q.pop_back();
+                    --m_pending;
+                    return task;
+                }
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                Worker* victim = m_workers[(start + i) % n];
+                if (victim == self)
+                    continue;
+
+                KLockGuard<KMutex> lock(victim->mtx);
+                std::deque<KTask*>& q = victim->tasks[pri];
+                if (!q.empty())
+                {
+                    KTask* task = q.front();
+                    q.pop_front();
+                    --m_pending;
+                    return task;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    bool KThreadPool::HelpUntil(const KTask* task, size_t ms)
+    {
+        Worker* self = CurrentWorker();
+        uint64_t deadline = 0;
+        if (ms != InfiniteWait)
+        {
+            KTime::MonotonicNanosecond(deadline);
+            deadline += uint64_t(ms) * 1000000;
+        }
+
+        while (true)
+        {
+            {
+                KLockGuard<KMutex> lock(task->m_doneMtx);
+                if (task->m_done)
+                    return true;
+            }
+
+            if (ms != InfiniteWait)
+            {
+                uint64_t now = 0;
+                KTime::MonotonicNanosecond(now);
+                if (now >= deadline)
+                    return false;
+            }
+
+            KTask* t = Take(self);
+            if (t != NULL)
+            {
+                t->Execute();
+                t->Release();
+                continue;
+            }
+
+            // 等待的任务在其他线程执行，期间可能有新任务入队，定时醒来检查 //
+            KLockGuard<KMutex> lock(task->m_doneMtx);
+            if (!task->m_done)
+                task->m_doneCond.TimedWait(lock, 1);
+        }
+    }
+
+    void KThreadPool::WaitAll(const std::vector<KTaskHandle>& handles)
+    {
+        std::vector<KTaskHandle>::const_iterator it = handles.begin();
+        for (; it != handles.end(); ++it)
+            it->Wait();
+    }
+
+    KThreadPool::Worker* KThreadPool::CurrentWorker() const
+    {
+        return static_cast<Worker*>(pthread_getspecific(m_key));
+    }
+
+    int KThreadPool::WorkerLoop(Worker* w)
+    {
+        pthread_setspecific(m_key, w);
+        while (true)
+        {
+            KTask* task = Take(w);
+            if (task != NULL)
+            {
+                task->Execute();
+                task->Release();
+                continue;
+            }
+
+            KLockGuard<KMutex> lock(m_waitMtx);
+            ++m_idle;
+            if (m_pending <= 0)
+            {
+                if (m_exiting)
+                {
+                    --m_idle;
+                    break;
+                }
+                m_waitCond.Wait(lock);
+            }
+            --m_idle;
+        }
+        pthread_setspecific(m_key, NULL);
+        return 0;
+    }
+};
@@ -0,0 +1,472 @@
+#ifndef _THREADPOOL_HPP_
+#define _THREADPOOL_HPP_
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+#include <pthread.h>
+#include "thread/KPthread.h"
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+#include "thread/KCondVariable.h"
+#include "thread/KAtomic.h"
+#include "thread/KException.h"
+/**
+线程池，每个工作线程有自己的任务队列，空闲时从其他线程的队列窃取任务
+任务分高、中、低三个优先级，先执行高优先级的任务
+**/
+namespace klib {
+    class KThreadPool;
+
+    /**
+    任务基类，引用计数，由线程池和任务句柄共同持有，计数为0时删除
+    **/
+    class KTask
+    {
+    public:
+        KTask();
+
+        virtual ~KTask();
+
+        /************************************
+        * Method:    执行任务
+        * Returns:   
+        *************************************/
+        virtual void Run() = 0;
+
+        /************************************
+        * Method:    是否执行完成
+        * Returns:   
+        *************************************/
+        bool IsDone() const;
+
+        /************************************
+        * Method:    等待完成，在线程池内等待时帮助执行其他任务
+        * Returns:   
+        *************************************/
+        void Wait() const;
+
+        /************************************
+        * Method:    等待完成ms毫秒，在线程池内等待时帮助执行其他任务
+        * Returns:   完成返回true超时返回false
+        * Parameter: ms 毫秒数
+        *************************************/
+        bool Wait(size_t ms) const;
+
+        /************************************
+        * Method:    获取执行时抛出的异常信息
+        * Returns:   没有异常返回空字符串
+        *************************************/
+        const std::string& GetError() const;
+
+        void AddRef();
+
+        void Release();
+
+    private:
+        KTask(const KTask&);
+        KTask& operator=(const KTask&);
+
+        /************************************
+        * Method:    执行任务并通知等待者
+        * Returns:   
+        *************************************/
+        void Execute();
+
+    private:
+        AtomicInteger<int32_t> m_refs;
+        KMutex m_doneMtx;
+        KCondVariable m_doneCond;
+        volatile bool m_done;
+        std::string m_error;
+        KThreadPool* m_pool;
+        friend class KThreadPool;
+    };
+
+    /**
+    任务句柄
+    **/
+    class KTaskHandle
+    {
+    public:
+        KTaskHandle();
+
+        explicit KTaskHandle(KTask* task);
+
+        KTaskHandle(const KTaskHandle& rh);
+
+        KTaskHandle& operator=(const KTaskHandle& rh);
+
+        virtual ~KTaskHandle();
+
+        inline bool IsValid() const { return m_task != NULL; }
+
+        bool IsDone() const;
+
+        void Wait() const;
+
+        bool Wait(size_t ms) const;
+
+        const std::string& GetError() const;
+
+    protected:
+        KTask* m_task;
+    };
+
+    /**
+    带返回值的任务
+    **/
+    template<typename RetType>
+    class KResultTask :public KTask
+    {
+    public:
+        KResultTask() :m_result() {}
+
+        inline const RetType& GetResult() const { return m_result; }
+
+    protected:
+        RetType m_result;
+    };
+
+    /**
+    获取任务返回值的句柄
+    **/
+    template<typename RetType>
+    class KFuture :public KTaskHandle
+    {
+    public:
+        KFuture() {}
+
+        explicit KFuture(KResultTask<RetType>* task) :KTaskHandle(task) {}
+
+        /************************************
+        * Method:    等待完成并获取返回值，任务抛出异常时抛出KException
+        * Returns:   
+        *************************************/
+        RetType Get() const
+        {
+            if (m_task == NULL)
+                throw KException(__FILE__, __LINE__, "invalid task");
+            m_task->Wait();
+            if (!m_task->GetError().empty())
+                throw KException(__FILE__, __LINE__, m_task->GetError().c_str());
+            return static_cast<KResultTask<RetType>*>(m_task)->GetResult();
+        }
+    };
+
+    template<>
+    class KFuture<void> :public KTaskHandle
+    {
+    public:
+        KFuture() {}
+
+        explicit KFuture(KTask* task) :KTaskHandle(task) {}
+
+        void Get() const
+        {
+            if (m_task == NULL)
+                throw KException(__FILE__, __LINE__, "invalid task");
+            m_task->Wait();
+            if (!m_task->GetError().empty())
+                throw KException(__FILE__, __LINE__, m_task->GetError().c_str());
+        }
+    };
+
+    /**
+    执行成员函数的任务
+    **/
+    template<typename ObjectType, typename RetType, typename ArgType>
+    class KMemberTask :public KResultTask<RetType>
+    {
+    public:
+        typedef RetType(ObjectType::* RunFunc)(ArgType);
+        KMemberTask(ObjectType* obj, RunFunc rf, ArgType arg) :m_obj(obj), m_rf(rf), m_arg(arg) {}
+
+        virtual void Run() { this->m_result = (m_obj->*m_rf)(m_arg); }
+
+    private:
+        ObjectType* m_obj;
+        RunFunc m_rf;
+        ArgType m_arg;
+    };
+
+    template<typename ObjectType, typename ArgType>
+    class KMemberTask<ObjectType, void, ArgType> :public KTask
+    {
+    public:
+        typedef void(ObjectType::* RunFunc)(ArgType);
+        KMemberTask(ObjectType* obj, RunFunc rf, ArgType arg) :m_obj(obj), m_rf(rf), m_arg(arg) {}
+
+        virtual void Run() { (m_obj->*m_rf)(m_arg); }
+
+    private:
+        ObjectType* m_obj;
+        RunFunc m_rf;
+        ArgType m_arg;
+    };
+
+    /**
+    执行全局函数或静态函数的任务
+    **/
+    template<typename RetType, typename ArgType>
+    class KFunctionTask :public KResultTask<RetType>
+    {
+    public:
+        typedef RetType(*RunFunc)(ArgType);
+        KFunctionTask(RunFunc rf, ArgType arg) :m_rf(rf), m_arg(arg) {}
+
+        virtual void Run() { this->m_result = (*m_rf)(m_arg); }
+
+    private:
+        RunFunc m_rf;
+        ArgType m_arg;
+    };
+
+    template<typename ArgType>
+    class KFunctionTask<void, ArgType> :public KTask
+    {
+    public:
+        typedef void(*RunFunc)(ArgType);
+        KFunctionTask(RunFunc rf, ArgType arg) :m_rf(rf), m_arg(arg) {}
+
+        virtual void Run() { (*m_rf)(m_arg); }
+
+    private:
+        RunFunc m_rf;
+        ArgType m_arg;
+    };
+
+    /**
+    处理[begin, end)区间的任务，函数对象由调用者持有
+    **/
+    template<typename FuncType>
+    class KRangeTask :public KTask
+    {
+    public:
+        KRangeTask(FuncType* func, size_t begin, size_t end) :m_func(func), m_begin(begin), m_end(end) {}
+
+        virtual void Run() { (*m_func)(m_begin, m_end); }
+
+    private:
+        FuncType* m_func;
+        size_t m_begin;
+        size_t m_end;
+    };
+
+    class KThreadPool
+    {
+    public:
+        enum TaskPriority { TpHigh, TpNormal, TpLow, TpCount };
+
+        static const size_t InfiniteWait = size_t(-1);
+
+        KThreadPool(const std::string& name = "Thread pool");
+
+        ~KThreadPool();
+
+        /************************************
+        * Method:    启动
+        * Returns:   成功返回true失败返回false
+        * Parameter: threads 线程个数，0表示CPU 个数
+        * Parameter: opts 工作线程选项，指定了CPU 时第i个线程绑定到cpus[i%cpus.size()]
+        *************************************/
+        bool Start(size_t threads = 0, const KThreadOptions& opts = KThreadOptions());
+
+        /************************************
+        * Method:    停止，等待已提交的任务执行完成
+        * Returns:   
+        *************************************/
+        void Stop();
+
+        inline bool IsRunning() const { return m_running; }
+
+        inline size_t GetThreadCount() const { return m_workers.size(); }
+
+        /************************************
+        * Method:    未执行的任务个数
+        * Returns:   
+        *************************************/
+        inline size_t GetPendingCount() const
+        {
+            int32_t n = m_pending;
+            return n > 0 ? size_t(n) : 0;
+        }
+
+        /************************************
+        * Method:    提交任务，任务由线程池接管，未启动时在调用线程直接执行
+        * Returns:   返回任务句柄
+        * Parameter: task 任务
+        * Parameter: pri 优先级
+        *************************************/
+        KTaskHandle Submit(KTask* task, TaskPriority pri = TpNormal);
+
+        /************************************
+        * Method:    提交成员函数
+        * Returns:   返回获取结果的句柄
+        * Parameter: obj 对象指针
+        * Parameter: rf 函数指针
+        * Parameter: arg 函数参数
+        * Parameter: pri 优先级
+        *************************************/
+        template<typename ObjectType, typename RetType, typename ArgType>
+        KFuture<RetType> Submit(ObjectType* obj, RetType(ObjectType::* rf)(ArgType), ArgType arg, TaskPriority pri = TpNormal)
+        {
+            KMemberTask<ObjectType, RetType, ArgType>* task = new KMemberTask<ObjectType, RetType, ArgType>(obj, rf, arg);
+            KFuture<RetType> f(task);
+            Push(task, pri);
+            return f;
+        }
+
+        /************************************
+        * Method:    提交全局函数或静态函数
+        * Returns:   返回获取结果的句柄
+        * Parameter: rf 函数指针
+        * Parameter: arg 函数参数
+        * Parameter: pri 优先级
+        *************************************/
+        template<typename RetType, typename ArgType>
+        KFuture<RetType> Submit(RetType(*rf)(ArgType), ArgType arg, TaskPriority pri = TpNormal)
+        {
+            KFunctionTask<RetType, ArgType>* task = new KFunctionTask<RetType, ArgType>(rf, arg);
+            KFuture<RetType> f(task);
+            Push(task, pri);
+            return f;
+        }
+
+        /************************************
+        * Method:    把[begin, end)分块并行执行func(b, e)，调用线程也参与执行，全部完成后返回
+        * Returns:   调用线程的分块抛出异常时原样抛出，否则第一个失败的分块的错误以KException 抛出，都在所有分块结束后抛出
+        * Parameter: begin 起始下标
+        * Parameter: end 结束下标
+        * Parameter: func 函数或函数对象，参数为分块的起止下标
+        * Parameter: grain 每块大小，0表示按线程个数自动划分
+        * Parameter: pri 优先级
+        *************************************/
+        template<typename FuncType>
+        void ParallelFor(size_t begin, size_t end, FuncType func, size_t grain = 0, TaskPriority pri = TpNormal)
+        {
+            if (begin >= end)
+                return;
+
+            if (grain == 0)
+            {
+                // 每个线程约4块，便于负载均衡 //
+                size_t chunks = (m_workers.empty() ? 1 : m_workers.size() * 4);
+                grain = (end - begin + chunks - 1) / chunks;
+            }
+
+            // 预留空间，任务入队后push_back 不会抛出，已入队的任务都有句柄可以等待 //
+            size_t first = (end - begin > grain ? begin + grain : end);
+            std::vector<KTaskHandle> handles;
+            handles.reserve((end - first + grain - 1) / grain);
+            try
+            {
+                for (size_t b = first; b < end; b += grain)
+                {
+                    size_t e = (end - b > grain ? b + grain : end);
+                    handles.push_back(Submit(new KRangeTask<FuncType>(&func, b, e), pri));
+                }
+                func(begin, first);
+            }
+            catch (...)
+            {
+                // 任务持有func 的指针，全部结束后才能离开 //
+                WaitAll(handles);
+                throw;
+            }
+
+            WaitAll(handles);
+            std::vector<KTaskHandle>::const_iterator it = handles.begin();
+            for (; it != handles.end(); ++it)
+            {
+                if (!it->GetError().empty())
+                    throw KException(__FILE__, __LINE__, it->GetError().c_str());
+            }
+        }
+
+        /************************************
+        * Method:    CPU 个数
+        * Returns:   
+        *************************************/
+        static size_t GetCpuCount();
+
+    private:
+        KThreadPool(const KThreadPool&);
+        KThreadPool& operator=(const KThreadPool&);
+
+        struct Worker
+        {
+            size_t index;
+            bool started;
+            KPthread* thread;
+            KMutex mtx;
+            std::deque<KTask*> tasks[TpCount];
+        };
+
+        /************************************
+        * Method:    任务入队，在工作线程内提交时放入自己的队列，否则轮流放入各线程的队列
+        * Returns:   
+        * Parameter: task 任务
+        * Parameter: pri 优先级
+        *************************************/
+        void Push(KTask* task, TaskPriority pri);
+
+        /************************************
+        * Method:    按优先级取任务，先取自己队列尾部，再从其他线程队列头部窃取
+        * Returns:   没有任务返回NULL
+        * Parameter: self 当前工作线程，非工作线程为NULL
+        *************************************/
+        KTask* Take(Worker* self);
+
+        /************************************
+        * Method:    执行任务直到task完成或超时，正在执行的其他任务结束后才检查超时
+        * Returns:   完成返回true超时返回false
+        * Parameter: task 等待的任务
+        * Parameter: ms 毫秒数，InfiniteWait 表示一直等待
+        *************************************/
+        bool HelpUntil(const KTask* task, size_t ms = InfiniteWait);
+
+        /************************************
+        * Method:    等待全部任务完成，不抛出异常
+        * Returns:   
+        * Parameter: handles 任务句柄
+        *************************************/
+        static void WaitAll(const std::vector<KTaskHandle>& handles);
+
+        /************************************
+        * Method:    当前线程对应的工作线程
+        * Returns:   不是本线程池的线程返回NULL
+        *************************************/
+        Worker* CurrentWorker() const;
+
+        /************************************
+        * Method:    工作线程函数
+        * Returns:   
+        * Parameter: w 工作线程
+        *************************************/
+        int WorkerLoop(Worker* w);
+
+    private:
+        std::string m_name;
+        std::vector<Worker*> m_workers;
+        pthread_key_t m_key;
+        // 未执行的任务个数 //
+        AtomicInteger<int32_t> m_pending;
+        // 等待任务的线程个数 //
+        AtomicInteger<int32_t> m_idle;
+        // 非工作线程提交任务时轮流选择的队列 //
+        AtomicInteger<uint32_t> m_next;
+        KMutex m_waitMtx;
+        KCondVariable m_waitCond;
+        KMutex m_stateMtx;
+        AtomicBool m_running;
+        // 停止后新提交的任务在调用线程执行 //
+        AtomicBool m_stopping;
+        // 提交到队列后才能让工作线程退出 //
+        AtomicBool m_exiting;
+        // 正在入队的提交者个数 //
+        AtomicInteger<int32_t> m_submitting;
+        friend class KTask;
+    };
+};
+#endif // !_THREADPOOL_HPP_
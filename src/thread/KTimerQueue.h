@@ -0,0 +1,80 @@
+#ifndef _TIMERQUEUE_HPP_
+#define _TIMERQUEUE_HPP_
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include "thread/KMutex.h"
+#include "thread/KLockGuard.h"
+/**
+定时器队列，按到期时间排序
+**/
+namespace klib {
+    template<typename ValueType>
+    class KTimerQueue
+    {
+        typedef std::multimap<uint64_t, ValueType> TimerMap;
+    public:
+        /************************************
+        * Method:    添加定时器
+        * Returns:   
+        * Parameter: expire 到期时间
+        * Parameter: v 定时器数据
+        *************************************/
+        inline void Add(uint64_t expire, const ValueType& v)
+        {
+            KLockGuard<KMutex> lock(m_timerMtx);
+            m_timers.insert(typename TimerMap::value_type(expire, v));
+        }
+
+        /************************************
+        * Method:    取出所有已到期的定时器
+        * Returns:   有到期的定时器返回true否则返回false
+        * Parameter: now 当前时间
+        * Parameter: vals 到期的定时器数据
+        *************************************/
+        bool GetExpired(uint64_t now, std::vector<ValueType>& vals)
+        {
+            KLockGuard<KMutex> lock(m_timerMtx);
+            typename TimerMap::iterator end = m_timers.upper_bound(now);
+            typename TimerMap::iterator it = m_timers.begin();
+            while (it != end)
+            {
+                vals.push_back(it->second);
+                ++it;
+            }
+            m_timers.erase(m_timers.begin(), end);
+            return !vals.empty();
+        }
+
+        /************************************
+        * Method:    获取最近的到期时间
+        * Returns:   有定时器返回true否则返回false
+        * Parameter: expire 到期时间
+        *************************************/
+        inline bool NextExpire(uint64_t& expire) const
+        {
+            KLockGuard<KMutex> lock(m_timerMtx);
+            if (m_timers.empty())
+                return false;
+            expire = m_timers.begin()->first;
+            return true;
+        }
+
+        inline size_t Size() const
+        {
+            KLockGuard<KMutex> lock(m_timerMtx);
+            return m_timers.size();
+        }
+
+        inline void Clear()
+        {
+            KLockGuard<KMutex> lock(m_timerMtx);
+            m_timers.clear();
+        }
+
+    private:
+        TimerMap m_timers;
+        KMutex m_timerMtx;
+    };
+};
+#endif // !_TIMERQUEUE_HPP_
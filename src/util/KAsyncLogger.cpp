@@ -0,0 +1,618 @@
+#include "util/KAsyncLogger.h"
+#include "thread/KAdaptiveMutex.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <cstddef>
+namespace klib {
+    enum
+    {
+        // 格式说明符的长度修饰 //
+        LenNone, LenChar, LenShort, LenLong, LenLongLong, LenMax, LenSize, LenPtrdiff, LenLongDouble
+    };
+
+    struct FormatSpec
+    {
+        const char* begin;
+        // 长度修饰开始的位置 //
+        const char* lengthPos;
+        bool starWidth;
+        bool starPrecision;
+        int length;
+        char conv;
+    };
+
+    /************************************
+    * Method:    解析格式说明符
+    * Returns:   返回说明符之后的位置
+    * Parameter: p 指向%
+    * Parameter: spec 说明符
+    *************************************/
+    static const char* ParseSpec(const char* p, FormatSpec& spec)
+    {
+        spec.begin = p++;
+        spec.starWidth = false;
+        spec.starPrecision = false;
+        while (*p != 0 && strchr("-+ #0'", *p) != NULL)
+            ++p;
+        if (*p == '*')
+        {
+            spec.starWidth = true;
+            ++p;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9')
+                ++p;
+        }
+        if (*p == '.')
+        {
+            ++p;
+            if (*p == '*')
+            {
+                spec.starPrecision = true;
+                ++p;
+            }
+            else
+            {
+                while (*p >= '0' && *p <= '9')
+                    ++p;
+            }
+        }
+
+        spec.lengthPos = p;
+        spec.length = LenNone;
+        switch (*p)
+        {
+        case 'h':
+            spec.length = (p[1] == 'h' ? LenChar : LenShort);
+            p += (p[1] == 'h' ? 2 : 1);
+            break;
+        case 'l':
+            spec.length = (p[1] == 'l' ? LenLongLong : LenLong);
+            p += (p[1] == 'l' ? 2 : 1);
+            break;
+        case 'q': spec.length = LenLongLong; ++p; break;
+        case 'j': spec.length = LenMax; ++p; break;
+        case 'z': spec.length = LenSize; ++p; break;
+        case 't': spec.length = LenPtrdiff; ++p; break;
+        case 'L': spec.length = LenLongDouble; ++p; break;
+        default: break;
+        }
+
+        spec.conv = *p;
+        if (*p != 0)
+            ++p;
+        return p;
+    }
+
+    // 追加一个值，按8字节对齐 //
+    static inline void PutValue(std::vector<char>& buf, const void* v, size_t n)
+    {
+        size_t pos = buf.size();
+        buf.resize(pos + ((n + 7) & ~size_t(7)));
+        memcpy(&buf[pos], v, n);
+    }
+
+    template<typename ValueType>
+    static inline ValueType GetValue(const char*& cur)
+    {
+        ValueType v;
+        memcpy(&v, cur, sizeof(ValueType));
+        cur += (sizeof(ValueType) + 7) & ~size_t(7);
+        return v;
+    }
+
+    /************************************
+    * Method:    按格式串把参数编码到缓存，%s 拷贝字符串内容
+    * Returns:
+    * Parameter: format 格式串
+    * Parameter: args 参数
+    * Parameter: buf 缓存
+    *************************************/
+    static void EncodeArgs(const char* format, va_list args, std::vector<char>& buf)
+    {
+        const char* p = format;
+        while (*p != 0)
+        {
+            if (*p != '%')
+            {
+                ++p;
+                continue;
+            }
+            if (p[1] == '%')
+            {
+                p += 2;
+                continue;
+            }
+
+            FormatSpec spec;
+            p = ParseSpec(p, spec);
+            if (spec.starWidth)
+            {
+                int64_t v = va_arg(args, int);
+                PutValue(buf, &v, sizeof(v));
+            }
+            if (spec.starPrecision)
+            {
+                int64_t v = va_arg(args, int);
+                PutValue(buf, &v, sizeof(v));
+            }
+
+            switch (spec.conv)
+            {
+            case 'd': case 'i':
+            {
+                int64_t v = 0;
+                switch (spec.length)
+                {
+                case LenChar: v = (signed char)va_arg(args, int); break;
+                case LenShort: v = (short)va_arg(args, int); break;
+                case LenLong: v = va_arg(args, long); break;
+                case LenLongLong: v = va_arg(args, long long); break;
+                case LenMax: v = va_arg(args, intmax_t); break;
+                case LenSize: v = (int64_t)va_arg(args, size_t); break;
+                case LenPtrdiff: v = va_arg(args, ptrdiff_t); break;
+                default: v = va_arg(args, int); break;
+                }
+                PutValue(buf, &v, sizeof(v));
+                break;
+            }
+            case 'u': case 'o': case 'x': case 'X':
+            {
+                uint64_t v = 0;
+                switch (spec.length)
+                {
+                case LenChar: v = (unsigned char)va_arg(args, unsigned int); break;
+                case LenShort: v = (unsigned short)va_arg(args, unsigned int); break;
+                case LenLong: v = va_arg(args, unsigned long); break;
+                case LenLongLong: v = va_arg(args, unsigned long long); break;
+                case LenMax: v = va_arg(args, uintmax_t); break;
+                case LenSize: v = va_arg(args, size_t); break;
+                case LenPtrdiff: v = (uint64_t)va_arg(args, ptrdiff_t); break;
+                default: v = va_arg(args, unsigned int); break;
+                }
+                PutValue(buf, &v, sizeof(v));
+                break;
+            }
+            case 'c':
+            {
+                int64_t v = va_arg(args, int);
+                PutValue(buf, &v, sizeof(v));
+                break;
+            }
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            {
+                if (spec.length == LenLongDouble)
+                {
+                    long double v = va_arg(args, long double);
+                    PutValue(buf, &v, sizeof(v));
+                }
+                else
+                {
+                    double v = va_arg(args, double);
+                    PutValue(buf, &v, sizeof(v));
+                }
+                break;
+            }
+            case 's':
+            {
+                const char* s = va_arg(args, const char*);
+                if (s == NULL)
+                    s = "(null)";
+                uint32_t len = uint32_t(strlen(s));
+                size_t pos = buf.size();
+                buf.resize(pos + ((sizeof(len) + len + 1 + 7) & ~size_t(7)));
+                memcpy(&buf[pos], &len, sizeof(len));
+                memcpy(&buf[pos + sizeof(len)], s, len + 1);
+                break;
+            }
+            case 'p':
+            {
+                uint64_t v = uint64_t(size_t(va_arg(args, void*)));
+                PutValue(buf, &v, sizeof(v));
+                break;
+            }
+            case 'n':
+                va_arg(args, int*);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // 格式化单个值，结果超过栈缓存时重新分配 //
+#define AppendFormatted(out, fmt, value) \
+    {\
+        char tmp[256];\
+        int rsz = snprintf(tmp, sizeof(tmp), fmt, value);\
+        if (rsz >= int(sizeof(tmp)))\
+        {\
+            std::vector<char> big(rsz + 1);\
+            snprintf(&big[0], big.size(), fmt, value);\
+            out.append(&big[0], rsz);\
+        }\
+        else if (rsz > 0)\
+        {\
+            out.append(tmp, rsz);\
+        }\
+    }
+
+    KAsyncLogger::ThreadBuffer::ThreadBuffer(uint32_t cap)
+        :data(new char[cap]), capacity(cap), tail(0), head(0), closed(false)
+    {
+    }
+
+    KAsyncLogger::ThreadBuffer::~ThreadBuffer()
+    {
+        delete[] data;
+    }
+
+    KAsyncLogger::KAsyncLogger(size_t maxsize, uint16_t duration, size_t bufferSize)
+        :KEventObject<int>("KAsyncLogger Thread"), m_file(maxsize, duration), m_timestamp(true),
+        m_blockWhenFull(false), m_flushInterval(5), m_bufferSize(4096), m_keyCreated(false),
+        m_dropped(0), m_wakeup(0), m_sleeping(false), m_rounds(0), m_flushRequested(false), m_timeFormat("yyyy-mm-dd hh:nn:ss.ccc ")
+    {
+        while (m_bufferSize < bufferSize && m_bufferSize < 0x40000000)
+            m_bufferSize <<= 1;
+        m_keyCreated = (pthread_key_create(&m_key, &KAsyncLogger::ReleaseBuffer) == 0);
+    }
+
+    KAsyncLogger::~KAsyncLogger()
+    {
+        Close();
+        if (m_keyCreated)
+            pthread_key_delete(m_key);
+        for (size_t i = 0; i < m_buffers.size(); ++i)
+            delete m_buffers[i];
+        m_buffers.clear();
+    }
+
+    bool KAsyncLogger::Initialize(const std::string& path, const std::string& filename, bool timestamp)
+    {
+        if (!m_keyCreated)
+            return false;
+
+        m_timestamp = timestamp;
+        m_file.Initialize(path, filename, false);
+        if (!KEventObject<int>::Start())
+            return false;
+        PostForce(0);
+        return true;
+    }
+
+    void KAsyncLogger::Close()
+    {
+        if (!IsRunning())
+            return;
+
+        KEventObject<int>::Stop();
+        Notify();
+        KEventObject<int>::WaitForStop();
+        // 后台线程已退出，在当前线程写完剩余的日志 //
+        Drain();
+        m_file.Close();
+    }
+
+    bool KAsyncLogger::WriteString(const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        bool rc = WriteStringV(format, args);
+        va_end(args);
+        return rc;
+    }
+
+    bool KAsyncLogger::WriteStringV(const char* format, va_list args)
+    {
+        if (format == NULL || *format == 0 || !IsRunning())
+            return false;
+
+        ThreadBuffer* tb = GetBuffer();
+        if (tb == NULL)
+            return false;
+
+        uint64_t now = 0;
+        KTime::NowMicrosecond(now);
+        tb->scratch.resize(sizeof(RecordHeader));
+        EncodeArgs(format, args, tb->scratch);
+
+        RecordHeader* rec = reinterpret_cast<RecordHeader*>(&tb->scratch[0]);
+        rec->type = RecordFormat;
+        rec->reserved = 0;
+        rec->timestamp = now;
+        rec->format = uint64_t(size_t(format));
+        return Commit(tb, uint32_t(tb->scratch.size()));
+    }
+
+    bool KAsyncLogger::WriteHexString(const char* dat, size_t sz)
+    {
+        if (dat == NULL || sz == 0 || !IsRunning())
+            return false;
+
+        ThreadBuffer* tb = GetBuffer();
+        if (tb == NULL || sz > tb->capacity / 2)
+        {
+            ++m_dropped;
+            return false;
+        }
+
+        uint64_t now = 0;
+        KTime::NowMicrosecond(now);
+        tb->scratch.resize(sizeof(RecordHeader) + ((sz + 7) & ~size_t(7)));
+        memcpy(&tb->scratch[sizeof(RecordHeader)], dat, sz);
+
+        RecordHeader* rec = reinterpret_cast<RecordHeader*>(&tb->scratch[0]);
+        rec->type = RecordHex;
+        rec->reserved = 0;
+        rec->timestamp = now;
+        rec->format = sz;
+        return Commit(tb, uint32_t(tb->scratch.size()));
+    }
+
+    void KAsyncLogger::Flush()
+    {
+        // 等待两轮，保证有一轮是在调用之后开始的 //
+        m_flushRequested.Store(true);
+        uint64_t target = m_rounds.Load() + 2;
+        Notify();
+        while (IsRunning() && m_rounds.Load() < target)
+            KTime::MSleep(1);
+    }
+
+    void KAsyncLogger::ProcessEvent(const int& /*ev*/)
+    {
+        // 先取标志再读缓存，标志之前写入的日志都会在本轮写出 //
+        bool flush = m_flushRequested.Exchange(false);
+        size_t count = Drain();
+        // 空闲时把文件缓存写出，繁忙时由KTextFileBatch 按大小和间隔批量写入 //
+        if (count == 0 || flush)
+            m_file.Flush();
+
+        if (count == 0)
+        {
+            int seq = KFutex::Load(&m_wakeup);
+            m_sleeping.Store(true);
+            KFutex::Wait(&m_wakeup, seq, m_flushInterval);
+            m_sleeping.Store(false, MoRelaxed);
+        }
+        ++m_rounds;
+        PostForce(0);
+    }
+
+    KAsyncLogger::ThreadBuffer* KAsyncLogger::GetBuffer()
+    {
+        ThreadBuffer* tb = static_cast<ThreadBuffer*>(pthread_getspecific(m_key));
+        if (tb != NULL)
+            return tb;
+
+        tb = new ThreadBuffer(m_bufferSize);
+        {
+            KLockGuard<KMutex> lock(m_bufferMtx);
+            m_buffers.push_back(tb);
+        }
+        pthread_setspecific(m_key, tb);
+        return tb;
+    }
+
+    void KAsyncLogger::ReleaseBuffer(void* ptr)
+    {
+        static_cast<ThreadBuffer*>(ptr)->closed.Store(true, MoRelease);
+    }
+
+    void KAsyncLogger::Notify()
+    {
+        KFutex::AddFetch(&m_wakeup, 1);
+        KFutex::Wake(&m_wakeup, 1);
+    }
+
+    bool KAsyncLogger::Commit(ThreadBuffer* tb, uint32_t size)
+    {
+        uint32_t cap = tb->capacity;
+        if (size > cap / 2)
+        {
+            ++m_dropped;
+            return false;
+        }
+        reinterpret_cast<RecordHeader*>(&tb->scratch[0])->size = size;
+
+        // 到缓存尾放不下时填充，从头开始写 //
+        uint32_t tail = tb->tail.Load(MoRelaxed);
+        uint32_t rem = cap - (tail & (cap - 1));
+        uint32_t pad = (rem < size ? rem : 0);
+        for (int spins = 0; tail + pad + size - tb->head.Load(MoAcquire) > cap; ++spins)
+        {
+            if (!m_blockWhenFull || !IsRunning())
+            {
+                ++m_dropped;
+                return false;
+            }
+            Notify();
+            KTime::MSleep(spins < 10 ? 0 : 1);
+        }
+
+        if (pad > 0)
+        {
+            RecordHeader* padding = reinterpret_cast<RecordHeader*>(tb->data + (tail & (cap - 1)));
+            padding->size = pad;
+            padding->type = RecordPadding;
+            tail += pad;
+        }
+        memcpy(tb->data + (tail & (cap - 1)), &tb->scratch[0], size);
+        tb->tail.Store(tail + size, MoRelease);
+
+        // 缓存过半时唤醒后台线程，否则等它定时醒来 //
+        if (m_sleeping.Load(MoRelaxed) && tail + size - tb->head.Load(MoRelaxed) > cap / 2)
+            Notify();
+        return true;
+    }
+
+    size_t KAsyncLogger::Drain()
+    {
+        std::vector<ThreadBuffer*> buffers;
+        {
+            KLockGuard<KMutex> lock(m_bufferMtx);
+            buffers = m_buffers;
+        }
+
+        m_batch.clear();
+        m_lines.clear();
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            ThreadBuffer* tb = buffers[i];
+            // 先读关闭标志，保证读到线程退出前的所有记录 //
+            bool closed = tb->closed.Load(MoAcquire);
+            uint32_t head = tb->head.Load(MoRelaxed);
+            uint32_t tail = tb->tail.Load(MoAcquire);
+            while (head != tail)
+            {
+                const RecordHeader* rec = reinterpret_cast<const RecordHeader*>(tb->data + (head & (tb->capacity - 1)));
+                if (rec->type != RecordPadding)
+                {
+                    Line line;
+                    line.timestamp = rec->timestamp;
+                    line.offset = m_batch.size();
+                    if (m_timestamp)
+                        FormatTimestamp(rec->timestamp, m_batch);
+                    FormatRecord(rec, m_batch);
+                    line.length = m_batch.size() - line.offset;
+                    m_lines.push_back(line);
+                }
+                head += rec->size;
+            }
+            tb->head.Store(head, MoRelease);
+
+            if (closed)
+            {
+                KLockGuard<KMutex> lock(m_bufferMtx);
+                m_buffers.erase(std::find(m_buffers.begin(), m_buffers.end(), tb));
+                delete tb;
+            }
+        }
+
+        if (m_lines.empty())
+            return 0;
+
+        // 多个线程的日志按时间合并 //
+        if (buffers.size() > 1)
+        {
+            std::stable_sort(m_lines.begin(), m_lines.end());
+            m_line.clear();
+            m_line.reserve(m_batch.size());
+            for (size_t i = 0; i < m_lines.size(); ++i)
+                m_line.append(m_batch, m_lines[i].offset, m_lines[i].length);
+            m_batch.swap(m_line);
+        }
+
+        m_file.Append(m_batch.data(), m_batch.size());
+        return m_lines.size();
+    }
+
+    void KAsyncLogger::FormatRecord(const RecordHeader* rec, std::string& out)
+    {
+        const char* cur = reinterpret_cast<const char*>(rec + 1);
+        if (rec->type == RecordHex)
+        {
+            char dst[HexBufferSize];
+            std::string hex;
+            KTextFile::ToHexString(cur, size_t(rec->format), dst, hex);
+            out.append(hex);
+            return;
+        }
+
+        const char* p = reinterpret_cast<const char*>(size_t(rec->format));
+        while (*p != 0)
+        {
+            const char* literal = p;
+            while (*p != 0 && *p != '%')
+                ++p;
+            out.append(literal, p - literal);
+            if (*p == 0)
+                break;
+            if (p[1] == '%')
+            {
+                out.push_back('%');
+                p += 2;
+                continue;
+            }
+
+            FormatSpec spec;
+            p = ParseSpec(p, spec);
+
+            // 重建单个说明符，*替换为记录的数值，长度修饰统一为编码时的类型 //
+            char sub[96];
+            size_t pos = 0;
+            for (const char* s = spec.begin; s < spec.lengthPos && pos < 40; ++s)
+            {
+                if (*s == '*')
+                    pos += snprintf(sub + pos, sizeof(sub) - pos, "%d", int(GetValue<int64_t>(cur)));
+                else
+                    sub[pos++] = *s;
+            }
+
+            switch (spec.conv)
+            {
+            case 'd': case 'i':
+                strcpy(sub + pos, spec.conv == 'd' ? "lld" : "lli");
+                AppendFormatted(out, sub, (long long)GetValue<int64_t>(cur));
+                break;
+            case 'u': case 'o': case 'x': case 'X':
+                sub[pos++] = 'l';
+                sub[pos++] = 'l';
+                sub[pos++] = spec.conv;
+                sub[pos] = 0;
+                AppendFormatted(out, sub, (unsigned long long)GetValue<uint64_t>(cur));
+                break;
+            case 'c':
+                strcpy(sub + pos, "c");
+                AppendFormatted(out, sub, int(GetValue<int64_t>(cur)));
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                if (spec.length == LenLongDouble)
+                {
+                    sub[pos++] = 'L';
+                    sub[pos++] = spec.conv;
+                    sub[pos] = 0;
+                    AppendFormatted(out, sub, GetValue<long double>(cur));
+                }
+                else
+                {
+                    sub[pos++] = spec.conv;
+                    sub[pos] = 0;
+                    AppendFormatted(out, sub, GetValue<double>(cur));
+                }
+                break;
+            case 's':
+            {
+                uint32_t len = 0;
+                memcpy(&len, cur, sizeof(len));
+                const char* s = cur + sizeof(len);
+                cur += (sizeof(len) + len + 1 + 7) & ~size_t(7);
+                strcpy(sub + pos, "s");
+                AppendFormatted(out, sub, s);
+                break;
+            }
+            case 'p':
+                strcpy(sub + pos, "p");
+                AppendFormatted(out, sub, (void*)size_t(GetValue<uint64_t>(cur)));
+                break;
+            case 'n':
+                break;
+            default:
+                // 不认识的说明符原样输出 //
+                out.append(spec.begin, p - spec.begin);
+                break;
+            }
+        }
+    }
+
+    void KAsyncLogger::FormatTimestamp(uint64_t timestamp, std::string& out)
+    {
+        DateTime dt;
+        KTime::ToDateTime(timestamp, dt);
+        char buf[32];
+        size_t len = m_timeFormat.Format(dt, buf);
+        out.append(buf, len);
+    }
+};
@@ -0,0 +1,242 @@
+#ifndef _ASYNCLOGGER_HPP_
+#define _ASYNCLOGGER_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <cstdarg>
+#include <pthread.h>
+#include "thread/KAtomic.h"
+#include "thread/KMutex.h"
+#include "thread/KEventObject.h"
+#include "util/KTextFile.hpp"
+/**
+异步日志，写日志的线程只把格式串指针和参数按二进制写入本线程的环形缓存(不加锁、不格式化、不分配内存)，
+后台线程按时间顺序格式化后追加到KTextFileBatch，空闲或Flush 时写入文件，时间戳、备份规则与KTextFile 相同
+格式串必须是常量或生命周期长于日志对象的字符串，%s 参数会被拷贝
+**/
+namespace klib {
+    class KAsyncLogger :public KEventObject<int>
+    {
+    public:
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: maxsize 单个文件最大MB
+        * Parameter: duration 备份间隔分钟
+        * Parameter: bufferSize 每个线程的缓存字节数，向上取2的幂
+        *************************************/
+        KAsyncLogger(size_t maxsize = 50, uint16_t duration = 5, size_t bufferSize = 1024 * 1024);
+
+        ~KAsyncLogger();
+
+        /************************************
+        * Method:    初始化并启动后台线程
+        * Returns:   成功返回true
+        * Parameter: path 路径
+        * Parameter: filename 文件名
+        * Parameter: timestamp 是否记录时间
+        *************************************/
+        bool Initialize(const std::string& path, const std::string& filename, bool timestamp = true);
+
+        /************************************
+        * Method:    写完缓存中的日志后关闭
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    写日志
+        * Returns:   缓存满被丢弃或未运行返回false
+        * Parameter: format 格式串，不会被拷贝
+        *************************************/
+        bool WriteString(const char* format, ...);
+
+        /************************************
+        * Method:    写日志
+        * Returns:   缓存满被丢弃或未运行返回false
+        * Parameter: format 格式串，不会被拷贝
+        * Parameter: args 参数
+        *************************************/
+        bool WriteStringV(const char* format, va_list args);
+
+        /************************************
+        * Method:    按16进制写数据，在后台线程转换
+        * Returns:   缓存满被丢弃或未运行返回false
+        * Parameter: dat 数据
+        * Parameter: sz 长度
+        *************************************/
+        bool WriteHexString(const char* dat, size_t sz);
+
+        /************************************
+        * Method:    缓存满时等待而不是丢弃
+        * Returns:
+        * Parameter: block 是否等待
+        *************************************/
+        inline void SetBlockWhenFull(bool block) { m_blockWhenFull = block; }
+
+        /************************************
+        * Method:    设置后台线程空闲时的等待毫秒
+        * Returns:
+        * Parameter: ms 毫秒
+        *************************************/
+        inline void SetFlushInterval(int ms) { m_flushInterval = (ms > 0 ? ms : 1); }
+
+        /************************************
+        * Method:    设置文件的落盘方式，在Initialize 之前调用
+        * Returns:
+        * Parameter: mode 落盘方式
+        * Parameter: ms FsPeriodic 的落盘间隔毫秒
+        *************************************/
+        inline void SetSyncMode(FileSyncMode mode, int ms = 1000) { m_file.SetSyncMode(mode, ms); }
+
+        /************************************
+        * Method:    设置备份线程，在Initialize 之前调用
+        * Returns:
+        * Parameter: rotator 备份线程
+        *************************************/
+        inline void SetRotator(KLogRotator* rotator) { m_file.SetRotator(rotator); }
+
+        /************************************
+        * Method:    因缓存满丢弃的条数
+        * Returns:
+        *************************************/
+        inline uint64_t GetDropped() const { return m_dropped.Load(MoRelaxed); }
+
+        /************************************
+        * Method:    等待调用前写入的日志全部写到文件
+        * Returns:
+        *************************************/
+        void Flush();
+
+        inline std::string GetFilePath() const { return m_file.GetFilePath(); }
+
+    protected:
+        virtual void ProcessEvent(const int& ev);
+
+    private:
+        /**
+        线程缓存，单生产者单消费者
+        **/
+        struct ThreadBuffer
+        {
+            ThreadBuffer(uint32_t cap);
+            ~ThreadBuffer();
+
+            char* data;
+            uint32_t capacity;
+            char padding0[64];
+            // 写入位置，只有所属线程修改 //
+            AtomicInteger<uint32_t> tail;
+            char padding1[64];
+            // 读取位置，只有后台线程修改 //
+            AtomicInteger<uint32_t> head;
+            char padding2[64];
+            // 所属线程已退出，读完后释放 //
+            AtomicBool closed;
+            // 编码参数的临时缓存 //
+            std::vector<char> scratch;
+        };
+
+        // 记录头，按8字节对齐，后面是编码后的参数或数据 //
+        struct RecordHeader
+        {
+            uint32_t size;
+            uint16_t type;
+            uint16_t reserved;
+            uint64_t timestamp;
+            uint64_t format;
+        };
+
+        enum { RecordPadding = 0, RecordFormat = 1, RecordHex = 2 };
+
+        // 一批中的一行，按时间排序 //
+        struct Line
+        {
+            uint64_t timestamp;
+            size_t offset;
+            size_t length;
+            bool operator<(const Line& other) const { return timestamp < other.timestamp; }
+        };
+
+        KAsyncLogger(const KAsyncLogger&);
+        KAsyncLogger& operator=(const KAsyncLogger&);
+
+        /************************************
+        * Method:    获取当前线程的缓存，首次调用时创建
+        * Returns:
+        *************************************/
+        ThreadBuffer* GetBuffer();
+
+        /************************************
+        * Method:    线程退出时标记缓存
+        * Returns:
+        *************************************/
+        static void ReleaseBuffer(void* ptr);
+
+        /************************************
+        * Method:    唤醒后台线程
+        * Returns:
+        *************************************/
+        void Notify();
+
+        /************************************
+        * Method:    把临时缓存中的记录写入线程缓存
+        * Returns:   成功返回true
+        * Parameter: tb 线程缓存
+        * Parameter: size 记录大小
+        *************************************/
+        bool Commit(ThreadBuffer* tb, uint32_t size);
+
+        /************************************
+        * Method:    取出所有线程缓存的记录并写入文件
+        * Returns:   返回写入的条数
+        *************************************/
+        size_t Drain();
+
+        /************************************
+        * Method:    格式化一条记录
+        * Returns:
+        * Parameter: rec 记录
+        * Parameter: out 输出
+        *************************************/
+        void FormatRecord(const RecordHeader* rec, std::string& out);
+
+        /************************************
+        * Method:    格式化时间戳
+        * Returns:
+        * Parameter: timestamp 微秒
+        * Parameter: out 输出
+        *************************************/
+        void FormatTimestamp(uint64_t timestamp, std::string& out);
+
+    private:
+        KTextFileBatch m_file;
+        bool m_timestamp;
+        bool m_blockWhenFull;
+        int m_flushInterval;
+        uint32_t m_bufferSize;
+        pthread_key_t m_key;
+        bool m_keyCreated;
+
+        // 所有线程缓存，注册和释放时加锁 //
+        KMutex m_bufferMtx;
+        std::vector<ThreadBuffer*> m_buffers;
+
+        AtomicInteger<uint64_t> m_dropped;
+        // 后台线程空闲等待，缓存过半时唤醒 //
+        volatile int m_wakeup;
+        AtomicBool m_sleeping;
+        // Flush 等待的轮次 //
+        AtomicInteger<uint64_t> m_rounds;
+        // 下一轮把文件缓存写出 //
+        AtomicBool m_flushRequested;
+
+        // 后台线程使用 //
+        std::string m_batch;
+        std::vector<Line> m_lines;
+        std::string m_line;
+        KDateTimeFormat m_timeFormat;
+    };
+};
+#endif // !_ASYNCLOGGER_HPP_
@@ -0,0 +1,220 @@
+#include "util/KBinaryLog.h"
+#include <cstring>
+#include <ctime>
+#include "util/KEndian.h"
+#include "util/KTime.h"
+namespace klib {
+    KBinaryLog::KBinaryLog(size_t maxsize, uint16_t duration, size_t bufferSize)
+        :m_file(maxsize, duration, bufferSize)
+    {
+        m_record.reserve(256);
+    }
+
+    KBinaryLog::~KBinaryLog()
+    {
+        Close();
+    }
+
+    void KBinaryLog::Initialize(const std::string& path, const std::string& filename)
+    {
+        m_file.Initialize(path, filename, false);
+    }
+
+    void KBinaryLog::Close()
+    {
+        m_file.Close();
+    }
+
+    void KBinaryLog::EncodeHeader(uint8_t level, uint8_t kind, uint16_t source, uint32_t sz)
+    {
+        uint64_t now = 0;
+        KTime::NowMicrosecond(now);
+        uint8_t* p = reinterpret_cast<uint8_t*>(&m_record[0]);
+        KEndian::ToBigEndian(uint16_t(RecordMark), p);
+        p[2] = level;
+        p[3] = kind;
+        KEndian::ToBigEndian(source, p + 4);
+        KEndian::ToBigEndian(sz, p + 6);
+        KEndian::ToBigEndian(now, p + 10);
+    }
+
+    bool KBinaryLog::WriteData(uint8_t level, uint16_t source, const void* dat, size_t sz)
+    {
+        if (sz > MaxPayload)
+            return false;
+
+        m_record.resize(RecordHeaderSize);
+        EncodeHeader(level, BkData, source, uint32_t(sz));
+        m_record.append(static_cast<const char*>(dat), sz);
+        return m_file.Append(m_record.data(), m_record.size()) == m_record.size();
+    }
+
+    bool KBinaryLog::WriteString(uint8_t level, uint16_t source, const char* format, ...)
+    {
+        if (format == NULL)
+            return false;
+
+        // 先按已有容量格式化，不够时扩大后重新格式化 //
+        size_t capacity = (m_record.capacity() > RecordHeaderSize + 128 ? m_record.capacity() : RecordHeaderSize + 128);
+        m_record.resize(capacity);
+        va_list args;
+        va_start(args, format);
+        int rsz = vsnprintf(&m_record[RecordHeaderSize], capacity - RecordHeaderSize, format, args);
+        va_end(args);
+        if (rsz < 0 || size_t(rsz) > MaxPayload)
+            return false;
+
+        if (size_t(rsz) >= capacity - RecordHeaderSize)
+        {
+            m_record.resize(RecordHeaderSize + size_t(rsz) + 1);
+            va_start(args, format);
+            vsnprintf(&m_record[RecordHeaderSize], size_t(rsz) + 1, format, args);
+            va_end(args);
+        }
+        m_record.resize(RecordHeaderSize + size_t(rsz));
+        EncodeHeader(level, BkText, source, uint32_t(rsz));
+        return m_file.Append(m_record.data(), m_record.size()) == m_record.size();
+    }
+
+    KBinaryLogReader::KBinaryLogReader()
+        :m_file(NULL), m_pos(0), m_skipped(0)
+    {
+    }
+
+    KBinaryLogReader::~KBinaryLogReader()
+    {
+        Close();
+    }
+
+    bool KBinaryLogReader::Open(const std::string& filePath)
+    {
+        Close();
+        m_file = fopen(filePath.c_str(), "rb");
+        return m_file != NULL;
+    }
+
+    void KBinaryLogReader::Close()
+    {
+        if (m_file != NULL)
+        {
+            fclose(m_file);
+            m_file = NULL;
+        }
+        m_buffer.clear();
+        m_pos = 0;
+        m_skipped = 0;
+    }
+
+    bool KBinaryLogReader::Fill(size_t sz)
+    {
+        if (m_buffer.size() - m_pos >= sz)
+            return true;
+
+        // 丢弃已读部分后一次读入较大的块 //
+        m_buffer.erase(0, m_pos);
+        m_pos = 0;
+        size_t want = (sz > 64 * 1024 ? sz : 64 * 1024);
+        size_t old = m_buffer.size();
+        m_buffer.resize(old + want);
+        size_t rsz = (m_file != NULL ? fread(&m_buffer[old], 1, want, m_file) : 0);
+        m_buffer.resize(old + rsz);
+        return m_buffer.size() >= sz;
+    }
+
+    bool KBinaryLogReader::Next(BinaryLogRecord& rec)
+    {
+        while (Fill(KBinaryLog::RecordHeaderSize))
+        {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(m_buffer.data() + m_pos);
+            uint16_t mark = 0;
+            uint32_t sz = 0;
+            KEndian::FromNetwork(p, mark);
+            KEndian::FromNetwork(p + 6, sz);
+            if (mark != KBinaryLog::RecordMark || sz > KBinaryLog::MaxPayload || p[3] > BkData)
+            {
+                ++m_pos;
+                ++m_skipped;
+                continue;
+            }
+
+            // 文件末尾的不完整记录 //
+            if (!Fill(KBinaryLog::RecordHeaderSize + sz))
+            {
+                m_skipped += m_buffer.size() - m_pos;
+                m_pos = m_buffer.size();
+                return false;
+            }
+
+            p = reinterpret_cast<const uint8_t*>(m_buffer.data() + m_pos);
+            rec.level = p[2];
+            rec.kind = p[3];
+            KEndian::FromNetwork(p + 4, rec.source);
+            KEndian::FromNetwork(p + 10, rec.timestamp);
+            rec.payload.assign(reinterpret_cast<const char*>(p + KBinaryLog::RecordHeaderSize), sz);
+            m_pos += KBinaryLog::RecordHeaderSize + sz;
+            return true;
+        }
+        m_skipped += m_buffer.size() - m_pos;
+        m_pos = m_buffer.size();
+        return false;
+    }
+
+    void KBinaryLogReader::Format(const BinaryLogRecord& rec, bool timestamp, std::string& out)
+    {
+        out.clear();
+        if (timestamp)
+        {
+            // 与KTextFile 相同：yyyymmddhhnnssccc 后加两个空格 //
+            time_t sec = time_t(rec.timestamp / 1000000);
+            struct tm tmv;
+#if defined(WIN32)
+            localtime_s(&tmv, &sec);
+#else
+            localtime_r(&sec, &tmv);
+#endif
+            char buf[32] = { 0 };
+            size_t n = strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tmv);
+            sprintf(buf + n, "%03u  ", unsigned(rec.timestamp / 1000 % 1000));
+            out.append(buf);
+        }
+
+        if (rec.kind == BkData)
+        {
+            char dst[HexBufferSize];
+            std::string hex;
+            KTextFile::ToHexString(rec.payload.data(), rec.payload.size(), dst, hex);
+            out.append(hex);
+        }
+        else
+            out.append(rec.payload);
+    }
+
+    long KBinaryLogReader::Dump(const std::string& filePath, const BinaryLogFilter& filter, FILE* out)
+    {
+        KBinaryLogReader reader;
+        if (!reader.Open(filePath))
+            return -1;
+
+        long count = 0;
+        BinaryLogRecord rec;
+        std::string text;
+        while (reader.Next(rec))
+        {
+            if (rec.level < filter.minLevel
+                || (filter.source >= 0 && rec.source != filter.source)
+                || (filter.begin != 0 && rec.timestamp < filter.begin)
+                || (filter.end != 0 && rec.timestamp >= filter.end))
+                continue;
+
+            Format(rec, filter.timestamp, text);
+            if (!filter.pattern.empty() && text.find(filter.pattern) == std::string::npos)
+                continue;
+            fwrite(text.data(), 1, text.size(), out);
+            ++count;
+        }
+
+        if (reader.GetSkipped() > 0)
+            fprintf(stderr, "[%s] skipped %llu corrupted bytes\n", filePath.c_str(), (unsigned long long)reader.GetSkipped());
+        return count;
+    }
+};
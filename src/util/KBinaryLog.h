@@ -0,0 +1,198 @@
+#ifndef _BINARYLOG_HPP_
+#define _BINARYLOG_HPP_
+
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+#include <stdint.h>
+#include "util/KTextFile.hpp"
+#include "util/KLogFilter.h"
+/**
+二进制结构化日志，报文按原始字节保存，不转换成16进制，文本按格式化后的字节保存
+记录格式(网络字节序)：标记(2) 级别(1) 类型(1) 来源(2) 长度(4) 时间微秒(8) 数据(长度)
+每条记录以标记开头，文件可以在任意记录处备份切换，损坏的部分在解码时跳过
+写入经过KTextFileBatch 批量写文件，备份规则与KTextFile 相同，非线程安全
+**/
+namespace klib {
+    enum BinaryLogKind
+    {
+        // 文本，解码时原样输出 //
+        BkText = 0,
+        // 报文，解码时按KTextFile::WriteHexString 的格式输出 //
+        BkData = 1
+    };
+
+    struct BinaryLogRecord
+    {
+        uint64_t timestamp;
+        uint8_t level;
+        uint8_t kind;
+        uint16_t source;
+        std::string payload;
+
+        BinaryLogRecord()
+            :timestamp(0), level(0), kind(0), source(0)
+        {}
+    };
+
+    class KBinaryLog
+    {
+    public:
+        enum { RecordMark = 0x4B4C, RecordHeaderSize = 18, MaxPayload = 64 * 1024 * 1024 };
+
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: maxsize 单个文件最大MB
+        * Parameter: duration 备份间隔分钟
+        * Parameter: bufferSize 批量写入的缓存字节数
+        *************************************/
+        KBinaryLog(size_t maxsize = 50, uint16_t duration = 5, size_t bufferSize = 1024 * 1024);
+
+        ~KBinaryLog();
+
+        /************************************
+        * Method:    初始化
+        * Returns:
+        * Parameter: path 路径
+        * Parameter: filename 文件名
+        *************************************/
+        void Initialize(const std::string& path, const std::string& filename);
+
+        /************************************
+        * Method:    写完缓存后关闭文件
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    写入报文
+        * Returns:   成功返回true
+        * Parameter: level 级别
+        * Parameter: source 来源，如设备或连接编号
+        * Parameter: dat 数据
+        * Parameter: sz 长度
+        *************************************/
+        bool WriteData(uint8_t level, uint16_t source, const void* dat, size_t sz);
+
+        /************************************
+        * Method:    写入文本
+        * Returns:   成功返回true
+        * Parameter: level 级别
+        * Parameter: source 来源
+        * Parameter: format 格式串
+        *************************************/
+        bool WriteString(uint8_t level, uint16_t source, const char* format, ...);
+
+        inline void Flush() { m_file.Flush(); }
+
+        inline void SetSyncMode(FileSyncMode mode, int ms = 1000) { m_file.SetSyncMode(mode, ms); }
+
+        inline void SetFlushPolicy(size_t threshold, int ms) { m_file.SetFlushPolicy(threshold, ms); }
+
+        inline void SetRotator(KLogRotator* rotator) { m_file.SetRotator(rotator); }
+
+        inline std::string GetFilePath() const { return m_file.GetFilePath(); }
+
+    private:
+        KBinaryLog(const KBinaryLog&);
+        KBinaryLog& operator=(const KBinaryLog&);
+
+        /************************************
+        * Method:    在m_record 开头写入记录头
+        * Returns:
+        * Parameter: level
+        * Parameter: kind
+        * Parameter: source
+        * Parameter: sz 数据长度
+        *************************************/
+        void EncodeHeader(uint8_t level, uint8_t kind, uint16_t source, uint32_t sz);
+
+    private:
+        KTextFileBatch m_file;
+        // 记录头和数据拼在一起追加，避免一条记录被备份切换分到两个文件 //
+        std::string m_record;
+    };
+
+    /**
+    解码过滤条件
+    **/
+    struct BinaryLogFilter
+    {
+        // 时间范围，微秒，0 表示不限 //
+        uint64_t begin;
+        uint64_t end;
+        uint8_t minLevel;
+        // -1 表示不限 //
+        int source;
+        // 在解码后的文本中查找，空表示不限 //
+        std::string pattern;
+        // 输出时间 //
+        bool timestamp;
+
+        BinaryLogFilter()
+            :begin(0), end(0), minLevel(0), source(-1), timestamp(true)
+        {}
+    };
+
+    class KBinaryLogReader
+    {
+    public:
+        KBinaryLogReader();
+
+        ~KBinaryLogReader();
+
+        bool Open(const std::string& filePath);
+
+        void Close();
+
+        /************************************
+        * Method:    顺序读取下一条记录，遇到损坏的数据向后查找下一个记录标记
+        * Returns:   文件结束返回false
+        * Parameter: rec 记录
+        *************************************/
+        bool Next(BinaryLogRecord& rec);
+
+        /************************************
+        * Method:    因损坏跳过的字节数
+        * Returns:
+        *************************************/
+        inline uint64_t GetSkipped() const { return m_skipped; }
+
+        /************************************
+        * Method:    按KTextFile 的输出格式还原一条记录
+        * Returns:
+        * Parameter: rec 记录
+        * Parameter: timestamp 是否输出时间
+        * Parameter: out 输出
+        *************************************/
+        static void Format(const BinaryLogRecord& rec, bool timestamp, std::string& out);
+
+        /************************************
+        * Method:    解码文件并输出符合条件的记录，供解码工具tools/KBinaryLogDump 调用
+        * Returns:   输出的条数，文件打开失败返回-1
+        * Parameter: filePath 文件
+        * Parameter: filter 过滤条件
+        * Parameter: out 输出，如stdout
+        *************************************/
+        static long Dump(const std::string& filePath, const BinaryLogFilter& filter, FILE* out);
+
+    private:
+        KBinaryLogReader(const KBinaryLogReader&);
+        KBinaryLogReader& operator=(const KBinaryLogReader&);
+
+        /************************************
+        * Method:    保证缓存中至少有sz 字节
+        * Returns:   文件结束前不足返回false
+        * Parameter: sz
+        *************************************/
+        bool Fill(size_t sz);
+
+    private:
+        FILE* m_file;
+        std::string m_buffer;
+        size_t m_pos;
+        uint64_t m_skipped;
+    };
+};
+#endif // !_BINARYLOG_HPP_
@@ -0,0 +1,961 @@
+#include "util/KCsvReader.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include "thread/KThreadPool.h"
+#if defined(WIN32)
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SSE2
+#include <emmintrin.h>
+#endif
+namespace klib {
+    /**
+    查找下一个分隔符、引号、\r 或\n，一次比较16 字节，结果的位掩码在同一组内的多个字段间复用
+    **/
+    class CsvScanner
+    {
+    public:
+        CsvScanner(const char* end, const CsvOptions& opt)
+            :m_end(end), m_block(NULL), m_blockEnd(NULL), m_mask(0)
+        {
+            memset(m_special, 0, sizeof(m_special));
+            m_special[uint8_t(opt.delimiter)] = true;
+            m_special[uint8_t(opt.quote)] = true;
+            m_special['\r'] = true;
+            m_special['\n'] = true;
+#if defined(CSV_SSE2)
+            m_delimiter = _mm_set1_epi8(opt.delimiter);
+            m_quote = _mm_set1_epi8(opt.quote);
+            m_cr = _mm_set1_epi8('\r');
+            m_lf = _mm_set1_epi8('\n');
+#endif
+        }
+
+        /************************************
+        * Method:    从p 开始查找
+        * Returns:   找到的位置，没有时返回end
+        * Parameter: p
+        *************************************/
+        inline const char* Next(const char* p)
+        {
+#if defined(CSV_SSE2)
+            while (true)
+            {
+                if (p >= m_blockEnd)
+                {
+                    if (m_end - p < 16)
+                        break;
+                    Load(p);
+                }
+
+                uint32_t mask = m_mask & (0xFFFFFFFFu << (p - m_block));
+                if (mask != 0)
+                    return m_block + CountTrailingZero(mask);
+                p = m_blockEnd;
+            }
+#endif
+            while (p < m_end && !m_special[uint8_t(*p)])
+                ++p;
+            return p;
+        }
+
+    private:
+#if defined(CSV_SSE2)
+        inline void Load(const char* p)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, m_delimiter), _mm_cmpeq_epi8(x, m_quote)),
+                _mm_or_si128(_mm_cmpeq_epi8(x, m_cr), _mm_cmpeq_epi8(x, m_lf)));
+            m_mask = uint32_t(_mm_movemask_epi8(hit));
+            m_block = p;
+            m_blockEnd = p + 16;
+        }
+
+        static inline uint32_t CountTrailingZero(uint32_t mask)
+        {
+#if defined(WIN32)
+            unsigned long idx = 0;
+            _BitScanForward(&idx, mask);
+            return uint32_t(idx);
+#else
+            return uint32_t(__builtin_ctz(mask));
+#endif
+        }
+#endif
+
+    private:
+        const char* m_end;
+        const char* m_block;
+        const char* m_blockEnd;
+        uint32_t m_mask;
+        bool m_special[256];
+#if defined(CSV_SSE2)
+        __m128i m_delimiter;
+        __m128i m_quote;
+        __m128i m_cr;
+        __m128i m_lf;
+#endif
+    };
+
+    static inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    /**
+    与ParseRange 规则一致的行状态，用于确定分块边界
+    **/
+    enum CsvSplitState
+    {
+        // 行首，前面只有被去掉的空白 //
+        CsLineStart = 0,
+        // 行首有空白且不去空白，仍可能是注释行 //
+        CsLineBlank,
+        // 分隔符后的字段开始 //
+        CsFieldStart,
+        // 未加引号的字段，引号是普通字符 //
+        CsUnquoted,
+        // 引号内 //
+        CsQuoted,
+        // 引号内遇到引号，是转义还是结束由下一个字符决定 //
+        CsQuoteEnd,
+        // 结束引号之后到分隔符或换行之间 //
+        CsAfterQuote,
+        // 注释行，只以\n 结束 //
+        CsComment,
+        CsStateCount
+    };
+
+    /************************************
+    * Method:    按ParseRange 的规则处理一个字符
+    * Returns:   增加的行数，状态变为CsLineStart 且返回1 表示一行结束
+    * Parameter: opt 选项
+    * Parameter: p 字符
+    * Parameter: end 结束，用于判断\r\n
+    * Parameter: state 状态
+    *************************************/
+    static inline int CsvStep(const CsvOptions& opt, const char* p, const char* end, int& state)
+    {
+        char c = *p;
+        // \r\n 由\n 处理 //
+        if (c == '\r' && p + 1 < end && p[1] == '\n')
+            return 0;
+
+        bool eol = (c == '\n' || c == '\r');
+        switch (state)
+        {
+        case CsComment:
+            if (c != '\n')
+                return 0;
+            state = CsLineStart;
+            return 1;
+        case CsQuoted:
+            if (c == opt.quote)
+                state = CsQuoteEnd;
+            return (eol ? 1 : 0);
+        case CsQuoteEnd:
+            if (c == opt.quote)
+            {
+                state = CsQuoted;
+                return 0;
+            }
+            state = CsAfterQuote;
+            break;
+        case CsLineStart:
+        case CsLineBlank:
+            if (IsBlank(c))
+            {
+                if (!opt.trim)
+                    state = CsLineBlank;
+                return 0;
+            }
+            if (opt.comment != 0 && c == opt.comment)
+            {
+                state = CsComment;
+                return 0;
+            }
+            state = (state == CsLineBlank ? CsUnquoted : CsFieldStart);
+            break;
+        default:
+            break;
+        }
+
+        if (state == CsFieldStart)
+        {
+            if (opt.trim && IsBlank(c))
+                return 0;
+            if (c == opt.quote)
+            {
+                state = CsQuoted;
+                return 0;
+            }
+            state = CsUnquoted;
+        }
+
+        // 未加引号的字段和结束引号之后只关心分隔符和换行 //
+        if (c == opt.delimiter)
+        {
+            state = CsFieldStart;
+            return 0;
+        }
+        if (!eol)
+            return 0;
+        state = CsLineStart;
+        return 1;
+    }
+
+    // 普通字符(不是引号、分隔符、换行、空白、注释符)对状态的影响，连续多个与一个相同 //
+    static inline int CsvPlain(int state)
+    {
+        switch (state)
+        {
+        case CsLineStart:
+        case CsLineBlank:
+        case CsFieldStart:
+            return CsUnquoted;
+        case CsQuoteEnd:
+            return CsAfterQuote;
+        default:
+            return state;
+        }
+    }
+
+    /**
+    按字符预先计算的状态转移，低4 位是新状态，高4 位是增加的行数，\r 按单独的\r 计算
+    **/
+    struct CsvStepTable
+    {
+        uint8_t next[CsStateCount][256];
+
+        void Initialize(const CsvOptions& opt)
+        {
+            for (int c = 0; c < 256; ++c)
+            {
+                char buf[2] = { char(c), '\0' };
+                for (int k = 0; k < CsStateCount; ++k)
+                {
+                    int state = k;
+                    int inc = CsvStep(opt, buf, buf + 2, state);
+                    next[k][c] = uint8_t(state | (inc << 4));
+                }
+            }
+        }
+    };
+
+    /**
+    每段从每个可能的状态同时开始模拟，状态相同的模拟合并，通常只剩引号内外两条
+    连续的普通字符一次跳过
+    **/
+    struct CsvSplitTask
+    {
+        const char* begin;
+        const char* end;
+        size_t piece;
+        const CsvOptions* opt;
+        // 第i 段从状态k 开始时，结束的状态和增加的行数，下标为i * CsStateCount + k //
+        std::vector<int>* states;
+        std::vector<size_t>* lines;
+
+        void operator()(size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; ++i)
+            {
+                const char* p = begin + i * piece;
+                const char* last = (size_t(end - p) > piece ? p + piece : end);
+
+                bool special[256];
+                memset(special, 0, sizeof(special));
+                special[uint8_t(opt->quote)] = true;
+                special[uint8_t(opt->delimiter)] = true;
+                special[uint8_t(opt->comment)] = true;
+                special[uint8_t('\r')] = true;
+                special[uint8_t('\n')] = true;
+                special[uint8_t(' ')] = true;
+                special[uint8_t('\t')] = true;
+
+                CsvStepTable table;
+                table.Initialize(*opt);
+
+                int track[CsStateCount];
+                size_t counted[CsStateCount];
+                // 起始状态所在的模拟及合并前相差的行数 //
+                size_t owner[CsStateCount];
+                size_t offset[CsStateCount];
+                size_t n = CsStateCount;
+                for (size_t k = 0; k < CsStateCount; ++k)
+                {
+                    track[k] = int(k);
+                    counted[k] = 0;
+                    owner[k] = k;
+                    offset[k] = 0;
+                }
+
+                while (p < last)
+                {
+                    if (!special[uint8_t(*p)])
+                    {
+                        while (++p < last && !special[uint8_t(*p)])
+                            ;
+                        for (size_t t = 0; t < n; ++t)
+                            track[t] = CsvPlain(track[t]);
+                    }
+                    else
+                    {
+                        uint8_t c = uint8_t(*p++);
+                        // \r\n 由\n 处理 //
+                        if (c == '\r' && p < end && *p == '\n')
+                            continue;
+                        for (size_t t = 0; t < n; ++t)
+                        {
+                            uint8_t v = table.next[track[t]][c];
+                            track[t] = (v & 0x0f);
+                            counted[t] += (v >> 4);
+                        }
+                    }
+
+                    for (size_t t1 = 0; t1 + 1 < n; ++t1)
+                    {
+                        for (size_t t2 = t1 + 1; t2 < n; )
+                        {
+                            if (track[t2] != track[t1])
+                            {
+                                ++t2;
+                                continue;
+                            }
+                            // t2 并入t1，最后一条移到t2 //
+                            --n;
+                            for (size_t k = 0; k < CsStateCount; ++k)
+                            {
+                                if (owner[k] == t2)
+                                {
+                                    owner[k] = t1;
+                                    offset[k] += counted[t2] - counted[t1];
+                                }
+                                else if (owner[k] == n)
+                                    owner[k] = t2;
+                            }
+                            track[t2] = track[n];
+                            counted[t2] = counted[n];
+                        }
+                    }
+                }
+
+                for (size_t k = 0; k < CsStateCount; ++k)
+                {
+                    (*states)[i * CsStateCount + k] = track[owner[k]];
+                    (*lines)[i * CsStateCount + k] = counted[owner[k]] + offset[k];
+                }
+            }
+        }
+    };
+
+    /**
+    解析分块
+    **/
+    struct CsvParseTask
+    {
+        const std::vector<CsvChunk>* chunks;
+        const std::vector<KCsvHandler*>* handlers;
+        const CsvOptions* opt;
+        std::vector<size_t>* rows;
+
+        void operator()(size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; ++i)
+            {
+                const CsvChunk& chunk = (*chunks)[i];
+                bool stopped = false;
+                (*rows)[i] = KCsvReader::ParseRange(chunk.begin, chunk.end, chunk.line, *opt, *(*handlers)[i], stopped);
+            }
+        }
+    };
+
+    std::string CsvRow::ToString(size_t i) const
+    {
+        std::string out;
+        if (i < count)
+        {
+            if (fields[i].escaped)
+                KCsvReader::Unescape(fields[i], quote, out);
+            else
+                out.assign(fields[i].data, fields[i].size);
+        }
+        return out;
+    }
+
+    KCsvReader::KCsvReader()
+        :m_data(NULL), m_size(0)
+#if defined(WIN32)
+        , m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+#endif
+    {
+    }
+
+    KCsvReader::~KCsvReader()
+    {
+        Close();
+    }
+
+    bool KCsvReader::Open(const std::string& filepath)
+    {
+        Close();
+#if defined(WIN32)
+        HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        m_file = file;
+        if (sz.QuadPart == 0)
+            return true;
+
+        m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == NULL)
+        {
+            Close();
+            return false;
+        }
+        m_size = size_t(sz.QuadPart);
+#else
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        if (st.st_size > 0)
+        {
+            void* base = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base == MAP_FAILED)
+            {
+                printf("mmap csv file [%s] failed:[%s]\n", filepath.c_str(), strerror(errno));
+                close(fd);
+                return false;
+            }
+            // 顺序读，让内核预读 //
+            madvise(base, size_t(st.st_size), MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(base);
+            m_size = size_t(st.st_size);
+        }
+        // 映射后可以关闭文件 //
+        close(fd);
+#endif
+        return true;
+    }
+
+    void KCsvReader::Close()
+    {
+#if defined(WIN32)
+        if (m_data != NULL)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != NULL)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data != NULL)
+            munmap(const_cast<char*>(m_data), m_size);
+#endif
+        m_data = NULL;
+        m_size = 0;
+    }
+
+    size_t KCsvReader::Parse(KCsvHandler& handler, const CsvOptions& opt) const
+    {
+        bool stopped = false;
+        return ParseRange(m_data, m_data + m_size, 1, opt, handler, stopped);
+    }
+
+    size_t KCsvReader::ParseParallel(KThreadPool& pool, const std::vector<KCsvHandler*>& handlers, const CsvOptions& opt) const
+    {
+        if (handlers.empty() || m_size == 0)
+            return 0;
+
+        std::vector<CsvChunk> chunks;
+        SplitChunks(pool, m_data, m_data + m_size, handlers.size(), opt, chunks);
+        std::vector<size_t> rows(chunks.size(), 0);
+        CsvParseTask task;
+        task.chunks = &chunks;
+        task.handlers = &handlers;
+        task.opt = &opt;
+        task.rows = &rows;
+        pool.ParallelFor(0, chunks.size(), task, 1);
+
+        size_t total = 0;
+        for (size_t i = 0; i < rows.size(); ++i)
+            total += rows[i];
+        return total;
+    }
+
+    size_t KCsvReader::ParseParallel(KThreadPool& pool, KCsvColumns& columns, size_t chunks, const CsvOptions& opt) const
+    {
+        if (chunks == 0)
+            chunks = (pool.GetThreadCount() > 0 ? pool.GetThreadCount() : 1) * 2;
+
+        // 每块解析到独立的列中，完成后按顺序追加 //
+        KCsvColumns proto(columns);
+        proto.Clear();
+        std::vector<KCsvColumns> parts(chunks, proto);
+        std::vector<KCsvHandler*> handlers(chunks, NULL);
+        for (size_t i = 0; i < chunks; ++i)
+            handlers[i] = &parts[i];
+
+        size_t rows = ParseParallel(pool, handlers, opt);
+        for (size_t i = 0; i < chunks; ++i)
+            columns.Append(parts[i]);
+        return rows;
+    }
+
+    void KCsvReader::SplitChunks(KThreadPool& pool, const char* begin, const char* end, size_t count, const CsvOptions& opt, std::vector<CsvChunk>& chunks)
+    {
+        chunks.clear();
+        if (begin == NULL || begin >= end)
+            return;
+
+        // 每块至少1MB //
+        size_t total = size_t(end - begin);
+        size_t most = total / (1024 * 1024) + 1;
+        count = (count == 0 ? 1 : (count > most ? most : count));
+        size_t piece = (total + count - 1) / count;
+
+        std::vector<int> states(count * CsStateCount, CsLineStart);
+        std::vector<size_t> lines(count * CsStateCount, 0);
+        CsvSplitTask task;
+        task.begin = begin;
+        task.end = end;
+        task.piece = piece;
+        task.opt = &opt;
+        task.states = &states;
+        task.lines = &lines;
+        pool.ParallelFor(0, count, task, 1);
+
+        // 由前一段的结果得到段首的状态，从段首找第一个行尾作为边界 //
+        CsvChunk chunk;
+        chunk.begin = begin;
+        chunk.line = 1;
+        int state = CsLineStart;
+        size_t line = 1;
+        for (size_t i = 1; i < count; ++i)
+        {
+            size_t k = (i - 1) * CsStateCount + size_t(state);
+            line += lines[k];
+            state = states[k];
+            const char* p = begin + i * piece;
+            if (p < chunk.begin)
+                continue;
+
+            int s = state;
+            size_t l = line;
+            bool boundary = false;
+            while (p < end && !boundary)
+            {
+                int inc = CsvStep(opt, p++, end, s);
+                l += size_t(inc);
+                boundary = (inc != 0 && s == CsLineStart);
+            }
+            if (!boundary || p >= end)
+                break;
+
+            chunk.end = p;
+            chunks.push_back(chunk);
+            chunk.begin = p;
+            chunk.line = l;
+        }
+        chunk.end = end;
+        chunks.push_back(chunk);
+    }
+
+    size_t KCsvReader::ParseRange(const char* begin, const char* end, size_t firstLine,
+        const CsvOptions& opt, KCsvHandler& handler, bool& stopped)
+    {
+        stopped = false;
+        if (begin == NULL || begin >= end)
+            return 0;
+
+        CsvScanner scanner(end, opt);
+        std::vector<CsvField> fields;
+        fields.reserve(32);
+        size_t rows = 0;
+        size_t line = firstLine;
+        const char* p = begin;
+        while (p < end)
+        {
+            size_t rowLine = line;
+            bool skip = false;
+            fields.clear();
+
+            // 注释行 //
+            if (opt.comment != 0)
+            {
+                const char* q = p;
+                while (q < end && IsBlank(*q))
+                    ++q;
+                if (q < end && *q == opt.comment)
+                {
+                    const char* lf = static_cast<const char*>(memchr(q, '\n', size_t(end - q)));
+                    p = (lf == NULL ? end : lf + 1);
+                    ++line;
+                    continue;
+                }
+            }
+
+            bool quotedRow = false;
+            while (true)
+            {
+                CsvField field;
+                field.escaped = false;
+                if (opt.trim)
+                {
+                    while (p < end && IsBlank(*p))
+                        ++p;
+                }
+
+                const char* q = NULL;
+                if (p < end && *p == opt.quote)
+                {
+                    // 引号内的分隔符和换行是普通字符，只找结束引号 //
+                    quotedRow = true;
+                    field.data = ++p;
+                    while (true)
+                    {
+                        q = scanner.Next(p);
+                        if (q >= end)
+                        {
+                            field.size = size_t(end - field.data);
+                            break;
+                        }
+                        if (*q == opt.quote)
+                        {
+                            if (q + 1 < end && q[1] == opt.quote)
+                            {
+                                field.escaped = true;
+                                p = q + 2;
+                                continue;
+                            }
+                            field.size = size_t(q - field.data);
+                            ++q;
+                            break;
+                        }
+                        if (*q == '\n' || (*q == '\r' && (q + 1 >= end || q[1] != '\n')))
+                            ++line;
+                        p = q + 1;
+                    }
+
+                    // 结束引号后到分隔符之间的字符忽略 //
+                    while (q < end && *q != opt.delimiter && *q != '\r' && *q != '\n')
+                        q = scanner.Next(q + (*q == opt.quote ? 1 : 0));
+                }
+                else
+                {
+                    // 未加引号的字段中的引号是普通字符 //
+                    field.data = p;
+                    q = scanner.Next(p);
+                    while (q < end && *q == opt.quote)
+                        q = scanner.Next(q + 1);
+                    const char* e = q;
+                    if (opt.trim)
+                    {
+                        while (e > field.data && IsBlank(e[-1]))
+                            --e;
+                    }
+                    field.size = size_t(e - field.data);
+                }
+                fields.push_back(field);
+
+                if (q >= end)
+                {
+                    p = end;
+                    break;
+                }
+                if (*q == opt.delimiter)
+                {
+                    p = q + 1;
+                    // 文件以分隔符结束，最后一个字段为空 //
+                    if (p >= end)
+                    {
+                        field.data = p;
+                        field.size = 0;
+                        field.escaped = false;
+                        fields.push_back(field);
+                        break;
+                    }
+                    continue;
+                }
+
+                p = q + 1;
+                if (*q == '\r' && p < end && *p == '\n')
+                    ++p;
+                ++line;
+                break;
+            }
+
+            if (opt.skipEmpty && fields.size() == 1 && fields[0].size == 0 && !quotedRow)
+                skip = true;
+
+            if (!skip)
+            {
+                CsvRow row;
+                row.fields = &fields[0];
+                row.count = fields.size();
+                row.line = rowLine;
+                row.quote = opt.quote;
+                ++rows;
+                if (!handler.OnRow(row))
+                {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+        return rows;
+    }
+
+    void KCsvReader::Unescape(const CsvField& field, char quote, std::string& out)
+    {
+        out.clear();
+        out.reserve(field.size);
+        for (size_t i = 0; i < field.size; ++i)
+        {
+            out.push_back(field.data[i]);
+            if (field.data[i] == quote && i + 1 < field.size && field.data[i + 1] == quote)
+                ++i;
+        }
+    }
+
+    KCsvColumns::KCsvColumns()
+        :m_minFields(0), m_rows(0)
+    {
+    }
+
+    size_t KCsvColumns::AddColumn(size_t index, CsvColumnType type)
+    {
+        Column col;
+        col.index = index;
+        col.type = type;
+        col.offsets.push_back(0);
+        m_columns.push_back(col);
+        return m_columns.size() - 1;
+    }
+
+    bool KCsvColumns::OnRow(const CsvRow& row)
+    {
+        if (row.count < m_minFields)
+            return true;
+
+        for (size_t i = 0; i < m_columns.size(); ++i)
+        {
+            Column& col = m_columns[i];
+            const char* dat = NULL;
+            size_t sz = 0;
+            bool valid = (col.index < row.count);
+            if (valid)
+            {
+                const CsvField& field = row.fields[col.index];
+                dat = field.data;
+                sz = field.size;
+                if (field.escaped)
+                {
+                    KCsvReader::Unescape(field, row.quote, m_unescaped);
+                    dat = m_unescaped.data();
+                    sz = m_unescaped.size();
+                }
+            }
+
+            switch (col.type)
+            {
+            case CtInt64:
+            {
+                int64_t v = 0;
+                valid = valid && ParseInt64(dat, sz, v);
+                col.ints.push_back(valid ? v : 0);
+                break;
+            }
+            case CtDouble:
+            {
+                double v = 0;
+                valid = valid && ParseDouble(dat, sz, v);
+                col.doubles.push_back(valid ? v : 0);
+                break;
+            }
+            default:
+                if (valid)
+                    col.chars.append(dat, sz);
+                col.offsets.push_back(col.chars.size());
+                break;
+            }
+            col.nulls.push_back(valid ? 0 : 1);
+        }
+        ++m_rows;
+        return true;
+    }
+
+    bool KCsvColumns::IsNull(size_t col, size_t row) const
+    {
+        return col >= m_columns.size() || row >= m_rows || m_columns[col].nulls[row] != 0;
+    }
+
+    int64_t KCsvColumns::GetInt64(size_t col, size_t row) const
+    {
+        if (col < m_columns.size() && row < m_columns[col].ints.size())
+            return m_columns[col].ints[row];
+        return 0;
+    }
+
+    double KCsvColumns::GetDouble(size_t col, size_t row) const
+    {
+        if (col < m_columns.size() && row < m_columns[col].doubles.size())
+            return m_columns[col].doubles[row];
+        return 0;
+    }
+
+    size_t KCsvColumns::GetString(size_t col, size_t row, const char*& dat) const
+    {
+        dat = NULL;
+        if (col >= m_columns.size() || row + 1 >= m_columns[col].offsets.size())
+            return 0;
+
+        const Column& c = m_columns[col];
+        dat = c.chars.data() + c.offsets[row];
+        return c.offsets[row + 1] - c.offsets[row];
+    }
+
+    std::string KCsvColumns::GetString(size_t col, size_t row) const
+    {
+        const char* dat = NULL;
+        size_t sz = GetString(col, row, dat);
+        return std::string(dat == NULL ? "" : dat, sz);
+    }
+
+    const std::vector<int64_t>& KCsvColumns::GetInt64Column(size_t col) const
+    {
+        static const std::vector<int64_t> empty;
+        return (col < m_columns.size() ? m_columns[col].ints : empty);
+    }
+
+    const std::vector<double>& KCsvColumns::GetDoubleColumn(size_t col) const
+    {
+        static const std::vector<double> empty;
+        return (col < m_columns.size() ? m_columns[col].doubles : empty);
+    }
+
+    void KCsvColumns::Clear()
+    {
+        for (size_t i = 0; i < m_columns.size(); ++i)
+        {
+            Column& col = m_columns[i];
+            col.ints.clear();
+            col.doubles.clear();
+            col.chars.clear();
+            col.offsets.assign(1, 0);
+            col.nulls.clear();
+        }
+        m_rows = 0;
+    }
+
+    bool KCsvColumns::Append(const KCsvColumns& other)
+    {
+        if (other.m_columns.size() != m_columns.size())
+            return false;
+        for (size_t i = 0; i < m_columns.size(); ++i)
+        {
+            if (m_columns[i].index != other.m_columns[i].index || m_columns[i].type != other.m_columns[i].type)
+                return false;
+        }
+
+        for (size_t i = 0; i < m_columns.size(); ++i)
+        {
+            Column& col = m_columns[i];
+            const Column& src = other.m_columns[i];
+            col.ints.insert(col.ints.end(), src.ints.begin(), src.ints.end());
+            col.doubles.insert(col.doubles.end(), src.doubles.begin(), src.doubles.end());
+            size_t base = col.chars.size();
+            col.chars.append(src.chars);
+            col.offsets.reserve(col.offsets.size() + src.offsets.size() - 1);
+            for (size_t j = 1; j < src.offsets.size(); ++j)
+                col.offsets.push_back(base + src.offsets[j]);
+            col.nulls.insert(col.nulls.end(), src.nulls.begin(), src.nulls.end());
+        }
+        m_rows += other.m_rows;
+        return true;
+    }
+
+    bool KCsvColumns::ParseInt64(const char* dat, size_t sz, int64_t& val)
+    {
+        if (dat == NULL || sz == 0)
+            return false;
+
+        size_t i = 0;
+        bool negative = (dat[0] == '-');
+        if (dat[0] == '-' || dat[0] == '+')
+            ++i;
+        if (i == sz)
+            return false;
+
+        uint64_t limit = (negative ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL);
+        uint64_t v = 0;
+        for (; i < sz; ++i)
+        {
+            unsigned d = unsigned(dat[i] - '0');
+            if (d > 9 || v > (limit - d) / 10)
+                return false;
+            v = v * 10 + d;
+        }
+        val = (negative ? int64_t(0 - v) : int64_t(v));
+        return true;
+    }
+
+    bool KCsvColumns::ParseDouble(const char* dat, size_t sz, double& val)
+    {
+        if (dat == NULL || sz == 0)
+            return false;
+
+        // 字段不以0 结尾，拷贝后转换 //
+        char buf[64];
+        std::string big;
+        const char* s = buf;
+        if (sz < sizeof(buf))
+        {
+            memcpy(buf, dat, sz);
+            buf[sz] = 0;
+        }
+        else
+        {
+            big.assign(dat, sz);
+            s = big.c_str();
+        }
+
+        char* e = NULL;
+        val = strtod(s, &e);
+        return e == s + sz;
+    }
+};
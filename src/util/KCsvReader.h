@@ -0,0 +1,282 @@
+#ifndef _CSVREADER_HPP_
+#define _CSVREADER_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+/**
+流式csv解析，文件整体映射到内存，按16 字节一组用SSE2 查找分隔符、引号和换行(不支持时逐字节查找)
+字段不拷贝，以指针加长度的形式通过回调返回，回调返回后失效
+支持引号包围的字段(可包含分隔符、换行和转义的引号"")，#开头的注释行和空行跳过
+KCsvColumns 按列把需要的字段转换成整数、浮点数或字符串保存
+ParseParallel 把文件在行尾切成多块在线程池中解析，切分与解析使用相同的引号和注释规则
+**/
+namespace klib {
+    class KThreadPool;
+    class KCsvColumns;
+
+    struct CsvField
+    {
+        const char* data;
+        size_t size;
+        // 引号内包含转义的引号，需要调用KCsvReader::Unescape 还原 //
+        bool escaped;
+    };
+
+    struct CsvRow
+    {
+        const CsvField* fields;
+        size_t count;
+        // 行首所在的行号，从1 开始 //
+        size_t line;
+        char quote;
+
+        /************************************
+        * Method:    拷贝第i 个字段，转义的引号被还原
+        * Returns:   不存在返回空字符串
+        * Parameter: i
+        *************************************/
+        std::string ToString(size_t i) const;
+    };
+
+    struct CsvOptions
+    {
+        char delimiter;
+        char quote;
+        // 0 表示没有注释行 //
+        char comment;
+        // 去掉未加引号字段两边的空格和制表符 //
+        bool trim;
+        bool skipEmpty;
+
+        CsvOptions()
+            :delimiter(','), quote('"'), comment('#'), trim(true), skipEmpty(true)
+        {}
+    };
+
+    /**
+    并行解析的分块，从行首开始到换行后结束
+    **/
+    struct CsvChunk
+    {
+        const char* begin;
+        const char* end;
+        // begin 所在的行号 //
+        size_t line;
+    };
+
+    class KCsvHandler
+    {
+    public:
+        virtual ~KCsvHandler() {}
+
+        /************************************
+        * Method:    处理一行
+        * Returns:   返回false 停止解析
+        * Parameter: row 行，字段指向映射的文件
+        *************************************/
+        virtual bool OnRow(const CsvRow& row) = 0;
+    };
+
+    class KCsvReader
+    {
+    public:
+        KCsvReader();
+
+        ~KCsvReader();
+
+        /************************************
+        * Method:    只读映射文件
+        * Returns:   成功返回true，空文件也返回true
+        * Parameter: filepath
+        *************************************/
+        bool Open(const std::string& filepath);
+
+        void Close();
+
+        /************************************
+        * Method:    解析整个文件
+        * Returns:   回调的行数
+        * Parameter: handler 回调
+        * Parameter: opt 选项
+        *************************************/
+        size_t Parse(KCsvHandler& handler, const CsvOptions& opt = CsvOptions()) const;
+
+        /************************************
+        * Method:    分块并行解析，第i 块由handlers[i] 处理，块按文件顺序排列
+        * Returns:   回调的总行数，回调抛出异常时在所有分块结束后抛出
+        * Parameter: pool 线程池，调用线程也参与解析
+        * Parameter: handlers 每块一个回调，个数即分块数，文件较小时后面的块为空
+        * Parameter: opt 选项
+        *************************************/
+        size_t ParseParallel(KThreadPool& pool, const std::vector<KCsvHandler*>& handlers, const CsvOptions& opt = CsvOptions()) const;
+
+        /************************************
+        * Method:    分块并行解析成列，按顺序合并到columns
+        * Returns:   回调的总行数
+        * Parameter: pool 线程池
+        * Parameter: columns 已添加列定义，结果追加到末尾
+        * Parameter: chunks 分块数，0 表示线程数的2 倍
+        * Parameter: opt 选项
+        *************************************/
+        size_t ParseParallel(KThreadPool& pool, KCsvColumns& columns, size_t chunks = 0, const CsvOptions& opt = CsvOptions()) const;
+
+        inline const char* GetData() const { return m_data; }
+
+        inline size_t GetSize() const { return m_size; }
+
+        /************************************
+        * Method:    解析一段内存，范围必须从行首开始
+        * Returns:   回调的行数
+        * Parameter: begin 开始
+        * Parameter: end 结束
+        * Parameter: firstLine begin 所在的行号
+        * Parameter: opt 选项
+        * Parameter: handler 回调
+        * Parameter: stopped 回调要求停止时置为true
+        *************************************/
+        static size_t ParseRange(const char* begin, const char* end, size_t firstLine,
+            const CsvOptions& opt, KCsvHandler& handler, bool& stopped);
+
+        /************************************
+        * Method:    还原字段中转义的引号
+        * Returns:
+        * Parameter: field 字段
+        * Parameter: quote 引号
+        * Parameter: out 输出
+        *************************************/
+        static void Unescape(const CsvField& field, char quote, std::string& out);
+
+        /************************************
+        * Method:    切分成在行尾结束的块，先并行模拟每段从各个解析状态开始时的结束状态和行数，再确定边界
+        * Returns:
+        * Parameter: pool 线程池
+        * Parameter: begin 开始
+        * Parameter: end 结束
+        * Parameter: count 块数，文件较小时减少
+        * Parameter: opt 选项，与解析使用的相同
+        * Parameter: chunks 输出
+        *************************************/
+        static void SplitChunks(KThreadPool& pool, const char* begin, const char* end, size_t count, const CsvOptions& opt, std::vector<CsvChunk>& chunks);
+
+    private:
+        KCsvReader(const KCsvReader&);
+        KCsvReader& operator=(const KCsvReader&);
+
+    private:
+        const char* m_data;
+        size_t m_size;
+#if defined(WIN32)
+        void* m_file;
+        void* m_mapping;
+#endif
+    };
+
+    enum CsvColumnType
+    {
+        CtString = 0,
+        CtInt64 = 1,
+        CtDouble = 2
+    };
+
+    /**
+    列式保存，每列一块连续内存，字符串列保存为字符池加偏移
+    缺失或转换失败的值保存为0 或空字符串，并标记为空
+    **/
+    class KCsvColumns :public KCsvHandler
+    {
+    public:
+        KCsvColumns();
+
+        /************************************
+        * Method:    添加需要保存的列，在解析前调用
+        * Returns:   新列的序号
+        * Parameter: index csv 中的字段序号
+        * Parameter: type 类型
+        *************************************/
+        size_t AddColumn(size_t index, CsvColumnType type);
+
+        /************************************
+        * Method:    设置每行最少的字段数，不足的行丢弃
+        * Returns:
+        * Parameter: count
+        *************************************/
+        inline void SetMinFields(size_t count) { m_minFields = count; }
+
+        virtual bool OnRow(const CsvRow& row);
+
+        inline size_t GetRowCount() const { return m_rows; }
+
+        inline size_t GetColumnCount() const { return m_columns.size(); }
+
+        bool IsNull(size_t col, size_t row) const;
+
+        int64_t GetInt64(size_t col, size_t row) const;
+
+        double GetDouble(size_t col, size_t row) const;
+
+        /************************************
+        * Method:    获取字符串，不拷贝
+        * Returns:   字符串长度
+        * Parameter: col 列
+        * Parameter: row 行
+        * Parameter: dat 指向字符池
+        *************************************/
+        size_t GetString(size_t col, size_t row, const char*& dat) const;
+
+        std::string GetString(size_t col, size_t row) const;
+
+        /************************************
+        * Method:    整列数据，列类型不符时为空
+        * Returns:
+        * Parameter: col
+        *************************************/
+        const std::vector<int64_t>& GetInt64Column(size_t col) const;
+
+        const std::vector<double>& GetDoubleColumn(size_t col) const;
+
+        /************************************
+        * Method:    清空数据，保留列定义
+        * Returns:
+        *************************************/
+        void Clear();
+
+        /************************************
+        * Method:    把列定义相同的另一份数据追加到末尾
+        * Returns:   列定义不同返回false
+        * Parameter: other
+        *************************************/
+        bool Append(const KCsvColumns& other);
+
+        /************************************
+        * Method:    字符串转整数
+        * Returns:   格式错误或溢出返回false
+        * Parameter: dat
+        * Parameter: sz
+        * Parameter: val
+        *************************************/
+        static bool ParseInt64(const char* dat, size_t sz, int64_t& val);
+
+        static bool ParseDouble(const char* dat, size_t sz, double& val);
+
+    private:
+        struct Column
+        {
+            size_t index;
+            CsvColumnType type;
+            std::vector<int64_t> ints;
+            std::vector<double> doubles;
+            std::string chars;
+            // 第i 行字符串为chars[offsets[i], offsets[i + 1]) //
+            std::vector<size_t> offsets;
+            std::vector<uint8_t> nulls;
+        };
+
+    private:
+        std::vector<Column> m_columns;
+        size_t m_minFields;
+        size_t m_rows;
+        std::string m_unescaped;
+    };
+};
+#endif // !_CSVREADER_HPP_
@@ -6,8 +6,9 @@
 #include <map>
 #include <vector>
 #include "util/KStringUtility.h"
+#include "thread/KShardedRwLock.h"
 /**
-INI文件解析类
+INI文件解析类，可以在读取的同时重新解析文件(热加载)
 **/
 namespace klib
 {
@@ -24,6 +25,8 @@ namespace klib
             FILE* fd = fopen(filepath.c_str(), "r");
             if (fd)
             {
+                // 先解析到临时数据，再在写锁内合并，读者不会看到解析到一半的数据 //
+                std::map<std::string, std::map<std::string, std::string> > iniDat;
                 std::string line;
                 std::string group;
                 while (!feof(fd))
@@ -47,7 +50,7 @@ namespace klib
                                 KStringUtility::SplitString(line, "=", param, true);
                                 if (param.size() == 2)
                                 {
-                                    std::map<std::string, std::string>& params = m_iniDat[group];
+                                    std::map<std::string, std::string>& params = iniDat[group];
                                     param[0] = KStringUtility::TrimString(param[0]);
                                     param[1] = KStringUtility::TrimString(param[1]);
                                     params[param[0]] = param[1];
@@ -57,6 +60,23 @@ namespace klib
                     }
                 }
                 fclose(fd);
+
+                // 与之前解析的文件合并，同名参数以本次为准 //
+                KShardedRwLock::WriteGuard guard(m_iniLock);
+                std::map<std::string, std::map<std::string, std::string> >::iterator it = iniDat.begin();
+                for (; it != iniDat.end(); ++it)
+                {
+                    std::map<std::string, std::string>& params = m_iniDat[it->first];
+                    if (params.empty())
+                    {
+                        params.swap(it->second);
+                        continue;
+                    }
+
+                    std::map<std::string, std::string>::const_iterator pit = it->second.begin();
+                    for (; pit != it->second.end(); ++pit)
+                        params[pit->first] = pit->second;
+                }
                 return true;
             }
             return false;
@@ -71,6 +91,7 @@ namespace klib
         *************************************/
         bool GetValue(const std::string& group, const std::string& key, std::string& val)
         {
+            KShardedRwLock::ReadGuard guard(m_iniLock);
             std::map<std::string, std::map<std::string, std::string> >::iterator it = m_iniDat.find(group);
             if (it != m_iniDat.end())
             {
@@ -85,11 +106,22 @@ namespace klib
         }
 
         /************************************
-        * Method:    获取全部数据
+        * Method:    获取全部数据，不能与ParseFile 同时调用
         * Returns:   
         *************************************/
         const std::map<std::string, std::map<std::string, std::string> >& GetData() const { return m_iniDat; }
 
+        /************************************
+        * Method:    拷贝全部数据，可以与ParseFile 同时调用
+        * Returns:   
+        * Parameter: dat 数据
+        *************************************/
+        void GetData(std::map<std::string, std::map<std::string, std::string> >& dat) const
+        {
+            KShardedRwLock::ReadGuard guard(m_iniLock);
+            dat = m_iniDat;
+        }
+
 
     private:
         bool ReadLine(FILE* fd, std::string& line)
@@ -106,6 +138,8 @@ namespace klib
 
     private:
         std::map<std::string, std::map<std::string, std::string> > m_iniDat;
+        // 读多写少，使用分片读写锁 //
+        KShardedRwLock m_iniLock;
     };
 };
 #endif
@@ -0,0 +1,131 @@
+#ifndef _LOGFILTER_HPP_
+#define _LOGFILTER_HPP_
+
+#include <stdint.h>
+#include "thread/KAtomic.h"
+#include "util/KTime.h"
+/**
+日志前端过滤：编译期最低级别、按调用点的令牌桶限速和N 取1 采样
+低于KLOG_MIN_LEVEL 的常量级别在编译期被消除，参数不会被求值，可在解析报文等热路径中保留诊断日志
+发布版本通过编译选项提高级别，如-DKLOG_MIN_LEVEL=2 (LlInfo)
+KLOG/KLOG_RATE/KLOG_SAMPLE 调用logger.WriteString(...)，级别只用于过滤，适用于KTextFile、KTextFileBatch、KAsyncLogger
+带_L 后缀的宏把级别作为第一个参数传给logger.WriteString(level, ...)，适用于KBinaryLog 等记录级别的日志
+用法：
+    KLOG(file, LlDebug, "recv %d bytes\n", len);
+    KLOG_RATE(file, LlWarn, 10, 20, "invalid packet from %s\n", addr);   // 每秒10 条，最多突发20 条
+    KLOG_SAMPLE_L(blog, LlTrace, 1000, id, "seq=%u\n", seq);            // 每1000 次写1 次
+**/
+#ifndef KLOG_MIN_LEVEL
+#define KLOG_MIN_LEVEL 0
+#endif
+
+#define KLOG_ENABLED(level) ((level) >= KLOG_MIN_LEVEL)
+
+#define KLOG(logger, level, ...) \
+    do { if (KLOG_ENABLED(level)) (logger).WriteString(__VA_ARGS__); } while (0)
+
+// 每个调用点一个静态KLogSite //
+#define KLOG_RATE(logger, level, perSecond, burst, ...) \
+    do { if (KLOG_ENABLED(level)) { static klib::KLogSite _klogSite; \
+        if (_klogSite.Acquire(perSecond, burst)) (logger).WriteString(__VA_ARGS__); } } while (0)
+
+#define KLOG_SAMPLE(logger, level, n, ...) \
+    do { if (KLOG_ENABLED(level)) { static klib::KLogSite _klogSite; \
+        if (_klogSite.Sample(n)) (logger).WriteString(__VA_ARGS__); } } while (0)
+
+// 转发级别 //
+#define KLOG_L(logger, level, ...) \
+    do { if (KLOG_ENABLED(level)) (logger).WriteString(level, __VA_ARGS__); } while (0)
+
+#define KLOG_RATE_L(logger, level, perSecond, burst, ...) \
+    do { if (KLOG_ENABLED(level)) { static klib::KLogSite _klogSite; \
+        if (_klogSite.Acquire(perSecond, burst)) (logger).WriteString(level, __VA_ARGS__); } } while (0)
+
+#define KLOG_SAMPLE_L(logger, level, n, ...) \
+    do { if (KLOG_ENABLED(level)) { static klib::KLogSite _klogSite; \
+        if (_klogSite.Sample(n)) (logger).WriteString(level, __VA_ARGS__); } } while (0)
+
+namespace klib {
+    enum LogLevel
+    {
+        LlTrace = 0,
+        LlDebug = 1,
+        LlInfo = 2,
+        LlWarn = 3,
+        LlError = 4,
+        LlFatal = 5
+    };
+
+    /**
+    调用点状态，令牌桶按GCRA 实现，只有一个64 位的理论到达时间，无锁
+    **/
+    class KLogSite
+    {
+    public:
+        KLogSite()
+            :m_tat(0), m_count(0), m_suppressed(0)
+        {}
+
+        /************************************
+        * Method:    获取一个令牌
+        * Returns:   限速内返回true
+        * Parameter: perSecond 每秒条数，0 表示全部丢弃
+        * Parameter: burst 最大突发条数
+        *************************************/
+        inline bool Acquire(uint32_t perSecond, uint32_t burst)
+        {
+            if (perSecond == 0)
+            {
+                m_suppressed.FetchAdd(1, MoRelaxed);
+                return false;
+            }
+
+            uint64_t interval = 1000000000ULL / perSecond;
+            uint64_t tolerance = uint64_t(burst > 1 ? burst - 1 : 0) * interval;
+            uint64_t now = 0;
+            KTime::MonotonicNanosecond(now);
+            uint64_t tat = m_tat.Load(MoRelaxed);
+            while (true)
+            {
+                uint64_t base = (tat > now ? tat : now);
+                if (base - now > tolerance)
+                {
+                    m_suppressed.FetchAdd(1, MoRelaxed);
+                    return false;
+                }
+                if (m_tat.CompareExchange(tat, base + interval, MoRelaxed))
+                    return true;
+            }
+        }
+
+        /************************************
+        * Method:    N 取1 采样，第一次调用总是返回true
+        * Returns:   本次需要写日志返回true
+        * Parameter: n 采样间隔，0 或1 表示不采样
+        *************************************/
+        inline bool Sample(uint32_t n)
+        {
+            if (n <= 1)
+                return true;
+            if (m_count.FetchAdd(1, MoRelaxed) % n == 0)
+                return true;
+            m_suppressed.FetchAdd(1, MoRelaxed);
+            return false;
+        }
+
+        /************************************
+        * Method:    取出并清零被丢弃的条数
+        * Returns:
+        *************************************/
+        inline uint64_t TakeSuppressed()
+        {
+            return (m_suppressed.Load(MoRelaxed) == 0 ? 0 : m_suppressed.Exchange(0, MoRelaxed));
+        }
+
+    private:
+        AtomicInteger<uint64_t> m_tat;
+        AtomicInteger<uint64_t> m_count;
+        AtomicInteger<uint64_t> m_suppressed;
+    };
+};
+#endif // !_LOGFILTER_HPP_
@@ -0,0 +1,193 @@
+#include "util/KLogRotator.h"
+#include <cstdio>
+#include <vector>
+#include "util/KTextFile.hpp"
+#if defined(LINUX)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__ZLIB__)
+#include <zlib.h>
+#endif
+#if defined(__ZSTD__)
+#include <zstd.h>
+#endif
+namespace klib {
+    KLogRotator::KLogRotator(LogCompress compress, int level)
+        :KEventObject<RotateTask>("KLogRotator Thread", 1000), m_compress(compress), m_level(level), m_lowered(false)
+    {
+        // 没有编译对应的压缩库时只移动文件 //
+        if (*GetExtension(m_compress) == 0)
+            m_compress = LcNone;
+    }
+
+    KLogRotator::~KLogRotator()
+    {
+        Close();
+    }
+
+    void KLogRotator::Close()
+    {
+        if (!IsRunning())
+            return;
+
+        KEventObject<RotateTask>::Stop();
+        KEventObject<RotateTask>::WaitForStop();
+        // 在当前线程处理剩余的任务，备份文件不能丢 //
+        std::vector<RotateTask> tasks;
+        KEventObject<RotateTask>::Flush(tasks);
+        for (size_t i = 0; i < tasks.size(); ++i)
+            Execute(tasks[i]);
+    }
+
+    bool KLogRotator::Rotate(const std::string& source, const std::string& target)
+    {
+        RotateTask task;
+        task.source = source;
+        task.target = target;
+        return Post(task);
+    }
+
+    void KLogRotator::ProcessEvent(const RotateTask& ev)
+    {
+        if (!m_lowered)
+        {
+            LowerPriority();
+            m_lowered = true;
+        }
+        Execute(ev);
+    }
+
+    void KLogRotator::Execute(const RotateTask& task)
+    {
+        size_t pos = task.target.find_last_of("/\\");
+        if (pos != std::string::npos && !KTextFile::Mkdir(task.target.substr(0, pos)))
+        {
+            printf("Create backup directory for [%s] failed\n", task.target.c_str());
+            return;
+        }
+
+        // 同一秒内多次备份时文件名相同，加序号避免覆盖 //
+        std::string suffix, baseName, target(task.target);
+        KTextFile::GetFileBaseName(task.target, suffix, baseName);
+        const char* ext = GetExtension(m_compress);
+        for (int i = 1; KTextFile::IsExist(target) || KTextFile::IsExist(target + ext); ++i)
+        {
+            char seq[16] = { 0 };
+            sprintf(seq, "_%d", i);
+            target = baseName + seq + suffix;
+        }
+
+        if (::rename(task.source.c_str(), target.c_str()) != 0)
+        {
+            printf("Rename [%s] to [%s] failed\n", task.source.c_str(), target.c_str());
+            return;
+        }
+
+        std::string dest;
+        if (m_compress != LcNone && !Compress(target, m_compress, m_level, dest))
+            printf("Compress [%s] failed\n", target.c_str());
+    }
+
+    void KLogRotator::LowerPriority()
+    {
+#if defined(LINUX)
+        pid_t tid = pid_t(syscall(SYS_gettid));
+        setpriority(PRIO_PROCESS, id_t(tid), 19);
+#if defined(SYS_ioprio_set)
+        // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE //
+        syscall(SYS_ioprio_set, 1, int(tid), 3 << 13);
+#endif
+#endif
+    }
+
+    const char* KLogRotator::GetExtension(LogCompress compress)
+    {
+        switch (compress)
+        {
+#if defined(__ZLIB__)
+        case LcGzip: return ".gz";
+#endif
+#if defined(__ZSTD__)
+        case LcZstd: return ".zst";
+#endif
+        default: return "";
+        }
+    }
+
+    bool KLogRotator::Compress(const std::string& source, LogCompress compress, int level, std::string& dest)
+    {
+        const char* ext = GetExtension(compress);
+        if (*ext == 0)
+            return false;
+        // 只在定义了压缩库时使用 //
+        (void)level;
+
+        FILE* in = fopen(source.c_str(), "rb");
+        if (in == NULL)
+            return false;
+
+        dest = source + ext;
+        std::vector<char> buf(256 * 1024);
+        bool ok = false;
+#if defined(__ZLIB__)
+        if (compress == LcGzip)
+        {
+            char mode[8] = { 0 };
+            sprintf(mode, "wb%d", (level > 0 && level <= 9) ? level : 6);
+            gzFile gz = gzopen(dest.c_str(), mode);
+            if (gz != NULL)
+            {
+                ok = true;
+                size_t rsz = 0;
+                while (ok && (rsz = fread(&buf[0], 1, buf.size(), in)) > 0)
+                    ok = (gzwrite(gz, &buf[0], unsigned(rsz)) == int(rsz));
+                ok = (gzclose(gz) == Z_OK) && ok && !ferror(in);
+            }
+        }
+#endif
+#if defined(__ZSTD__)
+        if (compress == LcZstd)
+        {
+            FILE* out = fopen(dest.c_str(), "wb");
+            ZSTD_CCtx* cctx = ZSTD_createCCtx();
+            if (out != NULL && cctx != NULL)
+            {
+                ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level > 0 ? level : 3);
+                std::vector<char> obuf(ZSTD_CStreamOutSize());
+                ok = true;
+                bool last = false;
+                while (ok && !last)
+                {
+                    size_t rsz = fread(&buf[0], 1, buf.size(), in);
+                    last = (rsz < buf.size());
+                    ZSTD_inBuffer input = { &buf[0], rsz, 0 };
+                    bool finished = false;
+                    while (ok && !finished)
+                    {
+                        ZSTD_outBuffer output = { &obuf[0], obuf.size(), 0 };
+                        size_t remaining = ZSTD_compressStream2(cctx, &output, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+                        ok = !ZSTD_isError(remaining) && fwrite(&obuf[0], 1, output.pos, out) == output.pos;
+                        finished = last ? (remaining == 0) : (input.pos == input.size);
+                    }
+                }
+                ok = ok && !ferror(in);
+            }
+            if (cctx != NULL)
+                ZSTD_freeCCtx(cctx);
+            if (out != NULL && fclose(out) != 0)
+                ok = false;
+        }
+#endif
+        fclose(in);
+
+        if (!ok)
+        {
+            ::remove(dest.c_str());
+            return false;
+        }
+        ::remove(source.c_str());
+        return true;
+    }
+};
@@ -0,0 +1,92 @@
+#ifndef _LOGROTATOR_HPP_
+#define _LOGROTATOR_HPP_
+
+#include <string>
+#include "thread/KEventObject.h"
+/**
+日志备份线程，在后台创建目录、移动备份文件并按需压缩，写日志的线程不等待
+压缩需要定义__ZLIB__(gzip) 或__ZSTD__(zstd) 并链接对应的库，未定义时只移动不压缩
+线程以低优先级运行(linux 下降低CPU 和IO 优先级)
+**/
+namespace klib {
+    enum LogCompress
+    {
+        LcNone = 0,
+        LcGzip = 1,
+        LcZstd = 2
+    };
+
+    struct RotateTask
+    {
+        std::string source;
+        std::string target;
+    };
+
+    class KLogRotator :public KEventObject<RotateTask>
+    {
+    public:
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: compress 压缩方式，不支持时不压缩
+        * Parameter: level 压缩级别，0 为默认级别
+        *************************************/
+        KLogRotator(LogCompress compress = LcNone, int level = 0);
+
+        ~KLogRotator();
+
+        /************************************
+        * Method:    处理完队列中的任务后停止
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    投递备份任务
+        * Returns:   未运行或队列满返回false，调用者应自行同步备份
+        * Parameter: source 当前文件，已关闭
+        * Parameter: target 备份路径，所在目录不存在时创建
+        *************************************/
+        bool Rotate(const std::string& source, const std::string& target);
+
+        /************************************
+        * Method:    压缩文件，成功后删除原文件
+        * Returns:   成功返回true，不支持的压缩方式返回false
+        * Parameter: source 原文件
+        * Parameter: compress 压缩方式
+        * Parameter: level 压缩级别
+        * Parameter: dest 压缩后的文件
+        *************************************/
+        static bool Compress(const std::string& source, LogCompress compress, int level, std::string& dest);
+
+        /************************************
+        * Method:    压缩方式对应的文件后缀
+        * Returns:
+        * Parameter: compress
+        *************************************/
+        static const char* GetExtension(LogCompress compress);
+
+    protected:
+        virtual void ProcessEvent(const RotateTask& ev);
+
+    private:
+        /************************************
+        * Method:    移动并压缩一个文件
+        * Returns:
+        * Parameter: task
+        *************************************/
+        void Execute(const RotateTask& task);
+
+        /************************************
+        * Method:    降低当前线程的CPU 和IO 优先级
+        * Returns:
+        *************************************/
+        static void LowerPriority();
+
+    private:
+        LogCompress m_compress;
+        int m_level;
+        bool m_lowered;
+    };
+};
+#endif // !_LOGROTATOR_HPP_
@@ -0,0 +1,422 @@
+#include "util/KMappedLog.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "thread/KAtomic.h"
+#include "util/KTime.h"
+#include "util/KTextFile.hpp"
+#if !defined(WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+namespace klib {
+    static const uint32_t SegmentMagic = 0x4B534547;
+    static const uint32_t SegmentVersion = 1;
+    // 序号宽度固定，保证按文件名排序即写入顺序 //
+    static const size_t SegmentNameLength = 14 + 1 + 6;
+
+    static inline size_t Align8(size_t sz)
+    {
+        return (sz + 7) & ~size_t(7);
+    }
+
+    static inline size_t PageSize()
+    {
+#if defined(WIN32)
+        return 4096;
+#else
+        static size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        return pageSize;
+#endif
+    }
+
+    KMappedLog::KMappedLog(size_t maxsize, uint16_t duration)
+        :m_maxSize(maxsize * 1024 * 1024), m_duration(duration > 0 ? duration : 1), m_sequence(0),
+        m_fd(-1), m_base(NULL), m_header(NULL), m_capacity(0), m_offset(0),
+        m_lastSecond(0), m_currentMinute(-1), m_nowMinute(0),
+        m_syncInterval(1000), m_lastSync(0), m_syncedOffset(0)
+    {
+        if (m_maxSize < PageSize())
+            m_maxSize = PageSize();
+        // 偏移按32位保存 //
+        if (m_maxSize > 0x7FFFFFFF)
+            m_maxSize = 0x7FFFFFFF;
+        memset(&m_lastTime, 0, sizeof(m_lastTime));
+    }
+
+    KMappedLog::~KMappedLog()
+    {
+        Close();
+    }
+
+    void KMappedLog::GetSegmentPattern(const std::string& filename, std::string& prefix, std::string& suffix)
+    {
+        std::string baseName;
+        suffix.clear();
+        KTextFile::GetFileBaseName(filename, suffix, baseName);
+        prefix = baseName + "_";
+    }
+
+    bool KMappedLog::Initialize(const std::string& path, const std::string& filename)
+    {
+#if defined(WIN32)
+        return false;
+#else
+        Close();
+        if (filename.empty() || (!path.empty() && !KTextFile::Mkdir(path)))
+            return false;
+
+        m_path = path;
+        GetSegmentPattern(filename, m_prefix, m_suffix);
+        uint64_t now = 0;
+        KTime::NowMicrosecond(now);
+        return OpenSegment(now, m_maxSize);
+#endif
+    }
+
+    void KMappedLog::Close()
+    {
+        SealSegment();
+    }
+
+    bool KMappedLog::CheckMinute(uint64_t now)
+    {
+        time_t sec = time_t(now / 1000000);
+        if (sec != m_lastSecond)
+        {
+            m_lastSecond = sec;
+#if defined(WIN32)
+            localtime_s(&m_lastTime, &sec);
+#else
+            localtime_r(&sec, &m_lastTime);
+#endif
+        }
+        // 跨小时或跨天的相同分钟也要新建段 //
+        m_nowMinute = ((m_lastTime.tm_year * 366 + m_lastTime.tm_yday) * 24 + m_lastTime.tm_hour) * 60
+            + m_lastTime.tm_min / m_duration * m_duration;
+        return m_nowMinute != m_currentMinute;
+    }
+
+    bool KMappedLog::OpenSegment(uint64_t now, size_t capacity)
+    {
+#if defined(WIN32)
+        return false;
+#else
+        CheckMinute(now);
+        m_currentMinute = m_nowMinute;
+        capacity = (capacity + PageSize() - 1) / PageSize() * PageSize();
+
+        char stamp[32] = { 0 };
+        strftime(stamp, sizeof(stamp), "%Y%m%d%H%M%S", &m_lastTime);
+        // 同一秒内多次新建或其他进程已创建同名段时序号递增 //
+        int fd = -1;
+        std::string filePath;
+        for (int tries = 0; tries < 1000000 && fd < 0; ++tries)
+        {
+            char seq[16] = { 0 };
+            sprintf(seq, "_%06u", m_sequence % 1000000);
+            ++m_sequence;
+            filePath = m_path + PathSeparator + m_prefix + stamp + seq + m_suffix;
+            fd = open(filePath.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+            if (fd < 0 && errno != EEXIST)
+                break;
+        }
+        if (fd < 0)
+        {
+            printf("Create log segment [%s] failed:[%s]\n", filePath.c_str(), strerror(errno));
+            return false;
+        }
+
+        // 预分配磁盘空间，写入映射区时不会因空间不足产生SIGBUS //
+        int rc = -1;
+#if defined(LINUX)
+        rc = posix_fallocate(fd, 0, off_t(capacity));
+#endif
+        if (rc != 0 && ftruncate(fd, off_t(capacity)) != 0)
+        {
+            printf("Allocate log segment [%s] failed:[%s]\n", filePath.c_str(), strerror(errno));
+            close(fd);
+            unlink(filePath.c_str());
+            return false;
+        }
+
+        void* base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            printf("mmap log segment [%s] failed:[%s]\n", filePath.c_str(), strerror(errno));
+            close(fd);
+            unlink(filePath.c_str());
+            return false;
+        }
+
+        m_fd = fd;
+        m_base = static_cast<char*>(base);
+        m_header = reinterpret_cast<MappedSegmentHeader*>(m_base);
+        m_capacity = capacity;
+        m_offset = sizeof(MappedSegmentHeader);
+        m_syncedOffset = 0;
+        m_lastSync = now / 1000;
+        m_filePath = filePath;
+
+        m_header->headerSize = uint32_t(sizeof(MappedSegmentHeader));
+        m_header->version = SegmentVersion;
+        m_header->capacity = uint32_t(capacity);
+        m_header->createTime = now;
+        m_header->sealed = 0;
+        m_header->committed = uint32_t(m_offset);
+        // 读者以magic 判断段头已写好 //
+        AtomicFence(MoRelease);
+        m_header->magic = SegmentMagic;
+        return true;
+#endif
+    }
+
+    void KMappedLog::SealSegment()
+    {
+#if !defined(WIN32)
+        if (m_header == NULL)
+            return;
+
+        AtomicFence(MoRelease);
+        m_header->sealed = 1;
+        msync(m_base, m_capacity, MS_ASYNC);
+        munmap(m_base, m_capacity);
+        // 截去未使用的预分配空间，读者只访问已提交的部分 //
+        if (ftruncate(m_fd, off_t(m_offset)) != 0)
+            printf("Truncate log segment [%s] failed:[%s]\n", m_filePath.c_str(), strerror(errno));
+        close(m_fd);
+
+        m_fd = -1;
+        m_base = NULL;
+        m_header = NULL;
+        m_capacity = 0;
+        m_offset = 0;
+#endif
+    }
+
+    bool KMappedLog::Write(const void* dat, size_t sz)
+    {
+        if (m_header == NULL || sz > 0x7FFFF000)
+            return false;
+
+        uint64_t now = 0;
+        KTime::NowMicrosecond(now);
+        size_t recSize = Align8(sizeof(MappedRecordHeader) + sz);
+        bool rotate = (m_offset + recSize > m_capacity);
+        if (!rotate && m_offset > sizeof(MappedSegmentHeader))
+            rotate = CheckMinute(now);
+
+        if (rotate)
+        {
+            SealSegment();
+            size_t capacity = sizeof(MappedSegmentHeader) + recSize;
+            if (!OpenSegment(now, capacity > m_maxSize ? capacity : m_maxSize))
+                return false;
+        }
+
+        MappedRecordHeader* rec = reinterpret_cast<MappedRecordHeader*>(m_base + m_offset);
+        rec->length = uint32_t(sz);
+        rec->reserved = 0;
+        rec->timestamp = now;
+        memcpy(rec + 1, dat, sz);
+        m_offset += recSize;
+        // 数据写完后才发布偏移 //
+        AtomicFence(MoRelease);
+        m_header->committed = uint32_t(m_offset);
+
+        if (m_syncInterval > 0 && now / 1000 - m_lastSync >= uint64_t(m_syncInterval))
+            Sync(false);
+        return true;
+    }
+
+    void KMappedLog::Sync(bool wait)
+    {
+#if !defined(WIN32)
+        if (m_header == NULL)
+            return;
+
+        KTime::NowMillisecond(m_lastSync);
+        size_t begin = m_syncedOffset / PageSize() * PageSize();
+        if (m_offset > begin)
+        {
+            msync(m_base + begin, m_offset - begin, wait ? MS_SYNC : MS_ASYNC);
+            m_syncedOffset = m_offset;
+        }
+#endif
+    }
+
+    KMappedLogReader::KMappedLogReader()
+        :m_fd(-1), m_base(NULL), m_header(NULL), m_mapSize(0), m_offset(0)
+    {
+    }
+
+    KMappedLogReader::~KMappedLogReader()
+    {
+        Close();
+    }
+
+    bool KMappedLogReader::Open(const std::string& path, const std::string& filename, bool fromLatest)
+    {
+#if defined(WIN32)
+        return false;
+#else
+        Close();
+        m_path = path;
+        KMappedLog::GetSegmentPattern(filename, m_prefix, m_suffix);
+
+        std::vector<std::string> names;
+        ListSegments(names);
+        if (names.empty())
+            return true;
+
+        // 从最新段的已提交位置开始，之前的记录不再读取 //
+        if (!MapSegment(fromLatest ? names.back() : names.front()))
+            return false;
+        if (fromLatest)
+        {
+            m_offset = m_header->committed;
+            AtomicFence(MoAcquire);
+        }
+        return true;
+#endif
+    }
+
+    void KMappedLogReader::Close()
+    {
+        UnmapSegment();
+        m_name.clear();
+        m_filePath.clear();
+    }
+
+    void KMappedLogReader::ListSegments(std::vector<std::string>& names) const
+    {
+        names.clear();
+#if !defined(WIN32)
+        DIR* dir = opendir(m_path.empty() ? "." : m_path.c_str());
+        if (dir == NULL)
+            return;
+
+        struct dirent* ent = NULL;
+        while ((ent = readdir(dir)) != NULL)
+        {
+            std::string name(ent->d_name);
+            if (name.size() == m_prefix.size() + SegmentNameLength + m_suffix.size()
+                && name.compare(0, m_prefix.size(), m_prefix) == 0
+                && name.compare(name.size() - m_suffix.size(), m_suffix.size(), m_suffix) == 0)
+                names.push_back(name);
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+#endif
+    }
+
+    bool KMappedLogReader::MapSegment(const std::string& name)
+    {
+#if defined(WIN32)
+        return false;
+#else
+        std::string filePath = m_path + PathSeparator + name;
+        int fd = open(filePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        // 写者还没有预分配或写好段头时稍后重试 //
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(MappedSegmentHeader))
+        {
+            close(fd);
+            return false;
+        }
+
+        size_t mapSize = size_t(st.st_size);
+        void* base = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+
+        const MappedSegmentHeader* header = static_cast<const MappedSegmentHeader*>(base);
+        bool ready = (header->magic == SegmentMagic);
+        AtomicFence(MoAcquire);
+        if (!ready || header->version != SegmentVersion)
+        {
+            if (ready)
+                printf("Log segment [%s] version:[%u] not supported\n", filePath.c_str(), header->version);
+            munmap(base, mapSize);
+            close(fd);
+            return false;
+        }
+
+        UnmapSegment();
+        m_fd = fd;
+        m_base = static_cast<const char*>(base);
+        m_header = header;
+        m_mapSize = mapSize;
+        m_offset = header->headerSize;
+        m_name = name;
+        m_filePath = filePath;
+        return true;
+#endif
+    }
+
+    void KMappedLogReader::UnmapSegment()
+    {
+#if !defined(WIN32)
+        if (m_base == NULL)
+            return;
+        munmap(const_cast<char*>(m_base), m_mapSize);
+        close(m_fd);
+        m_fd = -1;
+        m_base = NULL;
+        m_header = NULL;
+        m_mapSize = 0;
+        m_offset = 0;
+#endif
+    }
+
+    bool KMappedLogReader::NextSegment()
+    {
+        std::vector<std::string> names;
+        ListSegments(names);
+        std::vector<std::string>::iterator it = std::upper_bound(names.begin(), names.end(), m_name);
+        return it != names.end() && MapSegment(*it);
+    }
+
+    bool KMappedLogReader::Read(std::string& dat, uint64_t& timestamp)
+    {
+        for (;;)
+        {
+            if (m_header == NULL && !NextSegment())
+                return false;
+
+            size_t committed = m_header->committed;
+            AtomicFence(MoAcquire);
+            if (committed > m_mapSize)
+                committed = m_mapSize;
+
+            if (m_offset + sizeof(MappedRecordHeader) <= committed)
+            {
+                const MappedRecordHeader* rec = reinterpret_cast<const MappedRecordHeader*>(m_base + m_offset);
+                dat.assign(reinterpret_cast<const char*>(rec + 1), rec->length);
+                timestamp = rec->timestamp;
+                m_offset += Align8(sizeof(MappedRecordHeader) + rec->length);
+                return true;
+            }
+
+            // 封存后不会再有新记录，再确认一次已提交位置后切换到下一段 //
+            bool sealed = (m_header->sealed != 0);
+            AtomicFence(MoAcquire);
+            if (!sealed)
+                return false;
+            if (m_header->committed > m_offset)
+                continue;
+            if (!NextSegment())
+                return false;
+        }
+    }
+};
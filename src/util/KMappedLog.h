@@ -0,0 +1,224 @@
+#ifndef _MAPPEDLOG_HPP_
+#define _MAPPEDLOG_HPP_
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+/**
+内存映射的只追加日志段，用于按原始字节保存报文，不经过stdio 缓存，也不转换成16进制
+每个段创建时预分配文件空间并整段映射，写入即memcpy 到映射区，再发布已提交的偏移
+段写满或到达备份间隔时封存并新建下一段，封存时截去未用的预分配空间
+段文件名为 名称_yyyymmddhhnnss_序号.后缀，按文件名排序即写入顺序
+读者可以在其他进程中同时跟踪读取，只读已提交的部分，当前段封存后自动切换到下一段
+暂不支持WIN32
+**/
+namespace klib {
+    /**
+    段文件头，后面是按8字节对齐的记录，记录头后面是数据
+    **/
+    struct MappedSegmentHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerSize;
+        // 段的映射大小 //
+        uint32_t capacity;
+        // 已提交的结束偏移，写者在数据拷贝完成后更新 //
+        volatile uint32_t committed;
+        // 0:写入中 1:已封存 //
+        volatile uint32_t sealed;
+        uint64_t createTime;
+        char padding[32];
+    };
+
+    struct MappedRecordHeader
+    {
+        uint32_t length;
+        uint32_t reserved;
+        uint64_t timestamp;
+    };
+
+    class KMappedLog
+    {
+    public:
+        /************************************
+        * Method:    构造
+        * Returns:
+        * Parameter: maxsize 单个段最大MB
+        * Parameter: duration 备份间隔分钟
+        *************************************/
+        KMappedLog(size_t maxsize = 50, uint16_t duration = 5);
+
+        ~KMappedLog();
+
+        /************************************
+        * Method:    初始化并创建第一个段
+        * Returns:   成功返回true
+        * Parameter: path 路径
+        * Parameter: filename 文件名
+        *************************************/
+        bool Initialize(const std::string& path, const std::string& filename);
+
+        /************************************
+        * Method:    封存当前段并关闭
+        * Returns:
+        *************************************/
+        void Close();
+
+        /************************************
+        * Method:    写入一条记录
+        * Returns:   成功返回true
+        * Parameter: dat 数据
+        * Parameter: sz 长度，超过段大小时单独创建一个足够大的段
+        *************************************/
+        bool Write(const void* dat, size_t sz);
+
+        /************************************
+        * Method:    设置异步刷盘的间隔，写入时距离上次超过间隔则对新写入的部分发起msync(MS_ASYNC)
+        * Returns:
+        * Parameter: ms 毫秒，0 表示不主动刷盘
+        *************************************/
+        inline void SetSyncInterval(int ms) { m_syncInterval = (ms > 0 ? ms : 0); }
+
+        /************************************
+        * Method:    把已写入的部分刷到磁盘
+        * Returns:
+        * Parameter: wait 是否等待完成
+        *************************************/
+        void Sync(bool wait);
+
+        inline std::string GetFilePath() const { return m_filePath; }
+
+        /************************************
+        * Method:    段文件名的前缀和后缀
+        * Returns:
+        * Parameter: filename 文件名
+        * Parameter: prefix 前缀
+        * Parameter: suffix 后缀
+        *************************************/
+        static void GetSegmentPattern(const std::string& filename, std::string& prefix, std::string& suffix);
+
+    private:
+        KMappedLog(const KMappedLog&);
+        KMappedLog& operator=(const KMappedLog&);
+
+        /************************************
+        * Method:    新建并映射一个段
+        * Returns:   成功返回true
+        * Parameter: now 微秒
+        * Parameter: capacity 段大小
+        *************************************/
+        bool OpenSegment(uint64_t now, size_t capacity);
+
+        /************************************
+        * Method:    封存并解除映射当前段
+        * Returns:
+        *************************************/
+        void SealSegment();
+
+        /************************************
+        * Method:    判断是否到达备份间隔，每秒计算一次
+        * Returns:   需要新建段返回true
+        * Parameter: now 微秒
+        *************************************/
+        bool CheckMinute(uint64_t now);
+
+    private:
+        size_t m_maxSize;
+        uint16_t m_duration;
+        std::string m_path;
+        std::string m_prefix;
+        std::string m_suffix;
+        std::string m_filePath;
+        uint32_t m_sequence;
+
+        int m_fd;
+        char* m_base;
+        MappedSegmentHeader* m_header;
+        size_t m_capacity;
+        size_t m_offset;
+
+        time_t m_lastSecond;
+        // 当前段和当前时间所在的备份间隔 //
+        int m_currentMinute;
+        int m_nowMinute;
+        struct tm m_lastTime;
+
+        int m_syncInterval;
+        uint64_t m_lastSync;
+        size_t m_syncedOffset;
+    };
+
+    /**
+    段读取，一个读者只在一个线程中使用
+    **/
+    class KMappedLogReader
+    {
+    public:
+        KMappedLogReader();
+
+        ~KMappedLogReader();
+
+        /************************************
+        * Method:    打开日志
+        * Returns:   还没有段文件返回true，之后Read 时再查找
+        * Parameter: path 路径
+        * Parameter: filename 写者的文件名
+        * Parameter: fromLatest true 从最新的段末尾开始跟踪，false 从最早的段开始读
+        *************************************/
+        bool Open(const std::string& path, const std::string& filename, bool fromLatest = false);
+
+        void Close();
+
+        /************************************
+        * Method:    读取下一条记录
+        * Returns:   暂时没有新记录返回false
+        * Parameter: dat 数据
+        * Parameter: timestamp 写入时间，微秒
+        *************************************/
+        bool Read(std::string& dat, uint64_t& timestamp);
+
+        inline std::string GetFilePath() const { return m_filePath; }
+
+    private:
+        KMappedLogReader(const KMappedLogReader&);
+        KMappedLogReader& operator=(const KMappedLogReader&);
+
+        /************************************
+        * Method:    列出所有段文件，按名称排序
+        * Returns:
+        * Parameter: names 文件名
+        *************************************/
+        void ListSegments(std::vector<std::string>& names) const;
+
+        /************************************
+        * Method:    映射段文件
+        * Returns:   成功返回true
+        * Parameter: name 文件名
+        *************************************/
+        bool MapSegment(const std::string& name);
+
+        void UnmapSegment();
+
+        /************************************
+        * Method:    切换到当前段之后的段
+        * Returns:   没有更新的段返回false
+        *************************************/
+        bool NextSegment();
+
+    private:
+        std::string m_path;
+        std::string m_prefix;
+        std::string m_suffix;
+        std::string m_name;
+        std::string m_filePath;
+
+        int m_fd;
+        const char* m_base;
+        const MappedSegmentHeader* m_header;
+        size_t m_mapSize;
+        size_t m_offset;
+    };
+};
+#endif // !_MAPPEDLOG_HPP_
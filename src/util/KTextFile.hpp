@@ -5,9 +5,14 @@
 #ifdef WIN32
 #include <Windows.h>
 #include <io.h> // access
+#include <direct.h> // _mkdir
+#include <errno.h>
 #define PathSeparator '\\'
 #else
 #include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
 #if defined(HPUX)
 #include <sys/vfs.h>
 #else
@@ -19,11 +24,14 @@
 #include <stdint.h>
 #include <cstdarg>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "thread/KError.h"
 #include "thread/KBuffer.h"
 #include "thread/KAny.h"
 #include "thread/KEventObject.h"
 #include "util/KTime.h"
+#include "util/KLogRotator.h"
 /**
 日志文件类
 **/
@@ -81,7 +89,7 @@ namespace klib {
     public:
         KTextFile(size_t maxsize = 50/*mb*/, uint16_t duration = 5/*minute*/)
             :m_file(NULL), m_hexBuffer(HexBufferSize),
-            m_maxSize(maxsize * 1024 * 1024), m_totalSize(0), m_duration(duration)
+            m_maxSize(maxsize * 1024 * 1024), m_totalSize(0), m_duration(duration), m_rotator(NULL), m_sequence(0)
         {
 
 
@@ -138,6 +146,16 @@ namespace klib {
             }
         }
 
+        /************************************
+        * Method:    设置备份线程，备份时在后台移动和压缩文件，为NULL 时在当前线程移动
+        * Returns:   
+        * Parameter: rotator 备份线程，生命周期长于文件对象
+        *************************************/
+        inline void SetRotator(KLogRotator* rotator)
+        {
+            m_rotator = rotator;
+        }
+
         /************************************
         * Method:    获取文件路径
         * Returns:   
@@ -318,20 +336,30 @@ namespace klib {
             {
                 return true;
             }
+
+            // 逐级创建，不启动shell //
+            for (size_t pos = 1; pos <= path.size(); ++pos)
+            {
+                if (pos < path.size() && path[pos] != '/' && path[pos] != '\\')
+                {
+                    continue;
+                }
+
+                std::string dir = path.substr(0, pos);
+                if (IsExist(dir))
+                {
+                    continue;
+                }
 #ifdef WIN32
-            if (Exec(std::string("mkdir ") + path))
+                if (_mkdir(dir.c_str()) != 0 && errno != EEXIST)
 #else
-            if (Exec(std::string("mkdir -p ") + path))
+                if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
 #endif
-            {
-                int i = 3;
-                while (!IsExist(path) && i-- > 0)
                 {
-                    KTime::MSleep(50);
+                    return false;
                 }
-                return i > 0;
             }
-            return false;
+            return true;
         }
 
         /************************************
@@ -451,16 +479,32 @@ namespace klib {
                 // rename current file
                 GetFileBaseName(m_currentName, suffix, baseName);
                 std::string newPath = m_path + PathSeparator + dateStr.substr(0, dateStr.size() - 2);
-                if (!IsExist(newPath))
-                    Mkdir(newPath);
                 std::string newFilePath = newPath + PathSeparator + baseName + "_" + dateStr + (suffix.empty() ? "" : suffix);
                 std::string currentFilePath = m_path + PathSeparator + m_currentName;
-                ::rename(currentFilePath.c_str(), newFilePath.c_str());
+                // 备份线程队列满时在当前线程移动 //
+                if (m_rotator == NULL || !m_rotator->Rotate(currentFilePath, newFilePath))
+                {
+                    if (!IsExist(newPath))
+                        Mkdir(newPath);
+                    ::rename(currentFilePath.c_str(), newFilePath.c_str());
+                }
             }
 
             // set new name for file
             GetFileBaseName(m_seedName, suffix, baseName);
-            m_currentName = baseName + "_" + dateStr + (suffix.empty() ? "" : suffix);
+            // 同一秒内多次备份时加序号，新文件不会与正在备份的文件同名 //
+            m_sequence = (dateStr == m_lastDateStr ? m_sequence + 1 : 0);
+            m_lastDateStr = dateStr;
+            if (m_sequence > 0)
+            {
+                char seq[16] = { 0 };
+                sprintf(seq, "_%u", m_sequence);
+                m_currentName = baseName + "_" + dateStr + seq + (suffix.empty() ? "" : suffix);
+            }
+            else
+            {
+                m_currentName = baseName + "_" + dateStr + (suffix.empty() ? "" : suffix);
+            }
             m_currentMinute = minute;
             m_filePath = m_path + PathSeparator + m_currentName;
         }
@@ -516,6 +560,9 @@ namespace klib {
 
         uint16_t m_currentMinute;
         uint16_t m_duration;
+        KLogRotator* m_rotator;
+        std::string m_lastDateStr;
+        uint32_t m_sequence;
     private:
         KBuffer m_hexBuffer;
     };
@@ -706,5 +753,409 @@ namespace klib {
         KTextFile m_file;
         bool m_timestamp;
     };
+
+    /*
+    批量写入的，和TextFile类功能一样，非线程安全
+    日志先追加到对齐的缓存，缓存达到阈值或超过刷新间隔时一次write 写入文件，
+    文件大小和时间的备份判断在每批写入前做一次，一批日志写入同一个文件
+    */
+    enum FileSyncMode
+    {
+        // 只写入系统缓存，由系统决定何时落盘 //
+        FsNone = 0,
+        // 每条日志立即写入并落盘 //
+        FsRecord = 1,
+        // 每批写入后落盘 //
+        FsBatch = 2,
+        // 写入后距离上次落盘超过间隔时落盘 //
+        FsPeriodic = 3
+    };
+
+    class KTextFileBatch :public KTextFile
+    {
+    public:
+        KTextFileBatch(size_t maxsize = 50/*mb*/, uint16_t duration = 5/*minute*/, size_t bufferSize = 1024 * 1024)
+            :KTextFile(maxsize, duration), m_buffer(NULL), m_capacity(bufferSize < 4096 ? 4096 : bufferSize),
+            m_size(0), m_threshold(m_capacity), m_flushInterval(1000), m_lastFlush(0),
+            m_syncMode(FsNone), m_syncInterval(1000), m_lastSync(0), m_dirty(false), m_writeCalls(0),
+            m_dateFormat("yyyymmddhhnnssccc  ")
+        {
+            m_capacity = (m_capacity + 4095) / 4096 * 4096;
+        }
+
+        ~KTextFileBatch()
+        {
+            Close();
+            if (m_buffer != NULL)
+            {
+#ifdef WIN32
+                _aligned_free(m_buffer);
+#else
+                free(m_buffer);
+#endif
+                m_buffer = NULL;
+            }
+        }
+
+        virtual void Initialize(const std::string& path, const std::string& filename, bool timestamp = false)
+        {
+            if (m_buffer == NULL)
+            {
+                // 按页对齐，便于内核直接拷贝 //
+#ifdef WIN32
+                m_buffer = static_cast<char*>(_aligned_malloc(m_capacity, 4096));
+#else
+                void* buf = NULL;
+                if (posix_memalign(&buf, 4096, m_capacity) == 0)
+                    m_buffer = static_cast<char*>(buf);
+#endif
+            }
+            m_size = 0;
+            KTime::NowMillisecond(m_lastFlush);
+            m_lastSync = m_lastFlush;
+            KTextFile::Initialize(path, filename, timestamp);
+        }
+
+        /************************************
+        * Method:    写入缓存的日志后关闭文件
+        * Returns:   
+        *************************************/
+        virtual void Close()
+        {
+            Flush();
+            if (m_file && m_dirty)
+                Sync();
+            KTextFile::Close();
+        }
+
+        /************************************
+        * Method:    设置批量写入的条件
+        * Returns:   
+        * Parameter: threshold 缓存达到的字节数，超过缓存大小时取缓存大小
+        * Parameter: ms 距离上次写入的毫秒
+        *************************************/
+        void SetFlushPolicy(size_t threshold, int ms)
+        {
+            m_threshold = (threshold == 0 || threshold > m_capacity ? m_capacity : threshold);
+            m_flushInterval = (ms > 0 ? ms : 0);
+        }
+
+        /************************************
+        * Method:    设置落盘方式
+        * Returns:   
+        * Parameter: mode 落盘方式
+        * Parameter: ms FsPeriodic 的落盘间隔毫秒
+        *************************************/
+        void SetSyncMode(FileSyncMode mode, int ms = 1000)
+        {
+            m_syncMode = mode;
+            m_syncInterval = (ms > 0 ? ms : 0);
+        }
+
+        /************************************
+        * Method:    写入数据
+        * Returns:   写入缓存的字节数
+        * Parameter: format
+        * Parameter: 
+        *************************************/
+        size_t WriteString(const char* format, ...)
+        {
+            if (!(format && strlen(format) > 0) || m_buffer == NULL)
+            {
+                return 0;
+            }
+
+            if (m_timestamp)
+            {
+                Reserve(m_dateFormat.Length() + 1);
+                m_size += KTime::NowDateTime(m_dateFormat, m_buffer + m_size);
+            }
+
+            // 先直接格式化到缓存尾部，放不下时写出缓存后重试 //
+            va_list args;
+            va_start(args, format);
+            int rsz = vsnprintf(m_buffer + m_size, m_capacity - m_size, format, args);
+            va_end(args);
+            if (rsz < 0)
+            {
+                return 0;
+            }
+
+            if (size_t(rsz) >= m_capacity - m_size)
+            {
+                std::string line(size_t(rsz) + 1, '\0');
+                va_start(args, format);
+                vsnprintf(&line[0], line.size(), format, args);
+                va_end(args);
+                line.resize(size_t(rsz));
+                return Append(line.c_str(), line.size()) + (m_timestamp ? m_dateFormat.Length() : 0);
+            }
+
+            m_size += size_t(rsz);
+            AfterAppend();
+            return size_t(rsz) + (m_timestamp ? m_dateFormat.Length() : 0);
+        }
+
+        /************************************
+        * Method:    按16进制写入数据
+        * Returns:   
+        * Parameter: dat
+        * Parameter: sz
+        *************************************/
+        size_t WriteHexString(const char* dat, size_t sz)
+        {
+            char dst[HexBufferSize];
+            std::string hex;
+            ToHexString(dat, sz, dst, hex);
+            return WriteString("%s", hex.c_str());
+        }
+
+        /************************************
+        * Method:    追加已经格式化的数据，不加时间
+        * Returns:   
+        * Parameter: dat
+        * Parameter: sz
+        *************************************/
+        size_t Append(const char* dat, size_t sz)
+        {
+            if (m_buffer == NULL || sz == 0)
+            {
+                return 0;
+            }
+
+            // 大于缓存的数据和缓存一起写出，不再拷贝 //
+            if (sz > m_capacity - m_size)
+            {
+                if (sz >= m_capacity)
+                {
+                    WriteBatch(dat, sz);
+                    return sz;
+                }
+                WriteBatch(NULL, 0);
+            }
+
+            memcpy(m_buffer + m_size, dat, sz);
+            m_size += sz;
+            AfterAppend();
+            return sz;
+        }
+
+        /************************************
+        * Method:    把缓存写入文件
+        * Returns:   
+        *************************************/
+        void Flush()
+        {
+            if (m_size > 0)
+            {
+                WriteBatch(NULL, 0);
+            }
+            else if (m_dirty && m_syncMode == FsPeriodic)
+            {
+                CheckSync();
+            }
+        }
+
+        /************************************
+        * Method:    缓存中的字节数
+        * Returns:   
+        *************************************/
+        inline size_t GetPending() const { return m_size; }
+
+        /************************************
+        * Method:    已调用write 的次数
+        * Returns:   
+        *************************************/
+        inline uint64_t GetWriteCalls() const { return m_writeCalls; }
+
+    private:
+        KTextFileBatch(const KTextFileBatch&);
+        KTextFileBatch& operator=(const KTextFileBatch&);
+
+        /************************************
+        * Method:    保证缓存剩余空间
+        * Returns:   
+        * Parameter: sz
+        *************************************/
+        inline void Reserve(size_t sz)
+        {
+            if (m_capacity - m_size < sz)
+            {
+                WriteBatch(NULL, 0);
+            }
+        }
+
+        /************************************
+        * Method:    追加后判断是否需要写出
+        * Returns:   
+        *************************************/
+        inline void AfterAppend()
+        {
+            if (m_syncMode == FsRecord || m_size >= m_threshold)
+            {
+                WriteBatch(NULL, 0);
+                return;
+            }
+
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            if (now - m_lastFlush >= uint64_t(m_flushInterval))
+            {
+                WriteBatch(NULL, 0);
+            }
+        }
+
+        /************************************
+        * Method:    写出缓存和附加数据
+        * Returns:   
+        * Parameter: extra 附加数据，可以为NULL
+        * Parameter: extraSize
+        *************************************/
+        void WriteBatch(const char* extra, size_t extraSize)
+        {
+            KTime::NowMillisecond(m_lastFlush);
+            if (m_size + extraSize == 0)
+            {
+                return;
+            }
+
+            // 文件被删除了，需要重新打开
+            if (!IsExist(m_filePath) && m_file)
+            {
+                CloseFile();
+            }
+
+            std::string dateStr;
+            DateTime date;
+            CheckBackUp(dateStr, date);
+
+            if (!m_file && !Open("ab+"))
+            {
+                m_size = 0;
+                return;
+            }
+
+            size_t total = m_size + extraSize;
+            if (WriteAll(extra, extraSize))
+            {
+                m_totalSize += total;
+                m_dirty = true;
+                if (m_syncMode == FsRecord || m_syncMode == FsBatch)
+                    Sync();
+                else if (m_syncMode == FsPeriodic)
+                    CheckSync();
+            }
+            m_size = 0;
+        }
+
+        /************************************
+        * Method:    写出缓存和附加数据，处理部分写入
+        * Returns:   
+        * Parameter: extra
+        * Parameter: extraSize
+        *************************************/
+        bool WriteAll(const char* extra, size_t extraSize)
+        {
+#ifdef WIN32
+            int fd = _fileno(m_file);
+            const char* parts[2] = { m_buffer, extra };
+            size_t sizes[2] = { m_size, extraSize };
+            for (int i = 0; i < 2; ++i)
+            {
+                size_t off = 0;
+                while (off < sizes[i])
+                {
+                    ++m_writeCalls;
+                    int rc = _write(fd, parts[i] + off, unsigned(sizes[i] - off));
+                    if (rc <= 0)
+                        return false;
+                    off += size_t(rc);
+                }
+            }
+            return true;
+#else
+            int fd = fileno(m_file);
+            struct iovec iov[2];
+            iov[0].iov_base = m_buffer;
+            iov[0].iov_len = m_size;
+            iov[1].iov_base = const_cast<char*>(extra);
+            iov[1].iov_len = extraSize;
+            struct iovec* cur = (m_size > 0 ? iov : iov + 1);
+            int cnt = (m_size > 0 ? 1 : 0) + (extraSize > 0 ? 1 : 0);
+            while (cnt > 0)
+            {
+                ++m_writeCalls;
+                ssize_t rc = writev(fd, cur, cnt);
+                if (rc < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+
+                size_t done = size_t(rc);
+                while (cnt > 0 && done >= cur->iov_len)
+                {
+                    done -= cur->iov_len;
+                    ++cur;
+                    --cnt;
+                }
+                if (cnt > 0)
+                {
+                    cur->iov_base = static_cast<char*>(cur->iov_base) + done;
+                    cur->iov_len -= done;
+                }
+            }
+            return true;
+#endif
+        }
+
+        /************************************
+        * Method:    距离上次落盘超过间隔时落盘
+        * Returns:   
+        *************************************/
+        inline void CheckSync()
+        {
+            uint64_t now = 0;
+            KTime::NowMillisecond(now);
+            if (now - m_lastSync >= uint64_t(m_syncInterval))
+            {
+                Sync();
+            }
+        }
+
+        /************************************
+        * Method:    数据落盘
+        * Returns:   
+        *************************************/
+        void Sync()
+        {
+            KTime::NowMillisecond(m_lastSync);
+            m_dirty = false;
+#ifdef WIN32
+            _commit(_fileno(m_file));
+#elif defined(LINUX)
+            fdatasync(fileno(m_file));
+#else
+            fsync(fileno(m_file));
+#endif
+        }
+
+    private:
+        char* m_buffer;
+        size_t m_capacity;
+        size_t m_size;
+        size_t m_threshold;
+        int m_flushInterval;
+        uint64_t m_lastFlush;
+
+        FileSyncMode m_syncMode;
+        int m_syncInterval;
+        uint64_t m_lastSync;
+        bool m_dirty;
+
+        uint64_t m_writeCalls;
+        KDateTimeFormat m_dateFormat;
+    };
 };
 #endif
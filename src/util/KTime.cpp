@@ -1,7 +1,171 @@
 #include "util/KTime.h"
 #include "thread/KError.h"
 #include "thread/KPthread.h"
+#include "thread/KSeqLock.h"
+#include <ctime>
 namespace klib {
+    // 最近一秒的本地时间，多数调用在同一秒内，避免localtime 的锁和时区检查 //
+    struct DateCache
+    {
+        int64_t second;
+        DateTime datetime;
+    };
+    static KSeqLock s_dateLock;
+    static DateCache s_dateCache = { -1, { 0, 0, 0, 0, 0, 0, 0 } };
+
+    static const char s_digitPairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    static inline void WriteDigits2(char* dst, uint32_t value)
+    {
+        memcpy(dst, s_digitPairs + (value % 100) * 2, 2);
+    }
+
+    // 每个线程缓存最近一次使用的格式，字符串格式的NowDateTime 通常反复使用同一格式 //
+    struct FormatCache
+    {
+        explicit FormatCache(const std::string& fmt)
+            :pattern(fmt), format(fmt)
+        {}
+
+        std::string pattern;
+        KDateTimeFormat format;
+    };
+    static pthread_once_t s_formatOnce = PTHREAD_ONCE_INIT;
+    static pthread_key_t s_formatKey;
+
+    static void ReleaseFormatCache(void* cache)
+    {
+        delete static_cast<FormatCache*>(cache);
+    }
+
+    static void CreateFormatKey()
+    {
+        pthread_key_create(&s_formatKey, &ReleaseFormatCache);
+    }
+
+    static const KDateTimeFormat& CachedFormat(const std::string& fmt)
+    {
+        pthread_once(&s_formatOnce, CreateFormatKey);
+        FormatCache* cache = static_cast<FormatCache*>(pthread_getspecific(s_formatKey));
+        if (cache == NULL)
+        {
+            cache = new FormatCache(fmt);
+            pthread_setspecific(s_formatKey, cache);
+        }
+        else if (cache->pattern != fmt)
+        {
+            *cache = FormatCache(fmt);
+        }
+        return cache->format;
+    }
+
+    KDateTimeFormat::KDateTimeFormat(const std::string& fmt)
+    {
+        static const char* keywords[] = { "yyyy", "mm", "dd", "hh", "nn", "ss", "ccc" };
+        size_t i = 0;
+        while (i < fmt.size())
+        {
+            bool matched = false;
+            for (uint16_t k = 0; k < sizeof(keywords) / sizeof(keywords[0]); ++k)
+            {
+                size_t len = strlen(keywords[k]);
+                if (fmt.compare(i, len, keywords[k]) == 0)
+                {
+                    Field field = { k, uint16_t(m_template.size()) };
+                    m_fields.push_back(field);
+                    m_template.append(len, '0');
+                    i += len;
+                    matched = true;
+                    break;
+                }
+            }
+            if (!matched)
+                m_template.push_back(fmt[i++]);
+        }
+    }
+
+    size_t KDateTimeFormat::Format(const DateTime& dt, char* buf) const
+    {
+        memcpy(buf, m_template.data(), m_template.size());
+        buf[m_template.size()] = 0;
+        for (size_t i = 0; i < m_fields.size(); ++i)
+        {
+            char* dst = buf + m_fields[i].offset;
+            switch (m_fields[i].type)
+            {
+            case FdYear:
+                WriteDigits2(dst, dt.year / 100);
+                WriteDigits2(dst + 2, dt.year);
+                break;
+            case FdMonth: WriteDigits2(dst, dt.month); break;
+            case FdDay: WriteDigits2(dst, dt.day); break;
+            case FdHour: WriteDigits2(dst, dt.hour); break;
+            case FdMinute: WriteDigits2(dst, dt.minute); break;
+            case FdSecond: WriteDigits2(dst, dt.second); break;
+            default:
+                dst[0] = char('0' + dt.milliSecond / 100 % 10);
+                WriteDigits2(dst + 1, dt.milliSecond);
+                break;
+            }
+        }
+        return m_template.size();
+    }
+
+    void KDateTimeFormat::Format(const DateTime& dt, std::string& out) const
+    {
+        out.resize(m_template.size() + 1);
+        out.resize(Format(dt, &out[0]));
+    }
+
+    void KTime::ToDateTime(uint64_t microsec, DateTime& datetime)
+    {
+        int64_t sec = int64_t(microsec / 1000000);
+        DateCache cache;
+        s_dateLock.Read(s_dateCache, cache);
+        if (cache.second != sec)
+        {
+            int64_t cached = cache.second;
+            time_t t = time_t(sec);
+            tm tmv;
+#ifdef WIN32
+            localtime_s(&tmv, &t);
+#else
+            localtime_r(&t, &tmv);
+#endif
+            cache.second = sec;
+            cache.datetime.year = tmv.tm_year + 1900;
+            cache.datetime.month = tmv.tm_mon + 1;
+            cache.datetime.day = tmv.tm_mday;
+            cache.datetime.hour = tmv.tm_hour;
+            cache.datetime.minute = tmv.tm_min;
+            cache.datetime.second = tmv.tm_sec;
+            // 只向前更新，其他线程正在更新时不等待 //
+            if (sec > cached && s_dateLock.TryLock())
+            {
+                if (sec > s_dateCache.second)
+                    s_dateCache = cache;
+                s_dateLock.Unlock();
+            }
+        }
+        datetime = cache.datetime;
+        datetime.milliSecond = uint32_t(microsec / 1000 % 1000);
+    }
+
+    size_t KTime::NowDateTime(const KDateTimeFormat& fmt, char* buf, bool coarse)
+    {
+        uint64_t microsec = 0;
+        if (coarse)
+            CoarseMicrosecond(microsec);
+        else
+            NowMicrosecond(microsec);
+        DateTime dt;
+        ToDateTime(microsec, dt);
+        return fmt.Format(dt, buf);
+    }
+
     bool KTime::NowDateTime(DateTime& datetime)
     {
 #ifdef WIN32
@@ -19,18 +183,8 @@ namespace klib {
         timeval st;
         if (gettimeofday(&st, NULL) == 0)
         {
-            tm* pt = localtime(&st.tv_sec);
-            if (pt)
-            {
-                datetime.year = pt->tm_year + 1900;
-                datetime.month = pt->tm_mon + 1;
-                datetime.day = pt->tm_mday;
-                datetime.hour = pt->tm_hour;
-                datetime.minute = pt->tm_min;
-                datetime.second = pt->tm_sec;
-                datetime.milliSecond = st.tv_usec / 1000;
-                return true;
-            }
+            ToDateTime(uint64_t(st.tv_sec) * 1000000 + st.tv_usec, datetime);
+            return true;
         }
 #endif
         return false;
@@ -127,6 +281,75 @@ namespace klib {
 #endif
     }
 
+    void KTime::CoarseMicrosecond(uint64_t& microsec)
+    {
+#if defined(LINUX) && defined(CLOCK_REALTIME_COARSE)
+        timespec ts;
+        if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+        {
+            microsec = uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+            return;
+        }
+#endif
+        NowMicrosecond(microsec);
+    }
+
+    void KTime::MonotonicNanosecond(uint64_t& nanosec)
+    {
+#ifdef WIN32
+        static LARGE_INTEGER freq = { 0 };
+        if (freq.QuadPart == 0)
+            QueryPerformanceFrequency(&freq);
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        nanosec = uint64_t(counter.QuadPart / freq.QuadPart) * 1000000000
+            + uint64_t(counter.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+        timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        {
+            nanosec = uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+        else
+        {
+            nanosec = 0;
+        }
+#endif
+    }
+
+    void KTime::GetMonotonicTime(timespec& abstime, const size_t& millisec)
+    {
+#ifdef WIN32
+        GetTime(abstime, millisec);
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        long nsec = ts.tv_nsec + long(millisec % 1000) * 1000000;
+        abstime.tv_nsec = nsec % 1000000000;
+        abstime.tv_sec = ts.tv_sec + nsec / 1000000000 + millisec / 1000;
+#endif
+    }
+
+    double KTime::CyclesPerNanosecond()
+    {
+        // 多个线程同时校准得到的值相近，不加锁 //
+        static volatile double cyclesPerNs = 0;
+        if (cyclesPerNs > 0)
+            return cyclesPerNs;
+
+        uint64_t ns0 = 0, ns1 = 0;
+        MonotonicNanosecond(ns0);
+        uint64_t c0 = Cycles();
+        do
+        {
+            MonotonicNanosecond(ns1);
+        } while (ns1 - ns0 < 10000000);
+        uint64_t c1 = Cycles();
+        double ratio = double(c1 - c0) / double(ns1 - ns0);
+        cyclesPerNs = (ratio > 0 ? ratio : 1.0);
+        return cyclesPerNs;
+    }
+
     void KTime::NowSecond(time_t& seconds)
     {
 #ifdef WIN32
@@ -196,83 +419,17 @@ namespace klib {
         //pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
     }
 
-    void KTime::GetDateTimeElement(const std::string& fmt, const char* keyword, const char* intfmt, uint32_t value, char* buf)
-    {
-        size_t yp = fmt.find(keyword);
-        if (yp != std::string::npos)
-        {
-            char* start = buf + yp;
-            size_t len = strlen(keyword);
-            char tmp = *(start + len);
-#ifdef WIN32
-            sprintf_s(start, len + 1, intfmt, value);
-#else
-            sprintf(start, intfmt, value);
-#endif
-            * (start + len) = tmp;
-        }
-    }
-
     bool KTime::NowDateTime(const std::string& fmt, std::string& datetime)
     {
         DateTime dt;
-        if (NowDateTime(dt))
-        {
-            char buf[32] = { 0 };
-#ifdef WIN32
-            strcpy_s(buf, fmt.size() + 1, fmt.data());
-#else
-            strcpy(buf, fmt.data());
-#endif
-            // year
-            GetDateTimeElement(fmt, "yyyy", "%04d", dt.year, buf);
-            // month
-            GetDateTimeElement(fmt, "mm", "%02d", dt.month, buf);
-            // day
-            GetDateTimeElement(fmt, "dd", "%02d", dt.day, buf);
-            // hour
-            GetDateTimeElement(fmt, "hh", "%02d", dt.hour, buf);
-            // minute
-            GetDateTimeElement(fmt, "nn", "%02d", dt.minute, buf);
-            // second
-            GetDateTimeElement(fmt, "ss", "%02d", dt.second, buf);
-            // millisecond
-            GetDateTimeElement(fmt, "ccc", "%03d", dt.milliSecond, buf);
-            datetime = buf;
-            return true;
-        }
-        else
-        {
-            datetime = KError::ErrorStr(KError::ErrorCode());
-            return false;
-        }
+        return NowDateTime(fmt, datetime, dt);
     }
 
     bool KTime::NowDateTime(const std::string& fmt, std::string& datetime, DateTime& dt)
     {
         if (NowDateTime(dt))
         {
-            char buf[32] = { 0 };
-#ifdef WIN32
-            strcpy_s(buf, fmt.size() + 1, fmt.data());
-#else
-            strcpy(buf, fmt.data());
-#endif
-            // year
-            GetDateTimeElement(fmt, "yyyy", "%04d", dt.year, buf);
-            // month
-            GetDateTimeElement(fmt, "mm", "%02d", dt.month, buf);
-            // day
-            GetDateTimeElement(fmt, "dd", "%02d", dt.day, buf);
-            // hour
-            GetDateTimeElement(fmt, "hh", "%02d", dt.hour, buf);
-            // minute
-            GetDateTimeElement(fmt, "nn", "%02d", dt.minute, buf);
-            // second
-            GetDateTimeElement(fmt, "ss", "%02d", dt.second, buf);
-            // millisecond
-            GetDateTimeElement(fmt, "ccc", "%03d", dt.milliSecond, buf);
-            datetime = buf;
+            CachedFormat(fmt).Format(dt, datetime);
             return true;
         }
         else
@@ -5,12 +5,16 @@
 #ifdef WIN32
 #include <Windows.h>
 #include <sys/timeb.h>
+#include <intrin.h>
 #include <pthread.h>
 #else
+#include <time.h>
 #include <sys/time.h>
 #include <unistd.h>
 #endif // WIN32
 #include <stdint.h>
+#include <cstdio>
+#include <vector>
 /**
 时间类
 **/
@@ -26,6 +30,40 @@ namespace klib {
         uint32_t milliSecond;
     };
 
+    /**
+    预先解析的时间格式，关键字与KTime::NowDateTime 相同
+    格式化时先拷贝模板，再按记录的位置写入数字，不查找字符串也不调用sprintf
+    **/
+    class KDateTimeFormat
+    {
+    public:
+        explicit KDateTimeFormat(const std::string& fmt);
+
+        /************************************
+        * Method:    格式化时间
+        * Returns:   写入的长度，不含结尾的0
+        * Parameter: dt 时间
+        * Parameter: buf 输出，至少Length() + 1 字节
+        *************************************/
+        size_t Format(const DateTime& dt, char* buf) const;
+
+        void Format(const DateTime& dt, std::string& out) const;
+
+        inline size_t Length() const { return m_template.size(); }
+
+    private:
+        enum { FdYear, FdMonth, FdDay, FdHour, FdMinute, FdSecond, FdMilliSecond };
+
+        struct Field
+        {
+            uint16_t type;
+            uint16_t offset;
+        };
+
+        std::string m_template;
+        std::vector<Field> m_fields;
+    };
+
     class KTime
     {
     public:
@@ -42,24 +80,106 @@ namespace klib {
         * ccc millisecond
         */
         static bool NowDateTime(const std::string& fmt, std::string& datetime);
+        // 按预先解析的格式输出当前时间，返回长度，coarse 使用粗粒度时钟 //
+        static size_t NowDateTime(const KDateTimeFormat& fmt, char* buf, bool coarse = false);
+        // 微秒时间转换成本地时间，同一秒内复用缓存，不调用localtime //
+        static void ToDateTime(uint64_t microsec, DateTime& datetime);
         // 格式化时间  yyyy-mm-dd hh:nn:ss.ccc //
         static std::string FormatDateTime(const std::string &timeString);
         // 获取当前时间毫秒数 //
         static void NowMillisecond(uint64_t& millisec);
         // 获取当前时间微秒数 //
         static void NowMicrosecond(uint64_t& microsec);
+        // 获取当前时间微秒数，精度为时钟中断周期(通常1~4毫秒)，开销比NowMicrosecond 小 //
+        static void CoarseMicrosecond(uint64_t& microsec);
         // 获取当前时间秒数 // 
         static void NowSecond(time_t& seconds);
         // 获取当前timespec时间 //
         static void NowTime(timespec& abstime);
         // 获取当前时间 //
         static void GetTime(timespec& abstime, const size_t& millisec);
+        // 单调时钟纳秒数，不受系统时间调整影响，用于计时和超时 //
+        static void MonotonicNanosecond(uint64_t& nanosec);
+        // 单调时钟的绝对超时时间，与CLOCK_MONOTONIC 的条件变量配合使用 //
+        static void GetMonotonicTime(timespec& abstime, const size_t& millisec);
+        // CPU 时钟周期计数(x86 为rdtsc)，不支持时返回单调时钟纳秒数 //
+        static inline uint64_t Cycles()
+        {
+#if defined(_MSC_VER)
+            return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+            uint32_t lo = 0, hi = 0;
+            __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+            return (uint64_t(hi) << 32) | lo;
+#else
+            uint64_t nanosec = 0;
+            MonotonicNanosecond(nanosec);
+            return nanosec;
+#endif
+        }
+        // 每纳秒的时钟周期数，首次调用时用单调时钟校准约10毫秒 //
+        static double CyclesPerNanosecond();
+        // 时钟周期数转换成纳秒 //
+        static inline uint64_t CyclesToNanosecond(uint64_t cycles)
+        {
+            return uint64_t(double(cycles) / CyclesPerNanosecond());
+        }
         // 睡眠millisec毫秒 //
         static void MSleep(int millisec);
+    };
+
+    /**
+    秒表，使用单调时钟
+    **/
+    class KStopwatch
+    {
+    public:
+        KStopwatch() { Restart(); }
+
+        inline void Restart() { KTime::MonotonicNanosecond(m_start); }
+
+        inline uint64_t ElapsedNanosecond() const
+        {
+            uint64_t now = 0;
+            KTime::MonotonicNanosecond(now);
+            return now - m_start;
+        }
+
+        inline uint64_t ElapsedMicrosecond() const { return ElapsedNanosecond() / 1000; }
+
+        inline uint64_t ElapsedMillisecond() const { return ElapsedNanosecond() / 1000000; }
+
     private:
-        static void GetDateTimeElement(const std::string& fmt, const char* keyword,
-            const char* intfmt, uint32_t value, char* buf);
+        uint64_t m_start;
+    };
 
+    /**
+    作用域计时，析构时把耗时纳秒累加到指定变量，或者按名称打印
+    **/
+    class KScopedTimer
+    {
+    public:
+        KScopedTimer(uint64_t& elapsed) :m_name(NULL), m_elapsed(&elapsed) {}
+
+        KScopedTimer(const char* name) :m_name(name), m_elapsed(NULL) {}
+
+        ~KScopedTimer()
+        {
+            uint64_t ns = m_watch.ElapsedNanosecond();
+            if (m_elapsed != NULL)
+                *m_elapsed += ns;
+            else
+                printf("[%s] elapsed %.3f ms\n", m_name, ns / 1000000.0);
+        }
+
+    private:
+        KScopedTimer(const KScopedTimer&);
+        KScopedTimer& operator=(const KScopedTimer&);
+
+    private:
+        const char* m_name;
+        uint64_t* m_elapsed;
+        KStopwatch m_watch;
     };
 };
 #endif // !_TIME_HPP_
@@ -0,0 +1,171 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "util/KBinaryLog.h"
+/**
+二进制日志解码工具，把KBinaryLog 写的文件按KTextFile 的格式还原为文本输出到标准输出
+用法：KBinaryLogDump [-l 级别] [-s 来源] [-b 开始时间] [-e 结束时间] [-p 文本] [-n] 文件...
+    -l 最低级别，数字或trace/debug/info/warn/error/fatal
+    -s 只输出该来源的记录
+    -b/-e 时间范围[开始, 结束)，格式"YYYY-MM-DD HH:MM:SS" (本地时间) 或微秒数
+    -p 只输出解码后包含该文本的记录
+    -n 不输出时间
+**/
+using namespace klib;
+
+static void Usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-l level] [-s source] [-b begin] [-e end] [-p pattern] [-n] file...\n", name);
+    fprintf(stderr, "  -l  minimum level, number or trace/debug/info/warn/error/fatal\n");
+    fprintf(stderr, "  -s  source id\n");
+    fprintf(stderr, "  -b  begin time, \"YYYY-MM-DD HH:MM:SS\" or microseconds\n");
+    fprintf(stderr, "  -e  end time (exclusive), same format as -b\n");
+    fprintf(stderr, "  -p  only records whose text contains pattern\n");
+    fprintf(stderr, "  -n  do not print timestamps\n");
+}
+
+/************************************
+* Method:    解析级别
+* Returns:   成功返回true
+* Parameter: str 数字或级别名称
+* Parameter: level 级别
+*************************************/
+static bool ParseLevel(const char* str, uint8_t& level)
+{
+    static const char* names[] = { "trace", "debug", "info", "warn", "error", "fatal" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if (strcmp(str, names[i]) == 0)
+        {
+            level = uint8_t(i);
+            return true;
+        }
+    }
+
+    char* end = NULL;
+    long val = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || val < LlTrace || val > LlFatal)
+        return false;
+    level = uint8_t(val);
+    return true;
+}
+
+/************************************
+* Method:    解析时间
+* Returns:   成功返回true
+* Parameter: str 本地时间"YYYY-MM-DD HH:MM:SS" 或微秒数
+* Parameter: microsec 微秒
+*************************************/
+static bool ParseTime(const char* str, uint64_t& microsec)
+{
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    if (sscanf(str, "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) == 6)
+    {
+        t.tm_year -= 1900;
+        t.tm_mon -= 1;
+        t.tm_isdst = -1;
+        time_t sec = mktime(&t);
+        if (sec == time_t(-1))
+            return false;
+        microsec = uint64_t(sec) * 1000000;
+        return true;
+    }
+
+    char* end = NULL;
+    unsigned long long val = strtoull(str, &end, 10);
+    if (end == str || *end != '\0')
+        return false;
+    microsec = uint64_t(val);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BinaryLogFilter filter;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (arg[0] != '-' || arg[1] == '\0')
+        {
+            files.push_back(arg);
+            continue;
+        }
+
+        char opt = arg[1];
+        if (opt == 'n')
+        {
+            filter.timestamp = false;
+            continue;
+        }
+        if (opt == 'h')
+        {
+            Usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "missing value for -%c\n", opt);
+            Usage(argv[0]);
+            return 2;
+        }
+
+        const char* val = argv[++i];
+        bool ok = true;
+        switch (opt)
+        {
+        case 'l':
+            ok = ParseLevel(val, filter.minLevel);
+            break;
+        case 's':
+        {
+            char* end = NULL;
+            long src = strtol(val, &end, 10);
+            ok = (end != val && *end == '\0' && src >= 0 && src <= 0xffff);
+            filter.source = int(src);
+            break;
+        }
+        case 'b':
+            ok = ParseTime(val, filter.begin);
+            break;
+        case 'e':
+            ok = ParseTime(val, filter.end);
+            break;
+        case 'p':
+            filter.pattern = val;
+            break;
+        default:
+            fprintf(stderr, "unknown option -%c\n", opt);
+            Usage(argv[0]);
+            return 2;
+        }
+
+        if (!ok)
+        {
+            fprintf(stderr, "invalid value for -%c: [%s]\n", opt, val);
+            return 2;
+        }
+    }
+
+    if (files.empty())
+    {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (KBinaryLogReader::Dump(files[i], filter, stdout) < 0)
+        {
+            fprintf(stderr, "open [%s] failed\n", files[i].c_str());
+            rc = 1;
+        }
+    }
+    fflush(stdout);
+    return rc;
+}